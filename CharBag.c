@@ -1,10 +1,11 @@
 /** @file CharBag.c */
 
 #include "CharBag.h"
+#include "JPool.h"
+#include "JAlloc.h"
 
 #include <assert.h>
-#include <string.h> // memset
-#include <stdlib.h> // malloc/free
+#include <string.h> // memset, memcpy
 
 
 /**
@@ -14,12 +15,43 @@
  * non-NULL members.
  *
  * @param[in,out] *charBag  Uninitialized ::CharBag instance
+ * @param[in] *allocator    Source of the buffer and of the string made
+ *                          by #char_bag_to_string, NULL for the default
  */
-void initialize_CharBag(CharBag *charBag)
+void initialize_CharBag(CharBag *charBag, const jd_Allocator *allocator)
 {
    assert(charBag);
    memset(charBag, 0, sizeof(CharBag));
-   charBag->curLeaf = &charBag->rootLeaf;
+   charBag->allocator = allocator;
+}
+
+/**
+ * @brief Make room for @b count more characters.
+ *
+ * Doubles the buffer until it is large enough, so a string of any
+ * length costs only a few reallocations.
+ *
+ * @param[in] *charBag  CharBag instance about to accept characters
+ * @param[in] count     number of characters to be added
+ * @returns true for success, false if out of memory
+ */
+static bool char_bag_reserve(CharBag *charBag, size_t count)
+{
+   size_t required = charBag->length + count;
+   if (required <= charBag->size)
+      return true;
+
+   size_t size = charBag->size ? charBag->size : CB_INITIAL_SIZE;
+   while (size < required)
+      size *= 2;
+
+   char *buff = (char*)mem_realloc(charBag->allocator, charBag->buff, size);
+   if (!buff)
+      return false;
+
+   charBag->buff = buff;
+   charBag->size = size;
+   return true;
 }
 
 /**
@@ -33,98 +65,85 @@ void initialize_CharBag(CharBag *charBag)
 bool add_char_to_bag(CharBag *charBag, char char_to_save)
 {
    assert(charBag);
-   bool retval = true;
 
-   // leaf into which next char will be saved
-   CharBagLeaf *leafForSaving = charBag->curLeaf;
+   if (charBag->length == charBag->size && !char_bag_reserve(charBag, 1))
+      return false;
 
-   // if the leafForSaving is full, attach an empty new leaf for use:
-   if (leafForSaving->index_next_char >= CB_LEAF_SIZE)
-   {
-      leafForSaving->next = (CharBagLeaf*)malloc(sizeof(CharBagLeaf));
-      if (leafForSaving->next)
-      {
-         memset(leafForSaving->next, 0, sizeof(CharBagLeaf));
-
-         // Update pointers in the leaf and the charBag:
-         leafForSaving = leafForSaving->next;
-         charBag->curLeaf = leafForSaving;
-      }
-      else
-      {
-         retval = false;
-         goto early_exit;
-      }
-   }
+   charBag->buff[charBag->length++] = char_to_save;
+   return true;
+}
 
-   leafForSaving->buff[leafForSaving->index_next_char] = char_to_save;
-   ++leafForSaving->index_next_char;
+/**
+ * @brief Add a run of characters to the collection.
+ *
+ * @param[in] *charBag  CharBag instance accepting characters
+ * @param[in] chars     characters to save, need not be NUL-terminated
+ * @param[in] count     number of characters to save
+ * @returns true for success, false for failure.  Failure will usually
+ *          be a memory problem.
+ */
+bool add_chars_to_bag(CharBag *charBag, const char *chars, size_t count)
+{
+   assert(charBag);
 
-  early_exit:
+   if (!char_bag_reserve(charBag, count))
+      return false;
 
-   return retval;
+   memcpy(charBag->buff + charBag->length, chars, count);
+   charBag->length += count;
+   return true;
 }
 
 /**
  * @brief Allocates single buffer to hold complete character collection.
  *
+ * The buffer comes from #pool_alloc and must be released with #pool_free.
+ * The collection is left in the bag.
+ *
  * @param[in] *charBag       Character collection from which the new string
  *                           will be created and copied.
  * @param[out] **string_out  Pointer to address where the new string will
  *                           be returned.
+ * @param[out] *length_out   Optional pointer to which the number of
+ *                           characters will be written, which may be
+ *                           different from @c strlen if the collection
+ *                           includes '\0' characters.
  * @return true if @p string_out points to a new string, false if there is
  *         not enough memory to contain the characters.
  */
-bool char_bag_to_string(CharBag *charBag, char **string_out)
+bool char_bag_to_string(CharBag *charBag, char **string_out, size_t *length_out)
 {
    assert(charBag);
 
-   bool retval = true;
-   CharBagLeaf *curLeaf;
-   int charCount = 0;
-
-   // Pass #1 to measure space required
-   curLeaf = &charBag->rootLeaf;
-   while (curLeaf)
-   {
-      charCount += curLeaf->index_next_char;
-      curLeaf = curLeaf->next;
-   }
-
-   char *buff = (char*)malloc(charCount + 1);
+   char *buff = (char*)pool_alloc(charBag->length + 1, charBag->allocator);
    if (!buff)
-   {
-      retval = false;
-      goto early_exit;
-   }
+      return false;
 
-   // Pass #2 to copy string to buffer
-   curLeaf = &charBag->rootLeaf;
-   char *ptr = buff;
-   while (curLeaf)
-   {
-      if (curLeaf->index_next_char)
-      {
-         memcpy(ptr, curLeaf->buff, curLeaf->index_next_char);
-         ptr += curLeaf->index_next_char;
-      }
-      curLeaf = curLeaf->next;
-   }
-
-   // Terminate string with NULL if we calculated string length properly:
-   assert(ptr == buff + charCount);
-   *ptr = '\0';
+   if (charBag->length)
+      memcpy(buff, charBag->buff, charBag->length);
+   buff[charBag->length] = '\0';
 
    *string_out = buff;
+   if (length_out)
+      *length_out = charBag->length;
 
-  early_exit:
-   return retval;
+   return true;
+}
+
+/**
+ * @brief Empty the collection, keeping its buffer for the next.
+ *
+ * @param[in] *charBag   initialized #CharBag to be reused
+ */
+void char_bag_reset(CharBag *charBag)
+{
+   assert(charBag);
+   charBag->length = 0;
 }
 
 /**
  * @brief Deleted allocated memory of an initialized #CharBag.
  *
- * Recursively frees allocated memory after freeing any children.
  * Be careful not to call this function on an uninitiated #CharBag
  * whose pointer members will have nonsense addresses.
  *
@@ -134,21 +153,16 @@ void char_bag_cleanup(CharBag *charBag)
 {
    assert(charBag);
 
-   // Free all malloced leaves
-   while (charBag->rootLeaf.next)
-   {
-      CharBagLeaf *leafToDelete = charBag->rootLeaf.next;
-      charBag->rootLeaf.next = leafToDelete->next;
-
-      // optional memset before free to mark deleted leaves:
-      memset(leafToDelete, -1, sizeof(CharBagLeaf));
+   if (charBag->buff)
+      mem_free(charBag->allocator, charBag->buff);
 
-      free((void*)leafToDelete);
-   }
+   charBag->buff = NULL;
+   charBag->length = charBag->size = 0;
 }
 
 #ifdef CHARBAG_MAIN
 
+#include "JPool.c"
 #include <stdio.h>
 
 void add_string_to_char_bag(CharBag *charBag, const char *str)
@@ -163,10 +177,13 @@ void add_string_to_char_bag(CharBag *charBag, const char *str)
 int main(int argc, const char **argv)
 {
    CharBag charBag;
-   initialize_CharBag(&charBag);
+   initialize_CharBag(&charBag, NULL);
 
    add_string_to_char_bag(&charBag, "string\n\n");
 
+   for (int i = 0; i < CB_INITIAL_SIZE / 8; ++i)
+      add_string_to_char_bag(&charBag, "padding ");
+
    add_string_to_char_bag(&charBag, "This is a short sentence.\n\n");
 
    add_string_to_char_bag(&charBag,
@@ -177,19 +194,19 @@ int main(int argc, const char **argv)
 
    add_string_to_char_bag(&charBag,
                           "This is a paragraph that should force CharBag to\n"
-                          "allocate more leaves to accommodate its length.\n"
+                          "enlarge its first buffer to accommodate its length.\n"
                           "You should see all these lines in the final output,\n"
                           "if I've done everything right.\n"
                           "\n"
       );
 
    char *buff = NULL;
-   if (char_bag_to_string(&charBag, &buff))
+   if (char_bag_to_string(&charBag, &buff, NULL))
       printf("This is the string:\n\n%s\n", buff);
    else
       printf("Oops, there was an error.\n");
 
-   free(buff);
+   pool_free(buff);
    char_bag_cleanup(&charBag);
 
    return 0;
@@ -2,38 +2,36 @@
  * @file CharBag.h
  * A CharBag is a container of a collection of characters that
  * constitutes a string, expanding to accommodate very long strings.
+ *
+ * The characters are kept in a single buffer that doubles as it
+ * fills.  A bag can be emptied with #char_bag_reset and refilled
+ * without giving up its buffer, so a reader keeps one bag as
+ * scratch space for every string it collects.
  */
 
 #ifndef CHARBAG_H
 #define CHARBAG_H
 
 #include <stdbool.h>
+#include <stddef.h>   // size_t
+#include "jsondom.h"  // jd_Allocator
 
-/** CharBagLeaf buffer size */
-#define CB_LEAF_SIZE 50
+/** Size of the first buffer of a CharBag */
+#define CB_INITIAL_SIZE 256
 
 /** Simplified type */
 typedef struct CharBag_s     CharBag;
-/** Simplified type */
-typedef struct CharBagLeaf_s CharBagLeaf;
-
-/**
- * @brief Leaf of linked list of character buffers
- * Designed to be initialized with zeros (memset) to make
- * initializing a ::CharBag easier.
- */
-struct CharBagLeaf_s {
-   char buff[CB_LEAF_SIZE]; ///< memory to which characters are stored
-   int index_next_char;     ///< index of next free space in #buff
-   CharBagLeaf *next;       ///< pointer to next leaf if this one is full
-};
 
 /**
- * @brief Handle to managed linked list of char buffers.
+ * @brief Handle to a growable buffer of characters.
+ * Designed to be initialized with zeros (memset), the buffer
+ * being allocated with the first character.
  */
 struct CharBag_s {
-   CharBagLeaf rootLeaf;    ///< instance of first leaf of linked list
-   CharBagLeaf *curLeaf;    ///< Last leaf into which new characters are stored
+   char               *buff;       ///< memory to which characters are stored
+   size_t             length;      ///< number of characters in #buff
+   size_t             size;        ///< bytes allocated to #buff
+   const jd_Allocator *allocator;  ///< source of the buffer and strings, NULL for the default
 };
 
 /**
@@ -41,9 +39,11 @@ struct CharBag_s {
  * @defgroup CharBagFunctions Functions that use CharBag character sinks
  * @{
  */
-void initialize_CharBag(CharBag *charBag);
+void initialize_CharBag(CharBag *charBag, const jd_Allocator *allocator);
 bool add_char_to_bag(CharBag *charBag, char char_to_save);
-bool char_bag_to_string(CharBag *charBag, char **string_out);
+bool add_chars_to_bag(CharBag *charBag, const char *chars, size_t count);
+bool char_bag_to_string(CharBag *charBag, char **string_out, size_t *length_out);
+void char_bag_reset(CharBag *charBag);
 void char_bag_cleanup(CharBag *charBag);
 /** @} */
 
@@ -0,0 +1,50 @@
+/**
+ * @file JAlloc.h
+ * @brief Memory from a #jd_Allocator, or from @c malloc if there is none.
+ *
+ * Every block the library takes for a document goes through
+ * these functions or through the pool in JPool.h, which uses
+ * them when it is given an allocator.
+ */
+
+#ifndef JALLOC_H
+#define JALLOC_H
+
+#include <stdlib.h>   // malloc/realloc/free
+#include "jsondom.h"
+
+/**
+ * @brief Get @b size bytes from @b allocator, or from @c malloc
+ *        if @b allocator is NULL.
+ */
+static inline void *mem_alloc(const jd_Allocator *allocator, size_t size)
+{
+   if (allocator)
+      return (*allocator->alloc)(allocator->user, size);
+   else
+      return malloc(size);
+}
+
+/**
+ * @brief Resize a block from #mem_alloc, with the same @b allocator.
+ */
+static inline void *mem_realloc(const jd_Allocator *allocator, void *ptr, size_t size)
+{
+   if (allocator)
+      return (*allocator->realloc)(allocator->user, ptr, size);
+   else
+      return realloc(ptr, size);
+}
+
+/**
+ * @brief Release a block from #mem_alloc, with the same @b allocator.
+ */
+static inline void mem_free(const jd_Allocator *allocator, void *ptr)
+{
+   if (allocator)
+      (*allocator->free)(allocator->user, ptr);
+   else
+      free(ptr);
+}
+
+#endif
@@ -0,0 +1,443 @@
+/** @file JBinary.c */
+
+#include "JBinary.h"
+#include "JPool.h"
+#include <stdint.h>   // uint32_t, uint64_t
+#include <string.h>   // memcmp, memset
+
+/** Record flags that a loader accepts */
+#define JB_REC_FLAGS (JB_REC_RAW | JB_REC_CLEAN | JB_REC_PAYLOAD)
+
+/**
+ * @brief Running checksum of node records.
+ * @details
+ *    A Fletcher-style pair of sums: @b a adds the bytes and @b b
+ *    adds the successive values of @b a, so that reordered bytes
+ *    change the result as well as changed ones.
+ */
+typedef struct JBChecksum_s {
+   uint32_t a;
+   uint32_t b;
+} JBChecksum;
+
+/** Add bytes to a running checksum */
+static inline void checksum_add(JBChecksum *sum, const unsigned char *data, size_t len)
+{
+   uint32_t a = sum->a;
+   uint32_t b = sum->b;
+   for (size_t i = 0; i < len; ++i)
+   {
+      a += data[i];
+      b += a;
+   }
+   sum->a = a;
+   sum->b = b;
+}
+
+/** Value of a checksum as stored in the trailer */
+static inline uint64_t checksum_value(const JBChecksum *sum)
+{
+   return ((uint64_t)sum->b << 32) | sum->a;
+}
+
+/**
+ * @brief State of a binary file being written.
+ */
+typedef struct JBOutput_s {
+   JWriter    *jw;      ///< destination of the file
+   JBChecksum sum;      ///< checksum of the node records written
+   uint64_t   bytes;    ///< number of bytes of node records written
+} JBOutput;
+
+/** Write part of a node record */
+static inline void put_record(JBOutput *out, const void *data, size_t len)
+{
+   checksum_add(&out->sum, (const unsigned char*)data, len);
+   out->bytes += len;
+   JWriterPut(out->jw, (const char*)data, len);
+}
+
+/** Write part of a node record as an unsigned LEB128 number */
+static void put_record_number(JBOutput *out, uint64_t value)
+{
+   unsigned char buffer[10];
+   size_t len = 0;
+   do
+   {
+      buffer[len] = value & 0x7F;
+      value >>= 7;
+      if (value)
+         buffer[len] |= 0x80;
+      ++len;
+   }
+   while (value);
+
+   put_record(out, buffer, len);
+}
+
+/** Write a little-endian integer of @b size bytes outside the node records */
+static void put_fixed(JWriter *jw, uint64_t value, size_t size)
+{
+   unsigned char buffer[8];
+   for (size_t i = 0; i < size; ++i)
+      buffer[i] = (unsigned char)(value >> (8 * i));
+
+   JWriterPut(jw, (const char*)buffer, size);
+}
+
+/** Read a little-endian integer of @b size bytes */
+static uint64_t get_fixed(const unsigned char *data, size_t size)
+{
+   uint64_t value = 0;
+   for (size_t i = size; i-- > 0; )
+      value = (value << 8) | data[i];
+
+   return value;
+}
+
+/**
+ * @brief Read an unsigned LEB128 number from node records.
+ * @return True for success, false if the number is unterminated
+ *         or does not fit in 64 bits
+ */
+static bool get_record_number(const unsigned char **pos, const unsigned char *end, uint64_t *value)
+{
+   uint64_t result = 0;
+   for (int shift = 0; shift < 64 && *pos < end; shift += 7)
+   {
+      unsigned char byte = *(*pos)++;
+      if (shift == 63 && byte > 1)
+         return false;
+
+      result |= (uint64_t)(byte & 0x7F) << shift;
+      if (!(byte & 0x80))
+      {
+         *value = result;
+         return true;
+      }
+   }
+
+   return false;
+}
+
+/**
+ * @brief Write the record of a node without children.
+ * @param out   file being written
+ * @param type  type to record, #JD_STRING for a property label
+ * @param node  node whose payload is written
+ */
+static void put_scalar_record(JBOutput *out, jd_Type type, const jd_Node *node)
+{
+   // Strings and numbers always have payloads, if only empty ones:
+   unsigned char record = (unsigned char)type;
+   bool has_payload = node->payload || type >= JD_STRING;
+
+   if (has_payload)
+   {
+      record |= JB_REC_PAYLOAD;
+      if (node->flags & JDN_RAW)
+         record |= JB_REC_RAW;
+      if (node->flags & JDN_CLEAN)
+         record |= JB_REC_CLEAN;
+   }
+
+   put_record(out, &record, 1);
+
+   if (has_payload)
+   {
+      size_t len = jd_Node_payload_length(node);
+      put_record_number(out, len);
+      if (len)
+         put_record(out, jd_Node_payload(node), len);
+      put_record(out, "", 1);
+   }
+}
+
+/**
+ * @brief Write a tree in the binary format.
+ * @details
+ *    The tree is written in document order in a single pass
+ *    after its nodes are counted.  Property labels are written
+ *    as the first child of their property, as the format has
+ *    always had them.
+ *
+ * @param jw    destination of the file
+ * @param root  top of the tree to be written
+ */
+void binary_write(JWriter *jw, const jd_Node *root)
+{
+   // A property's label is a record of its own:
+   uint64_t count = 0;
+   for (const jd_Node *node = root; node; node = jd_Node_next_in_tree(node, root))
+      count += node->type == JD_PROPERTY ? 2 : 1;
+
+   JWriterPut(jw, JB_MAGIC, 8);
+   put_fixed(jw, JB_VERSION, 4);
+   put_fixed(jw, 0, 4);
+   put_fixed(jw, count, 8);
+
+   JBOutput out = { jw, { 0, 0 }, 0 };
+
+   for (const jd_Node *node = root; node; node = jd_Node_next_in_tree(node, root))
+   {
+      if (node->type < JD_ARRAY)
+         put_scalar_record(&out, node->type, node);
+      else
+      {
+         unsigned char record = (unsigned char)node->type;
+         put_record(&out, &record, 1);
+
+         uint64_t children = 0;
+         for (const jd_Node *child = jd_Node_relation(node, JD_FIRST);
+              child;
+              child = jd_Node_relation(child, JD_NEXT))
+            ++children;
+
+         if (node->type == JD_PROPERTY)
+         {
+            put_record_number(&out, children + 1);
+            put_scalar_record(&out, JD_STRING, node);
+         }
+         else
+            put_record_number(&out, children);
+      }
+   }
+
+   put_fixed(jw, out.bytes, 8);
+   put_fixed(jw, checksum_value(&out.sum), 8);
+}
+
+/** Fill in a jd_ParseError for a problem at @b offset in the file */
+static void binary_error(jd_ParseError *pe, size_t offset, const char *message)
+{
+   pe->char_loc = (int)offset;
+   pe->message = message;
+}
+
+/**
+ * @brief Check that a new node may be a child of @b parent.
+ * @return NULL if allowed, otherwise a description of the problem
+ */
+static const char *check_child(const jd_Node *parent, jd_Type type, unsigned char record)
+{
+   switch (parent->type)
+   {
+      case JD_OBJECT:
+         if (type != JD_PROPERTY)
+            return "object member is not a property";
+         break;
+      case JD_PROPERTY:
+         if (!(parent->flags & JDN_SIZED))
+         {
+            if (type != JD_STRING || !(record & JB_REC_PAYLOAD))
+               return "property label is not a string";
+         }
+         else if (type == JD_PROPERTY)
+            return "property value is a property";
+         break;
+      default:
+         if (type == JD_PROPERTY)
+            return "array element is a property";
+         break;
+   }
+
+   return NULL;
+}
+
+/**
+ * @brief Build a tree from a file in the binary format.
+ * @details
+ *    Everything is checked before it is used: the header, the
+ *    length and checksum of the node records, and every record
+ *    against the bounds of the data and the structure of a JSON
+ *    document.  A damaged file is reported, never read past.
+ *
+ *    While a collection is being filled, its otherwise unused
+ *    @b length counts the children still to come, so the tree
+ *    is built without recursion or a stack.  A property takes
+ *    its label record as its own payload and ends with its value.
+ *
+ *    Payloads point into @b data, which must outlive the tree.
+ *
+ * @param data  contents of a binary file
+ * @param len   number of bytes in @b data
+ * @param pe    set to the offset and description of any problem
+ * @return Root of the tree, or NULL if @b data is not a valid
+ *         binary file or memory ran out
+ */
+jd_Node *binary_read(const char *data, size_t len, jd_ParseError *pe)
+{
+   const unsigned char *start = (const unsigned char*)data;
+
+   if (len < JB_HEADER_SIZE + JB_TRAILER_SIZE)
+   {
+      binary_error(pe, len, "file too short for a binary document");
+      return NULL;
+   }
+
+   if (memcmp(start, JB_MAGIC, 8) != 0)
+   {
+      binary_error(pe, 0, "not a binary document");
+      return NULL;
+   }
+
+   if (get_fixed(start + 8, 4) != JB_VERSION)
+   {
+      binary_error(pe, 8, "unsupported binary document version");
+      return NULL;
+   }
+
+   uint64_t nodes = get_fixed(start + 16, 8);
+   uint64_t body_len = get_fixed(start + len - JB_TRAILER_SIZE, 8);
+   if (body_len != len - JB_HEADER_SIZE - JB_TRAILER_SIZE)
+   {
+      binary_error(pe, len - JB_TRAILER_SIZE, "binary document length does not match its size");
+      return NULL;
+   }
+
+   const unsigned char *pos = start + JB_HEADER_SIZE;
+   const unsigned char *end = pos + body_len;
+
+   JBChecksum sum = { 0, 0 };
+   checksum_add(&sum, pos, body_len);
+   if (checksum_value(&sum) != get_fixed(end + 8, 8))
+   {
+      binary_error(pe, len - 8, "binary document checksum mismatch");
+      return NULL;
+   }
+
+   jd_Node *root = NULL;
+   jd_Node *parent = NULL;
+   uint64_t count = 0;
+   const char *message = NULL;
+
+   do
+   {
+      const unsigned char *record_start = pos;
+      if (pos >= end)
+      {
+         message = "binary document ends inside a collection";
+         goto early_exit;
+      }
+
+      unsigned char record = *pos++;
+      jd_Type type = (jd_Type)(record & 0x0F);
+      if (type > JD_OBJECT
+          || (record & 0xF0 & ~JB_REC_FLAGS)
+          || ((record & JB_REC_PAYLOAD) && type >= JD_ARRAY)
+          || (!(record & JB_REC_PAYLOAD) && type >= JD_STRING && type < JD_ARRAY)
+          || ((record & (JB_REC_RAW | JB_REC_CLEAN)) && !(record & JB_REC_PAYLOAD)))
+      {
+         message = "invalid node record";
+         pos = record_start;
+         goto early_exit;
+      }
+
+      if (parent && (message = check_child(parent, type, record)))
+      {
+         pos = record_start;
+         goto early_exit;
+      }
+
+      // The first child record of a property is its label, kept in the property:
+      bool label = parent && parent->type == JD_PROPERTY && !(parent->flags & JDN_SIZED);
+
+      jd_Node *node = label ? parent : pool_node_alloc(NULL);
+      if (node == NULL)
+      {
+         message = "out of memory";
+         goto early_exit;
+      }
+
+      ++count;
+
+      if (!label)
+      {
+         memset(node, 0, sizeof(jd_Node));
+         node->type = type;
+
+         if (parent)
+         {
+            node->parent = parent;
+            node->prevSibling = parent->lastChild;
+            if (parent->lastChild)
+               parent->lastChild->nextSibling = node;
+            else
+               parent->firstChild = node;
+            parent->lastChild = node;
+         }
+         else
+            root = node;
+      }
+
+      if (record & JB_REC_PAYLOAD)
+      {
+         uint64_t payload_len;
+         if (!get_record_number(&pos, end, &payload_len)
+             || payload_len >= (uint64_t)(end - pos)
+             || pos[payload_len] != '\0')
+         {
+            message = "invalid payload length";
+            goto early_exit;
+         }
+
+         node->payload = (void*)pos;
+         node->length = (size_t)payload_len;
+         node->flags = JDN_SIZED | JDN_BORROWED;
+         if (record & JB_REC_RAW)
+            node->flags |= JDN_RAW;
+         if (record & JB_REC_CLEAN)
+            node->flags |= JDN_CLEAN;
+
+         pos += payload_len + 1;
+
+         // The property still awaits its value:
+         if (label)
+            continue;
+      }
+      else if (type >= JD_ARRAY)
+      {
+         uint64_t children;
+         if (!get_record_number(&pos, end, &children)
+             || children > (uint64_t)(end - pos)
+             || (type == JD_PROPERTY && children != 2))
+         {
+            message = "invalid number of children";
+            goto early_exit;
+         }
+
+         // A property's length will be its label's, its value ends it:
+         if (type == JD_PROPERTY)
+         {
+            parent = node;
+            continue;
+         }
+         else if (children)
+         {
+            node->length = (size_t)children;
+            parent = node;
+            continue;
+         }
+      }
+
+      // The node is complete, as may be the collections it ends:
+      while (parent && (parent->type == JD_PROPERTY || --parent->length == 0))
+         parent = parent->parent;
+   }
+   while (parent);
+
+   if (pos != end)
+      message = "unexpected data after the last node";
+   else if (count != nodes)
+      message = "node count does not match the header";
+
+  early_exit:
+   if (message)
+   {
+      binary_error(pe, (size_t)(pos - start), message);
+      if (root)
+         jd_Node_destroy(&root, NULL);
+   }
+
+   return root;
+}
@@ -0,0 +1,67 @@
+/**
+ * @file JBinary.h
+ * @brief Functions that save and load jd_Node trees in a binary format.
+ *
+ * A binary file is a header, the nodes in document order, and a
+ * trailer.  All integers in the header and trailer are unsigned
+ * and little-endian.
+ *
+ * | offset | size | contents                                      |
+ * |--------|------|-----------------------------------------------|
+ * | 0      | 8    | #JB_MAGIC                                     |
+ * | 8      | 4    | format version, #JB_VERSION                   |
+ * | 12     | 4    | reserved, zero                                |
+ * | 16     | 8    | number of nodes                               |
+ * | 24     | ...  | node records                                  |
+ * | end-16 | 8    | number of bytes of node records               |
+ * | end-8  | 8    | checksum of the node records                  |
+ *
+ * Each node record begins with a byte holding the #jd_Type in
+ * its low four bits and the JB_REC_ flags above them.  A record
+ * with #JB_REC_PAYLOAD continues with the payload length as an
+ * unsigned LEB128 number and the payload text followed by a NUL.
+ * Arrays, properties and objects continue with their number of
+ * children as an LEB128 number, and their children's records
+ * follow.  The two children of a property are its label, a
+ * string record kept by the loader in the property node, and
+ * its value.  Numbers are kept as the text from which they were
+ * parsed, so loading a file reproduces the tree exactly.
+ */
+
+#ifndef JBINARY_H
+#define JBINARY_H
+
+#include "jd_Node.h"
+#include "JWriter.h"
+
+/** First eight bytes of every binary file */
+#define JB_MAGIC "jsondom\x1a"
+
+/** Version of the format written */
+#define JB_VERSION 1
+
+/** Bytes before the first node record */
+#define JB_HEADER_SIZE 24
+
+/** Bytes after the last node record */
+#define JB_TRAILER_SIZE 16
+
+/**
+ * @brief Flags in the first byte of a node record
+ */
+typedef enum JBRecordFlag_e {
+   JB_REC_RAW     = 1 << 4,   ///< string keeps its escapes, see #JDN_RAW
+   JB_REC_CLEAN   = 1 << 5,   ///< string needs no escaping, see #JDN_CLEAN
+   JB_REC_PAYLOAD = 1 << 6    ///< payload text follows
+} JBRecordFlag;
+
+/**
+ * @ingroup AllFunctions
+ * @defgroup BinaryFuncs Functions that save and load the binary format
+ * @{
+ */
+void binary_write(JWriter *jw, const jd_Node *root);
+jd_Node *binary_read(const char *data, size_t len, jd_ParseError *pe);
+/** @} */
+
+#endif
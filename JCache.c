@@ -0,0 +1,300 @@
+/** @file JCache.c */
+
+/** Enable st_mtim and strdup: */
+#define _POSIX_C_SOURCE 200809L
+
+#include "JCache.h"
+#include "JFreeze.h"
+#include <stdlib.h>    // malloc/free
+#include <string.h>    // strcmp, strdup
+#include <pthread.h>   // mutex
+
+/**
+ * @brief A cached document and the identity of its file.
+ */
+typedef struct CacheEntry_s CacheEntry;
+struct CacheEntry_s {
+   CacheEntry      *newer;   ///< entry used more recently, NULL for the newest
+   CacheEntry      *older;   ///< entry used less recently, NULL for the oldest
+   char            *path;    ///< path by which the file was opened
+   dev_t           dev;      ///< device of the file
+   ino_t           ino;      ///< inode of the file
+   off_t           size;     ///< size of the file when parsed
+   struct timespec mtime;    ///< modification time of the file when parsed
+   jd_Node         *root;    ///< frozen document, holding the cache's reference
+   size_t          bytes;    ///< memory used by the document
+};
+
+/** Guard of everything below */
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Most recently used entry */
+static CacheEntry *cache_newest = NULL;
+
+/** Least recently used entry, the next to be evicted */
+static CacheEntry *cache_oldest = NULL;
+
+/** Activity and size of the cache */
+static jd_CacheStats cache_stats = { 0, 0, 0, 0, 0, JC_DEFAULT_BUDGET };
+
+/** Tells if @b entry was made from the file described by @b fstats */
+static bool same_file(const CacheEntry *entry, const struct stat *fstats)
+{
+   return entry->dev == fstats->st_dev
+      && entry->ino == fstats->st_ino
+      && entry->size == fstats->st_size
+      && entry->mtime.tv_sec == fstats->st_mtim.tv_sec
+      && entry->mtime.tv_nsec == fstats->st_mtim.tv_nsec;
+}
+
+/** Take an entry out of the order of use */
+static void unlink_entry(CacheEntry *entry)
+{
+   if (entry->newer)
+      entry->newer->older = entry->older;
+   else
+      cache_newest = entry->older;
+
+   if (entry->older)
+      entry->older->newer = entry->newer;
+   else
+      cache_oldest = entry->newer;
+
+   entry->newer = entry->older = NULL;
+   --cache_stats.entries;
+   cache_stats.bytes -= entry->bytes;
+}
+
+/** Put an entry at the front of the order of use */
+static void link_newest(CacheEntry *entry)
+{
+   entry->newer = NULL;
+   entry->older = cache_newest;
+   if (cache_newest)
+      cache_newest->newer = entry;
+   else
+      cache_oldest = entry;
+   cache_newest = entry;
+
+   ++cache_stats.entries;
+   cache_stats.bytes += entry->bytes;
+}
+
+/** Find the entry for @b path */
+static CacheEntry *find_entry(const char *path)
+{
+   for (CacheEntry *entry = cache_newest; entry; entry = entry->older)
+      if (strcmp(entry->path, path) == 0)
+         return entry;
+
+   return NULL;
+}
+
+/**
+ * @brief Evict the least recently used entries until the
+ *        documents fit the budget.
+ * @return Evicted entries, chained by @b older, to be passed to
+ *         #discard_entries once the lock is released
+ */
+static CacheEntry *trim_to_budget(void)
+{
+   CacheEntry *evicted = NULL;
+   while (cache_oldest && cache_stats.bytes > cache_stats.budget)
+   {
+      CacheEntry *entry = cache_oldest;
+      unlink_entry(entry);
+      entry->older = evicted;
+      evicted = entry;
+      ++cache_stats.evictions;
+   }
+
+   return evicted;
+}
+
+/**
+ * @brief Free entries removed from the cache.
+ * @details
+ *    Called without the lock, as freeing a large document takes
+ *    time.  A document still held elsewhere lives on until its
+ *    last holder releases it.
+ */
+static void discard_entries(CacheEntry *entry)
+{
+   while (entry)
+   {
+      CacheEntry *older = entry->older;
+      jd_release(entry->root);
+      free(entry->path);
+      free(entry);
+      entry = older;
+   }
+}
+
+/**
+ * @brief Take a document from the cache if its file is unchanged.
+ * @details
+ *    An entry for @b path whose file has changed is dropped.
+ *
+ * @param path    path of the file
+ * @param fstats  current status of the file
+ * @return A new reference to the cached document, or NULL if
+ *         there is none for the file as it is now
+ */
+jd_Node *cache_find(const char *path, const struct stat *fstats)
+{
+   jd_Node *root = NULL;
+   CacheEntry *stale = NULL;
+
+   pthread_mutex_lock(&cache_lock);
+
+   CacheEntry *entry = find_entry(path);
+   if (entry)
+   {
+      unlink_entry(entry);
+      if (same_file(entry, fstats))
+      {
+         link_newest(entry);
+         root = jd_retain(entry->root);
+      }
+      else
+         stale = entry;
+   }
+
+   if (root)
+      ++cache_stats.hits;
+   else
+      ++cache_stats.misses;
+
+   pthread_mutex_unlock(&cache_lock);
+
+   discard_entries(stale);
+   return root;
+}
+
+/**
+ * @brief Add a newly parsed document to the cache.
+ * @details
+ *    If another thread cached the same file in the meantime, its
+ *    document is used and @b root is released.  A document larger
+ *    than the whole budget, or one that cannot be recorded for
+ *    lack of memory, is returned without being cached.
+ *
+ * @param path    path of the file
+ * @param fstats  status of the file when it was opened for parsing
+ * @param root    frozen document parsed from the file, whose
+ *                reference passes to this function
+ * @return A reference to the document to be used
+ */
+jd_Node *cache_insert(const char *path, const struct stat *fstats, jd_Node *root)
+{
+   freeze_size size;
+   freeze_measure(root, &size);
+
+   CacheEntry *entry = (CacheEntry*)malloc(sizeof(CacheEntry));
+   char *path_copy = strdup(path);
+   if (entry == NULL || path_copy == NULL)
+   {
+      free(entry);
+      free(path_copy);
+      return root;
+   }
+
+   entry->newer = entry->older = NULL;
+   entry->path = path_copy;
+   entry->dev = fstats->st_dev;
+   entry->ino = fstats->st_ino;
+   entry->size = fstats->st_size;
+   entry->mtime = fstats->st_mtim;
+   entry->root = root;
+   entry->bytes = freeze_nodes_bytes(&size) + size.index_bytes + size.string_bytes;
+
+   jd_Node *result = root;
+   CacheEntry *discard = NULL;
+
+   pthread_mutex_lock(&cache_lock);
+
+   CacheEntry *existing = find_entry(path);
+   if (existing && same_file(existing, fstats))
+   {
+      unlink_entry(existing);
+      link_newest(existing);
+      result = jd_retain(existing->root);
+      discard = entry;
+   }
+   else
+   {
+      if (existing)
+      {
+         unlink_entry(existing);
+         discard = existing;
+      }
+
+      if (entry->bytes > cache_stats.budget)
+      {
+         entry->root = NULL;
+         entry->older = discard;
+         discard = entry;
+      }
+      else
+      {
+         jd_retain(root);
+         link_newest(entry);
+
+         CacheEntry *evicted = trim_to_budget();
+         if (discard)
+            discard->older = evicted;
+         else
+            discard = evicted;
+      }
+   }
+
+   pthread_mutex_unlock(&cache_lock);
+
+   discard_entries(discard);
+   return result;
+}
+
+/**
+ * @brief Set the most memory the cached documents may use,
+ *        evicting entries as needed to fit.
+ */
+void cache_set_budget(size_t bytes)
+{
+   pthread_mutex_lock(&cache_lock);
+   cache_stats.budget = bytes;
+   CacheEntry *evicted = trim_to_budget();
+   pthread_mutex_unlock(&cache_lock);
+
+   discard_entries(evicted);
+}
+
+/**
+ * @brief Copy the activity counts and size of the cache.
+ */
+void cache_get_stats(jd_CacheStats *stats)
+{
+   pthread_mutex_lock(&cache_lock);
+   *stats = cache_stats;
+   pthread_mutex_unlock(&cache_lock);
+}
+
+/**
+ * @brief Remove every entry from the cache.
+ */
+void cache_clear(void)
+{
+   pthread_mutex_lock(&cache_lock);
+
+   CacheEntry *entries = NULL;
+   while (cache_newest)
+   {
+      CacheEntry *entry = cache_newest;
+      unlink_entry(entry);
+      entry->older = entries;
+      entries = entry;
+   }
+
+   pthread_mutex_unlock(&cache_lock);
+
+   discard_entries(entries);
+}
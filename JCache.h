@@ -0,0 +1,37 @@
+/**
+ * @file JCache.h
+ * @brief Process-wide cache of frozen documents parsed from files.
+ *
+ * Each entry holds a frozen document with the identity of the
+ * file it came from: device, inode, size and modification time.
+ * An entry is used only while the file still has that identity,
+ * so a file that is replaced or rewritten is parsed again.
+ *
+ * Entries are kept in order of use and the least recently used
+ * are dropped when the documents exceed the memory budget.  A
+ * single mutex guards the cache; the documents themselves are
+ * frozen, so holders read them without locking.
+ */
+
+#ifndef JCACHE_H
+#define JCACHE_H
+
+#include <sys/stat.h>
+#include "jsondom.h"
+
+/** Memory budget of a new cache, in bytes */
+#define JC_DEFAULT_BUDGET (64 * 1024 * 1024)
+
+/**
+ * @ingroup AllFunctions
+ * @defgroup CacheFuncs Functions that keep parsed documents for reuse
+ * @{
+ */
+jd_Node *cache_find(const char *path, const struct stat *fstats);
+jd_Node *cache_insert(const char *path, const struct stat *fstats, jd_Node *root);
+void cache_set_budget(size_t bytes);
+void cache_get_stats(jd_CacheStats *stats);
+void cache_clear(void);
+/** @} */
+
+#endif
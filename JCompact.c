@@ -0,0 +1,219 @@
+/** @file JCompact.c */
+
+#include "JCompact.h"
+#include "JAlloc.h"
+#include "JMemory.h"
+#include <string.h>   // memcpy, memcmp
+
+/**
+ * @brief Tells if a node has text to be copied to the heap.
+ */
+static inline bool has_heap_text(const jd_Node *node)
+{
+   return node->type != JD_NULL && node->type != JD_TRUE
+      && node->type != JD_FALSE && jd_Node_has_text(node);
+}
+
+/**
+ * @brief Build a compact copy of the tree under @b root.
+ * @details
+ *    One pass measures the tree, and a second copies it in
+ *    document order without recursion.  Leaving a subtree
+ *    climbs the indexes already written, so no stack is kept.
+ *
+ * @param root       top of the tree to copy
+ * @param allocator  source of the block, kept by the copy to free
+ * @return The copy, or NULL if out of memory or if the tree has
+ *         too many nodes or too much text for 32-bit indexes
+ */
+jd_Compact *compact_tree(const jd_Node *root, const jd_Allocator *allocator)
+{
+   size_t count = 0, heap_len = 0;
+   for (const jd_Node *node = root; node; node = jd_Node_next_in_tree(node, root))
+   {
+      ++count;
+      if (has_heap_text(node))
+         heap_len += jd_Node_payload_length(node) + 1;
+   }
+
+   if (count >= JD_COMPACT_NONE || heap_len > UINT32_MAX)
+      return NULL;
+
+   jd_Compact *doc = (jd_Compact*)mem_alloc(allocator,
+                                            sizeof(jd_Compact) + count * sizeof(JCNode) + heap_len);
+   if (doc == NULL)
+      return NULL;
+
+   doc->allocator = allocator;
+   doc->count = (uint32_t)count;
+   doc->heap_len = (uint32_t)heap_len;
+
+   char *heap = (char*)compact_heap(doc);
+   uint32_t heap_used = 0;
+   uint32_t index = 0, parent = JD_COMPACT_NONE, prev = JD_COMPACT_NONE;
+   const jd_Node *src = root;
+
+   for (;;)
+   {
+      JCNode *node = &doc->nodes[index];
+      node->parent = parent;
+      node->next = JD_COMPACT_NONE;
+      node->text = node->length = 0;
+      node->type = (uint8_t)src->type;
+      node->flags = (uint8_t)(src->flags & (JDN_RAW | JDN_CLEAN));
+      node->reserved = 0;
+
+      if (has_heap_text(src))
+      {
+         size_t len = jd_Node_payload_length(src);
+         if (src->payload)
+            memcpy(heap + heap_used, jd_Node_payload(src), len);
+         heap[heap_used + len] = '\0';
+         node->text = heap_used;
+         node->length = (uint32_t)len;
+         heap_used += (uint32_t)len + 1;
+      }
+
+      if (prev != JD_COMPACT_NONE)
+         doc->nodes[prev].next = index;
+
+      const jd_Node *child = jd_Node_relation(src, JD_FIRST);
+      if (child)
+      {
+         parent = index++;
+         prev = JD_COMPACT_NONE;
+         src = child;
+         continue;
+      }
+
+      // Climb out of finished subtrees to the next sibling
+      prev = index++;
+      const jd_Node *next = NULL;
+      while (src != root && (next = jd_Node_relation(src, JD_NEXT)) == NULL)
+      {
+         src = jd_Node_relation(src, JD_PARENT);
+         prev = doc->nodes[prev].parent;
+      }
+
+      if (src == root)
+         break;
+
+      src = next;
+      parent = doc->nodes[prev].parent;
+   }
+
+   return doc;
+}
+
+/**
+ * @brief Free a compact tree.
+ */
+void compact_destroy(jd_Compact *doc)
+{
+   mem_free(doc->allocator, doc);
+}
+
+/**
+ * @brief Follow a link of a compact node.
+ * @details
+ *    The parent, next sibling and first child are found at once.
+ *    The previous sibling and last child are found by walking the
+ *    siblings from the first.
+ *
+ * @return Index of the relation, or #JD_COMPACT_NONE if there is none
+ */
+uint32_t compact_relation(const jd_Compact *doc, uint32_t node, jd_Relation relation)
+{
+   uint32_t parent, cur;
+
+   switch(relation)
+   {
+      case JD_PARENT:
+         return doc->nodes[node].parent;
+
+      case JD_NEXT:
+         return doc->nodes[node].next;
+
+      case JD_FIRST:
+         return compact_first(doc, node);
+
+      case JD_PREVIOUS:
+         parent = doc->nodes[node].parent;
+         if (parent == JD_COMPACT_NONE || (cur = parent + 1) == node)
+            return JD_COMPACT_NONE;
+         while (doc->nodes[cur].next != node)
+            cur = doc->nodes[cur].next;
+         return cur;
+
+      case JD_LAST:
+         if ((cur = compact_first(doc, node)) == JD_COMPACT_NONE)
+            return JD_COMPACT_NONE;
+         while (doc->nodes[cur].next != JD_COMPACT_NONE)
+            cur = doc->nodes[cur].next;
+         return cur;
+
+      default:
+         return JD_COMPACT_NONE;
+   }
+}
+
+/**
+ * @brief Get the text of a compact node and its length.
+ * @return Text of a string, number or keyword node, the label of
+ *         a property, NULL for other nodes
+ */
+const char *compact_text(const jd_Compact *doc, uint32_t node, size_t *length)
+{
+   const JCNode *cn = &doc->nodes[node];
+
+   switch(cn->type)
+   {
+      case JD_NULL:   *length = 4; return "null";
+      case JD_TRUE:   *length = 4; return "true";
+      case JD_FALSE:  *length = 5; return "false";
+
+      case JD_STRING:
+      case JD_INTEGER:
+      case JD_FLOAT:
+      case JD_PROPERTY:
+         *length = cn->length;
+         return compact_heap(doc) + cn->text;
+
+      default:
+         *length = 0;
+         return NULL;
+   }
+}
+
+/**
+ * @brief Search the properties of a compact object for a label.
+ * @return Index of the first property with the label, or
+ *         #JD_COMPACT_NONE if there is none
+ */
+uint32_t compact_find_property(const jd_Compact *doc, uint32_t object,
+                               const char *label, size_t len)
+{
+   const char *heap = compact_heap(doc);
+
+   for (uint32_t cur = compact_first(doc, object);
+        cur != JD_COMPACT_NONE;
+        cur = doc->nodes[cur].next)
+   {
+      const JCNode *cn = &doc->nodes[cur];
+      if (cn->length == len && memcmp(heap + cn->text, label, len) == 0)
+         return cur;
+   }
+
+   return JD_COMPACT_NONE;
+}
+
+/**
+ * @brief Memory held by a compact tree, with the estimated
+ *        overhead of its block.
+ */
+size_t compact_size(const jd_Compact *doc)
+{
+   return memory_block_size(sizeof(jd_Compact)
+                            + doc->count * sizeof(JCNode)
+                            + doc->heap_len);
+}
@@ -0,0 +1,72 @@
+/**
+ * @file JCompact.h
+ * @brief A read-only tree of small nodes linked by index.
+ *
+ * The nodes of a compact tree sit in one array in document order,
+ * so the first child of a node, if it has any, is the node after
+ * it, and each node keeps only the indexes of its parent and next
+ * sibling.  Payloads are offsets into a heap of text that follows
+ * the array in the same block.
+ */
+
+#ifndef JCOMPACT_H
+#define JCOMPACT_H
+
+#include "jd_Node.h"
+#include <stdint.h>   // uint32_t, uint8_t
+
+/**
+ * @brief Node of a compact tree, 20 bytes against the 64 of a jd_Node.
+ * @details
+ *    A node without text has a #length and #text of zero.  The
+ *    previous sibling and last child are found by walking the
+ *    siblings, as they are only needed while a tree is built.
+ */
+typedef struct JCNode_s {
+   uint32_t parent;     ///< index of the parent, #JD_COMPACT_NONE for the root
+   uint32_t next;       ///< index of the next sibling, #JD_COMPACT_NONE for the last
+   uint32_t text;       ///< offset of the payload or label in the heap
+   uint32_t length;     ///< bytes of text, not counting its terminating NUL
+   uint8_t  type;       ///< #jd_Type of the node
+   uint8_t  flags;      ///< #JDN_RAW and #JDN_CLEAN of the original
+   uint16_t reserved;   ///< zero, pads the node to a multiple of four bytes
+} JCNode;
+
+/**
+ * @brief A compact tree, in a single block with its nodes and heap.
+ */
+struct jd_Compact_s {
+   const jd_Allocator *allocator;  ///< source of the block, to free it
+   uint32_t           count;       ///< number of nodes
+   uint32_t           heap_len;    ///< bytes of text after the nodes
+   JCNode             nodes[];     ///< nodes in document order, then the heap
+};
+
+/** Text of the heap that follows the nodes */
+static inline const char *compact_heap(const jd_Compact *doc)
+{
+   return (const char*)&doc->nodes[doc->count];
+}
+
+/** Index of the first child of @b node, or #JD_COMPACT_NONE */
+static inline uint32_t compact_first(const jd_Compact *doc, uint32_t node)
+{
+   uint32_t first = node + 1;
+   return first < doc->count && doc->nodes[first].parent == node ? first : JD_COMPACT_NONE;
+}
+
+/**
+ * @ingroup AllFunctions
+ * @defgroup CompactFuncs Functions that build and read compact trees
+ * @{
+ */
+jd_Compact *compact_tree(const jd_Node *root, const jd_Allocator *allocator);
+void compact_destroy(jd_Compact *doc);
+uint32_t compact_relation(const jd_Compact *doc, uint32_t node, jd_Relation relation);
+const char *compact_text(const jd_Compact *doc, uint32_t node, size_t *length);
+uint32_t compact_find_property(const jd_Compact *doc, uint32_t object,
+                               const char *label, size_t len);
+size_t compact_size(const jd_Compact *doc);
+/** @} */
+
+#endif
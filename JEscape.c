@@ -0,0 +1,194 @@
+/** @file JEscape.c */
+
+#include "JEscape.h"
+#include <stdint.h>   // uint64_t
+#include <string.h>   // memcpy
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * @brief Characters that may appear unchanged in a JSON string.
+ * @details
+ *    Anything else, the quote, the backslash, and the control
+ *    characters, must be escaped when writing and may signal
+ *    the end of a run of plain characters when reading.
+ */
+#define IS_PLAIN(chr) ((unsigned char)(chr) >= 0x20 && (chr) != '"' && (chr) != '\\')
+
+/** Copy of the first byte in each lane of a 64-bit word */
+#define LANES(byte) (0x0101010101010101ULL * (byte))
+
+/**
+ * @brief Find the first character that is not plain string content.
+ * @details
+ *    Tests sixteen characters at a time when SSE2 is available,
+ *    otherwise eight at a time in a 64-bit word, before finishing
+ *    the tail one character at a time.
+ *
+ * @param ptr   first character to test
+ * @param end   first address past the characters to test
+ * @return Address of the first quote, backslash, or control
+ *         character, or @b end if there are none.
+ */
+const char *json_scan_plain(const char *ptr, const char *end)
+{
+#if defined(__SSE2__)
+   const __m128i quote = _mm_set1_epi8('"');
+   const __m128i backslash = _mm_set1_epi8('\\');
+   const __m128i control = _mm_set1_epi8(0x1F);
+
+   while (end - ptr >= 16)
+   {
+      __m128i chunk = _mm_loadu_si128((const __m128i*)ptr);
+      __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                                  _mm_cmpeq_epi8(chunk, backslash));
+      // Unsigned chunk <= 0x1F if min(chunk, 0x1F) == chunk:
+      hits = _mm_or_si128(hits, _mm_cmpeq_epi8(_mm_min_epu8(chunk, control), chunk));
+
+      int mask = _mm_movemask_epi8(hits);
+      if (mask)
+         return ptr + __builtin_ctz(mask);
+
+      ptr += 16;
+   }
+#else
+   while (end - ptr >= 8)
+   {
+      uint64_t word;
+      memcpy(&word, ptr, sizeof(word));
+
+      // Classic has-zero-byte test on the word XORed with each target,
+      // and a has-byte-less-than test for the control characters:
+      uint64_t quote = word ^ LANES('"');
+      uint64_t backslash = word ^ LANES('\\');
+      uint64_t hits = ((quote - LANES(0x01)) & ~quote)
+         | ((backslash - LANES(0x01)) & ~backslash)
+         | ((word - LANES(0x20)) & ~word);
+
+      if (hits & LANES(0x80))
+         break;
+
+      ptr += 8;
+   }
+#endif
+
+   while (ptr < end && IS_PLAIN(*ptr))
+      ++ptr;
+
+   return ptr;
+}
+
+/**
+ * @brief Characters that follow the backslash for short escapes,
+ *        indexed by the escaped control character
+ */
+static const char short_escapes[0x20] = {
+   0,   0,   0,   0,   0,   0,   0,   0,
+   'b', 't', 'n', 0,   'f', 'r', 0,   0,
+   0,   0,   0,   0,   0,   0,   0,   0,
+   0,   0,   0,   0,   0,   0,   0,   0
+};
+
+/**
+ * @brief Number of characters needed to write the string with escapes.
+ * @param str   string contents, not necessarily NUL-terminated
+ * @param len   number of characters in @b str
+ * @return Length of the escaped string, excluding enclosing quotes
+ */
+size_t json_escaped_length(const char *str, size_t len)
+{
+   const char *end = str + len;
+   size_t total = len;
+
+   while ((str = json_scan_plain(str, end)) < end)
+   {
+      unsigned char chr = (unsigned char)*str++;
+      if (chr == '"' || chr == '\\' || short_escapes[chr])
+         total += 1;    // backslash added
+      else
+         total += 5;    // \u00XX replaces one character
+   }
+
+   return total;
+}
+
+/**
+ * @brief Copy a string, escaping characters as JSON requires.
+ * @details
+ *    The buffer at @b out must have room for at least the
+ *    number of characters returned by #json_escaped_length.
+ *    Enclosing quotes are not written.
+ *
+ * @param out   buffer to which the escaped string will be written
+ * @param str   string contents, not necessarily NUL-terminated
+ * @param len   number of characters in @b str
+ * @return Address following the last character written
+ */
+char *json_escape(char *out, const char *str, size_t len)
+{
+   static const char hex[] = "0123456789abcdef";
+   const char *end = str + len;
+
+   while (str < end)
+   {
+      const char *plain_end = json_scan_plain(str, end);
+      if (plain_end > str)
+      {
+         memcpy(out, str, plain_end - str);
+         out += plain_end - str;
+         str = plain_end;
+         continue;
+      }
+
+      unsigned char chr = (unsigned char)*str++;
+      *out++ = '\\';
+      if (chr == '"' || chr == '\\')
+         *out++ = chr;
+      else if (short_escapes[chr])
+         *out++ = short_escapes[chr];
+      else
+      {
+         *out++ = 'u';
+         *out++ = '0';
+         *out++ = '0';
+         *out++ = hex[chr >> 4];
+         *out++ = hex[chr & 0xF];
+      }
+   }
+
+   return out;
+}
+
+/**
+ * @brief Write a Unicode code point as UTF-8.
+ * @param out        buffer with room for at least four characters
+ * @param codepoint  value no greater than 0x10FFFF
+ * @return Address following the last character written
+ */
+char *json_utf8_encode(char *out, unsigned long codepoint)
+{
+   if (codepoint < 0x80)
+      *out++ = (char)codepoint;
+   else if (codepoint < 0x800)
+   {
+      *out++ = (char)(0xC0 | (codepoint >> 6));
+      *out++ = (char)(0x80 | (codepoint & 0x3F));
+   }
+   else if (codepoint < 0x10000)
+   {
+      *out++ = (char)(0xE0 | (codepoint >> 12));
+      *out++ = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+      *out++ = (char)(0x80 | (codepoint & 0x3F));
+   }
+   else
+   {
+      *out++ = (char)(0xF0 | (codepoint >> 18));
+      *out++ = (char)(0x80 | ((codepoint >> 12) & 0x3F));
+      *out++ = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+      *out++ = (char)(0x80 | (codepoint & 0x3F));
+   }
+
+   return out;
+}
@@ -0,0 +1,22 @@
+/**
+ * @file JEscape.h
+ * @brief Functions for finding, encoding, and decoding JSON string escapes
+ */
+
+#ifndef JESCAPE_H
+#define JESCAPE_H
+
+#include <stddef.h>
+
+/**
+ * @ingroup AllFunctions
+ * @defgroup EscapeFuncs Functions that translate JSON string contents
+ * @{
+ */
+const char *json_scan_plain(const char *ptr, const char *end);
+size_t json_escaped_length(const char *str, size_t len);
+char *json_escape(char *out, const char *str, size_t len);
+char *json_utf8_encode(char *out, unsigned long codepoint);
+/** @} */
+
+#endif
@@ -0,0 +1,378 @@
+/** @file JFreeze.c */
+
+#include "JFreeze.h"
+#include "JPool.h"
+#include "JAlloc.h"
+#include <stdint.h>   // uint64_t, intptr_t
+#include <string.h>   // memcpy, memcmp, memset
+
+/**
+ * @brief Flags a frozen node keeps from its original.
+ * @details
+ *    Everything else describes memory or source text that the
+ *    frozen copy does not share.
+ */
+#define FREEZE_KEPT_FLAGS (JDN_RAW | JDN_CLEAN)
+
+/**
+ * @brief Hash of a property label, FNV-1a.
+ */
+static inline uint64_t label_hash(const char *label, size_t len)
+{
+   uint64_t hash = 0xcbf29ce484222325ULL;
+   for (size_t i = 0; i < len; ++i)
+   {
+      hash ^= (unsigned char)label[i];
+      hash *= 0x100000001b3ULL;
+   }
+   return hash;
+}
+
+/**
+ * @brief Number of index slots for an object with @b count properties.
+ * @details
+ *    At least twice the count, rounded up to a power of two so a
+ *    hash can be reduced to a slot with a mask.
+ */
+static size_t index_slots(size_t count)
+{
+   size_t slots = 2;
+   while (slots < count * 2)
+      slots <<= 1;
+   return slots;
+}
+
+/**
+ * @brief Tells if a property has the given label.
+ */
+static inline bool label_matches(const jd_Node *property, const char *label, size_t len)
+{
+   return property->payload
+      && jd_Node_payload_length(property) == len
+      && memcmp(jd_Node_payload(property), label, len) == 0;
+}
+
+/**
+ * @brief Tells if a node's payload is a string to be copied.
+ */
+static inline bool has_string_payload(const jd_Node *node)
+{
+   return jd_Node_has_text(node) && node->payload;
+}
+
+/**
+ * @brief Add up the memory needed to freeze the tree under @b root.
+ * @details
+ *    Measuring a frozen tree gives the layout of its block.
+ */
+void freeze_measure(const jd_Node *root, freeze_size *size)
+{
+   memset(size, 0, sizeof(freeze_size));
+
+   for (const jd_Node *node = root; node; node = jd_Node_next_in_tree(node, root))
+   {
+      ++size->nodes;
+
+      if (has_string_payload(node))
+         size->string_bytes += jd_Node_payload_length(node) + 1;
+      else if (node->type == JD_OBJECT && node->firstChild)
+      {
+         size_t count = 0;
+         for (const jd_Node *child = jd_Node_relation(node, JD_FIRST);
+              child;
+              child = jd_Node_relation(child, JD_NEXT))
+            ++count;
+
+         size->index_bytes += sizeof(jd_Index) + index_slots(count) * sizeof(jd_Node*);
+      }
+   }
+}
+
+/**
+ * @brief Build the property index of a frozen object.
+ * @param object     object whose children are already in place
+ * @param index_mem  memory sized by #freeze_measure for this object
+ * @return Address following the index
+ */
+static char *freeze_index_object(jd_Node *object, char *index_mem)
+{
+   jd_Index *index = (jd_Index*)index_mem;
+
+   size_t count = 0;
+   for (jd_Node *child = object->firstChild; child; child = child->nextSibling)
+      ++count;
+
+   size_t slots = index_slots(count);
+   index->mask = slots - 1;
+   memset(index->slots, 0, slots * sizeof(jd_Node*));
+
+   // Inserting in document order makes the first of any
+   // duplicate labels the one found:
+   for (jd_Node *child = object->firstChild; child; child = child->nextSibling)
+   {
+      if (child->type != JD_PROPERTY || !child->payload)
+         continue;
+
+      size_t slot = label_hash((const char*)child->payload, child->length) & index->mask;
+      while (index->slots[slot])
+         slot = (slot + 1) & index->mask;
+
+      index->slots[slot] = child;
+   }
+
+   object->payload = index;
+   object->flags |= JDN_INDEXED | JDN_BORROWED;
+
+   return index_mem + sizeof(jd_Index) + slots * sizeof(jd_Node*);
+}
+
+/** Function that provides memory for the next node of a copy */
+typedef jd_Node *(*node_supplier)(void *data);
+
+/**
+ * @brief Copy the nodes and payloads of a tree.
+ * @details
+ *    Nodes are copied in document order, each linked to its
+ *    parent and previous sibling as it is made, so the copy is
+ *    a complete tree at every step and can be destroyed if
+ *    the copy fails part way.  Payload text is copied into
+ *    @b heap, which the copy borrows.  Spans are not copied.
+ *
+ * @param root       top of the tree to be copied
+ * @param dst        memory for the root of the copy
+ * @param heap       memory for payloads, sized by #freeze_measure
+ * @param flags      #jd_NodeFlag bits to set in every copied node
+ * @param next_node  supplies zeroed memory for each further node
+ * @param data       passed to @b next_node
+ * @return True for success, false if @b next_node failed
+ */
+static bool copy_tree(const jd_Node *root,
+                      jd_Node *dst,
+                      char *heap,
+                      unsigned int flags,
+                      node_supplier next_node,
+                      void *data)
+{
+   // Each node goes to the next place supplied while
+   // parent and prev track where it is linked:
+   jd_Node *parent = NULL;
+   jd_Node *prev = NULL;
+   const jd_Node *src = root;
+
+   while (true)
+   {
+      dst->type = src->type;
+      dst->flags = (src->flags & FREEZE_KEPT_FLAGS) | flags;
+      dst->parent = parent;
+      dst->prevSibling = prev;
+
+      if (prev)
+         prev->nextSibling = dst;
+      else if (parent)
+         parent->firstChild = dst;
+
+      if (parent)
+         parent->lastChild = dst;
+
+      if (has_string_payload(src))
+      {
+         size_t len = jd_Node_payload_length(src);
+         memcpy(heap, jd_Node_payload(src), len);
+         heap[len] = '\0';
+         dst->payload = heap;
+         dst->length = len;
+         dst->flags |= JDN_SIZED | JDN_BORROWED;
+         heap += len + 1;
+      }
+
+      if (src->firstChild)
+      {
+         parent = dst;
+         prev = NULL;
+         src = jd_Node_relation(src, JD_FIRST);
+      }
+      else
+      {
+         prev = dst;
+         while (src != root && !src->nextSibling)
+         {
+            src = jd_Node_relation(src, JD_PARENT);
+            prev = parent;
+            parent = parent->parent;
+         }
+
+         if (src == root)
+            return true;
+
+         src = jd_Node_relation(src, JD_NEXT);
+      }
+
+      if ((dst = (*next_node)(data)) == NULL)
+         return false;
+   }
+}
+
+/** #node_supplier that hands out consecutive nodes of an array */
+static jd_Node *next_block_node(void *data)
+{
+   jd_Node **next = (jd_Node**)data;
+   return (*next)++;
+}
+
+/** #node_supplier that takes nodes from the pool, given the allocator as @b data */
+static jd_Node *next_pool_node(void *data)
+{
+   jd_Node *node = pool_node_alloc((const jd_Allocator*)data);
+   if (node)
+      memset(node, 0, sizeof(jd_Node));
+   return node;
+}
+
+/**
+ * @brief Make an immutable copy of a tree in a single block of memory.
+ * @details
+ *    The copy is a #jd_Document whose nodes follow the header in
+ *    document order, followed by the property indexes of its
+ *    objects and then the text of its payloads.  Every node is
+ *    marked #JDN_FROZEN so the functions that would change the
+ *    tree refuse, and the document is freed whole when its
+ *    reference count falls to zero.
+ *
+ *    Spans are not copied: the frozen tree does not keep the
+ *    source of the original.
+ *
+ * @param root       top of the tree to be copied, which is unchanged
+ * @param allocator  source of the block, kept by the copy to free
+ *                   it, or NULL for @c malloc
+ * @return Root of the frozen copy, or NULL if out of memory
+ */
+jd_Node *freeze_tree(const jd_Node *root, const jd_Allocator *allocator)
+{
+   freeze_size size;
+   freeze_measure(root, &size);
+
+   size_t nodes_bytes = freeze_nodes_bytes(&size);
+   jd_Document *doc = (jd_Document*)mem_alloc(allocator,
+                                              nodes_bytes + size.index_bytes + size.string_bytes);
+   if (doc == NULL)
+      return NULL;
+
+   memset(doc, 0, nodes_bytes);
+   doc->refcount = 1;
+   doc->allocator = allocator;
+
+   jd_Node *nodes = (jd_Node*)(doc + 1);
+   char *index_mem = (char*)doc + nodes_bytes;
+   char *heap = index_mem + size.index_bytes;
+
+   copy_tree(root, &doc->root, heap, JDN_FROZEN, next_block_node, &nodes);
+
+   doc->root.flags |= JDN_DOCUMENT;
+
+   // Index objects once all of their properties are in place:
+   nodes = &doc->root;
+   for (const jd_Node *node = nodes; node; node = jd_Node_next_in_tree(node, nodes))
+      if (node->type == JD_OBJECT && node->firstChild)
+         index_mem = freeze_index_object((jd_Node*)node, index_mem);
+
+   return &doc->root;
+}
+
+/**
+ * @brief Find a property in an object's index.
+ * @param index     index of a frozen object
+ * @param relative  true if the index holds offsets from its own
+ *                  address rather than addresses of properties
+ * @param label     label sought, not necessarily NUL-terminated
+ * @param len       number of characters in @b label
+ * @return The first property with the label, or NULL if none
+ */
+jd_Node *index_find(const jd_Index *index, bool relative, const char *label, size_t len)
+{
+   size_t slot = label_hash(label, len) & index->mask;
+
+   jd_Node *property;
+   while ((property = index->slots[slot]))
+   {
+      if (relative)
+         property = (jd_Node*)((const char*)index + (intptr_t)property);
+
+      if (label_matches(property, label, len))
+         return property;
+
+      slot = (slot + 1) & index->mask;
+   }
+
+   return NULL;
+}
+
+/**
+ * @brief Find a property of an object by its label.
+ * @details
+ *    Frozen objects are searched through their index; others
+ *    are searched from the first property.
+ *
+ * @param object  object to search
+ * @param label   label sought, not necessarily NUL-terminated
+ * @param len     number of characters in @b label
+ * @return The first property with the label, or NULL if none
+ */
+jd_Node *find_property(const jd_Node *object, const char *label, size_t len)
+{
+   if (object->flags & JDN_INDEXED)
+      return index_find((const jd_Index*)jd_Node_payload(object),
+                        object->flags & JDN_RELATIVE,
+                        label, len);
+
+   for (jd_Node *child = jd_Node_relation(object, JD_FIRST);
+        child;
+        child = jd_Node_relation(child, JD_NEXT))
+      if (child->type == JD_PROPERTY && label_matches(child, label, len))
+         return child;
+
+   return NULL;
+}
+
+/**
+ * @brief Make an editable copy of a tree.
+ * @details
+ *    The copy is made in one pass.  Its nodes come from the
+ *    pool, and its payload text is copied into a single block
+ *    from #pool_alloc that the payloads borrow.  The caller makes
+ *    the block the source of a #jd_Document so it is freed with
+ *    the copy.  Spans are not copied.
+ *
+ * @param root       top of the tree to be copied, which is unchanged
+ * @param allocator  source of the memory of the copy, or NULL for
+ *                   the default
+ * @param heap       set to the block holding the payload text,
+ *                   or NULL if the tree has no payloads
+ * @param heap_len   set to the size of @b heap
+ * @return Root of the copy, or NULL if out of memory
+ */
+jd_Node *clone_tree(const jd_Node      *root,
+                    const jd_Allocator *allocator,
+                    char               **heap,
+                    size_t             *heap_len)
+{
+   freeze_size size;
+   freeze_measure(root, &size);
+
+   *heap = NULL;
+   *heap_len = size.string_bytes;
+   if (size.string_bytes && (*heap = (char*)pool_alloc(size.string_bytes, allocator)) == NULL)
+      return NULL;
+
+   void *data = (void*)allocator;
+   jd_Node *copy = next_pool_node(data);
+   if (copy && !copy_tree(root, copy, *heap, 0, next_pool_node, data))
+      jd_Node_destroy(&copy, allocator);
+
+   if (copy == NULL)
+   {
+      pool_free(*heap);
+      *heap = NULL;
+   }
+
+   return copy;
+}
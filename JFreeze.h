@@ -0,0 +1,44 @@
+/**
+ * @file JFreeze.h
+ * @brief Functions that copy jd_Node trees and search frozen ones.
+ */
+
+#ifndef JFREEZE_H
+#define JFREEZE_H
+
+#include "jd_Node.h"
+
+/**
+ * @brief Memory needed for a frozen copy of a tree.
+ * @details
+ *    A frozen block holds the document with its root, the other
+ *    nodes, the indexes, and the payload text, in that order.
+ */
+typedef struct freeze_size_s {
+   size_t nodes;         ///< number of nodes, including the root
+   size_t index_bytes;   ///< memory for the property indexes of objects
+   size_t string_bytes;  ///< memory for payloads, with a terminating NUL each
+} freeze_size;
+
+/** Memory for the document and nodes at the start of a frozen block */
+static inline size_t freeze_nodes_bytes(const freeze_size *size)
+{
+   return sizeof(jd_Document) + (size->nodes - 1) * sizeof(jd_Node);
+}
+
+/**
+ * @ingroup AllFunctions
+ * @defgroup FreezeFuncs Functions that copy trees and search frozen ones
+ * @{
+ */
+void freeze_measure(const jd_Node *root, freeze_size *size);
+jd_Node *freeze_tree(const jd_Node *root, const jd_Allocator *allocator);
+jd_Node *clone_tree(const jd_Node      *root,
+                    const jd_Allocator *allocator,
+                    char               **heap,
+                    size_t             *heap_len);
+jd_Node *index_find(const jd_Index *index, bool relative, const char *label, size_t len);
+jd_Node *find_property(const jd_Node *object, const char *label, size_t len);
+/** @} */
+
+#endif
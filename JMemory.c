@@ -0,0 +1,119 @@
+/** @file JMemory.c */
+
+#include "JMemory.h"
+#include "jd_Node.h"
+#include "JPool.h"
+#include <string.h>   // memset
+
+/**
+ * @brief Estimated size of the block the system allocator uses
+ *        for a request of @b size bytes.
+ * @details
+ *    Follows the common layout of a size word before each block,
+ *    rounded up to twice the word size, with a minimum of four
+ *    words.
+ */
+size_t memory_block_size(size_t size)
+{
+   const size_t align = 2 * sizeof(size_t);
+   size_t block = (size + sizeof(size_t) + align - 1) & ~(align - 1);
+   return block < 2 * align ? 2 * align : block;
+}
+
+/**
+ * @brief Charge the overhead of a block of @b size bytes requested
+ *        from the system allocator, @b used of which are already counted.
+ */
+static inline void charge_block(jd_MemoryUsage *usage, size_t size, size_t used)
+{
+   usage->overhead_bytes += memory_block_size(size) - used;
+}
+
+/**
+ * @brief Charge the text of a string or number payload, or of
+ *        a property label.
+ * @details
+ *    Text left in the source belongs to the document, and is
+ *    counted there.  Text of a frozen tree is part of its block.
+ */
+static void charge_payload(const jd_Node *node, jd_MemoryUsage *usage)
+{
+   if (!jd_Node_has_text(node) || node->payload == NULL)
+      return;
+
+   size_t len = jd_Node_payload_length(node) + 1;
+
+   if (node->flags & JDN_FROZEN)
+      usage->payload_bytes[node->type] += len;
+   else if (node->flags & JDN_BORROWED)
+      return;
+   else if (node->flags & JDN_POOLED)
+   {
+      usage->payload_bytes[node->type] += len;
+      charge_block(usage, pool_block_size(node->payload, len), len);
+   }
+   else
+   {
+      usage->payload_bytes[node->type] += len;
+      charge_block(usage, len, len);
+   }
+}
+
+/**
+ * @brief Measure the memory held by the tree under @b node.
+ * @details
+ *    Nodes of an editable tree are charged a block each, a frozen
+ *    tree a single block, and a mapped snapshot nothing beyond its
+ *    contents.  The document and the source it keeps are counted
+ *    only when @b node is the root of a document.
+ *
+ * @param node   top of the tree to measure, or NULL
+ * @param usage  report to fill in
+ */
+void memory_usage(const jd_Node *node, jd_MemoryUsage *usage)
+{
+   memset(usage, 0, sizeof(jd_MemoryUsage));
+   if (node == NULL)
+      return;
+
+   bool frozen = (node->flags & JDN_FROZEN) != 0;
+   bool document = (node->flags & JDN_DOCUMENT) != 0;
+
+   for (const jd_Node *cur = node; cur; cur = jd_Node_next_in_tree(cur, node))
+   {
+      ++usage->nodes[cur->type];
+      usage->node_bytes[cur->type] += sizeof(jd_Node);
+      if (!frozen && !(cur == node && document))
+         charge_block(usage, sizeof(jd_Node), sizeof(jd_Node));
+
+      charge_payload(cur, usage);
+
+      if (cur->flags & JDN_INDEXED)
+      {
+         const jd_Index *index = (const jd_Index*)jd_Node_payload(cur);
+         usage->index_bytes += sizeof(jd_Index) + (index->mask + 1) * sizeof(jd_Node*);
+      }
+   }
+
+   size_t sum = usage->index_bytes;
+   for (int type = 0; type <= JD_OBJECT; ++type)
+      sum += usage->node_bytes[type] + usage->payload_bytes[type];
+
+   if (document)
+   {
+      const jd_Document *doc = (const jd_Document*)node;
+      usage->document_bytes = sizeof(jd_Document) - sizeof(jd_Node);
+      sum += usage->document_bytes;
+
+      if (!frozen)
+      {
+         charge_block(usage, sizeof(jd_Document), sizeof(jd_Document));
+         if (doc->release)
+            usage->source_bytes = doc->source_len;
+      }
+      else if (!(node->flags & JDN_RELATIVE))
+         charge_block(usage, sum, sum);
+   }
+
+   usage->total_bytes = sum + usage->source_bytes + usage->overhead_bytes;
+}
@@ -0,0 +1,25 @@
+/**
+ * @file JMemory.h
+ * @brief Accounting of the memory held by a tree.
+ *
+ * The tree is walked without recursion, and each node, payload,
+ * index and document is charged what it was allocated, with the
+ * rounding and headers of the pool and the system allocator
+ * estimated as overhead.
+ */
+
+#ifndef JMEMORY_H
+#define JMEMORY_H
+
+#include "jsondom.h"
+
+/**
+ * @ingroup AllFunctions
+ * @defgroup MemoryFuncs Functions that measure the memory of trees
+ * @{
+ */
+size_t memory_block_size(size_t size);
+void memory_usage(const jd_Node *node, jd_MemoryUsage *usage);
+/** @} */
+
+#endif
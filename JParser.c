@@ -5,52 +5,143 @@
 
 #include <stdio.h>    // dprintf
 #include <stdlib.h>   // malloc/free
-#include <unistd.h>   // open/read/lseek
+#include <unistd.h>   // open/read
 #include <ctype.h>    // isspace
-#include <string.h>   // strerror
+#include <string.h>   // strerror, memcmp, memcpy
 #include <fcntl.h>    // open()
 #include <errno.h>    // errno for open()
-#include <stdarg.h>   // for va_start, etc, for vprintf
 #include <assert.h>
 
 #include "JParser.h"
 #include "JReadString.h"
 #include "isJsonNumber.h"
+#include "JPool.h"
 
-void report_parse_error(jd_ParseError *pe, int fh, const char *message)
+/**
+ * @brief Record a parse error at the reader's current position.
+ * @details
+ *    Finds the line and column by searching the window for
+ *    newlines, so it must only be called when a parse fails.
+ */
+void report_parse_error(jd_ParseError *pe, const JReader *jr, const char *message)
 {
-   off_t offset = lseek(fh, 0, SEEK_CUR);
-   pe->char_loc = offset;
+   size_t offset = JReaderOffset(jr);
+   size_t line, column;
+   JReaderPosition(jr, offset, &line, &column);
+
+   pe->char_loc = (int)offset;
    pe->message = message;
+   pe->line = (int)line;
+   pe->column = (int)column;
+   JReaderExcerpt(jr, offset, pe->excerpt, sizeof(pe->excerpt));
+}
+
+void Standard_Report_Error(void *data, const jd_ParseError *pe)
+{
+   if (pe->line > 0)
+      printf("at line %d, column %d, %s\n   %s\n",
+             pe->line, pe->column, pe->message, pe->excerpt);
+   else
+      printf("at file position %d, %s\n", pe->char_loc, pe->message);
+}
+
+/**
+ * @brief Move the string collected by @b rsh into @b node.
+ * @details
+ *    Sets the string payload according to how the string was
+ *    read: left in the source, or decoded or not into a new
+ *    memory block.
+ */
+void take_read_string(jd_Node *node, RSHandle *rsh)
+{
+   size_t length = rsh->length;
+   bool borrowed = rsh->borrowed;
+   bool raw = rsh->raw;
+   bool clean = rsh->clean;
+
+   const char *str = StealReadString(rsh);
+   if (borrowed)
+      jd_Node_borrow_string(node, str, length);
+   else
+      jd_Node_take_pooled_string(node, str, length);
+
+   if (raw)
+      node->flags |= JDN_RAW;
+   else if (clean)
+      node->flags |= JDN_CLEAN;
 }
 
-bool Standard_Report_Error(int source_fh, const char *format, ...)
+/**
+ * @brief Move a number collected by @b rsh into @b node.
+ * @details
+ *    A number left in the window is copied to an exact-size
+ *    block unless the tree may refer to the source.
+ * @param jr    reader from which the number was read
+ * @param node  node to take the number
+ * @param rsh   handle that collected the number
+ * @return True for success, false if out of memory
+ */
+bool take_read_number(JReader *jr, jd_Node *node, RSHandle *rsh)
 {
-   off_t offset = lseek(source_fh, 0, SEEK_CUR);
-   printf("at file position %ld, ", offset);
-   va_list pargs;
-   va_start(pargs, format);
-   vprintf(format, pargs);
-   va_end(pargs);
-   printf("\n");
-   return true;   // default exit after any error
+   if (rsh->borrowed && !JReaderZeroCopy(jr))
+   {
+      char *copy = (char*)pool_alloc(rsh->length + 1, jr->allocator);
+      if (!copy)
+         return false;
+
+      memcpy(copy, rsh->string, rsh->length);
+      copy[rsh->length] = '\0';
+      jd_Node_take_pooled_string(node, copy, rsh->length);
+      rsh->string = NULL;
+   }
+   else
+      take_read_string(node, rsh);
+
+   return true;
 }
 
-Error_Reporter Report_Error = Standard_Report_Error;
+/**
+ * @brief Identify an unquoted keyword.
+ * @details
+ *    Compares whole words, which the compiler reduces to a
+ *    single load and compare for each keyword.
+ * @param token   text of the unquoted value
+ * @param length  number of characters in @b token
+ * @param type    set to the type named by the keyword
+ * @return True if @b token is a keyword, false if not
+ */
+bool keyword_type(const char *token, size_t length, jd_Type *type)
+{
+   if (length == 4)
+   {
+      if (memcmp(token, "null", 4) == 0)
+         *type = JD_NULL;
+      else if (memcmp(token, "true", 4) == 0)
+         *type = JD_TRUE;
+      else
+         return false;
+   }
+   else if (length == 5 && memcmp(token, "false", 5) == 0)
+      *type = JD_FALSE;
+   else
+      return false;
+
+   return true;
+}
 
 /** Implementation of CollectionTools_s::Is_End_Char when processing an array */
 bool Array_IsEndChar(char chr) { return chr == ']'; }
 /** Implementation of CollectionTools_s::Coerce_type when processing an array */
 bool Array_CoerceType(jd_Node *node) { return jd_Node_make_array(node); }
 /** Implementation of CollectionTools_s::ReadMember when processing an array */
-bool Array_ReadMember(int           fh,
+bool Array_ReadMember(JReader       *jr,
                       jd_Node       *parent,
                       jd_Node       **new_node,
                       char          first_char,
                       char          *end_signal,
                       jd_ParseError *pe)
 {
-   return JParser(fh, parent, new_node, first_char, end_signal, pe);
+   return JParser(jr, parent, new_node, first_char, end_signal, pe);
 }
 
 /**
@@ -68,7 +159,7 @@ bool Object_IsEndChar(char chr) { return chr == '}'; }
 /** Implementation of CollectionTools_s::Coerce_type when processing an object */
 bool Object_CoerceType(jd_Node *node) { return jd_Node_make_object(node); }
 /** Implementation of CollectionTools_s::ReadMember when processing an object */
-bool Object_ReadMember(int fh,
+bool Object_ReadMember(JReader       *jr,
                        jd_Node       *parent,
                        jd_Node       **new_node,
                        char          first_char,
@@ -82,7 +173,7 @@ bool Object_ReadMember(int fh,
 
    if (first_char != '"')
    {
-      report_parse_error(pe, fh,
+      report_parse_error(pe, jr,
                          "labels must be double-quoted");
       // if ((*Report_Error)(
       //        fh,
@@ -93,15 +184,15 @@ bool Object_ReadMember(int fh,
 
    // Read the string that's queued-up:
    ReadStringInit(&rsh_label, first_char);
-   if (JReadString(fh, &rsh_label, pe))
+   if (JReadString(jr, &rsh_label, pe))
    {
       jd_Node *value_node = NULL;
       bool past_colon = false;
+      bool got_char;
       char chr;
-      ssize_t bytes_read;
 
       // Find colon, skip spaces, then read the value
-      while ((bytes_read = read(fh, &chr, 1)) == 1)
+      while ((got_char = JReaderGetChar(jr, &chr)))
       {
          if (isspace(chr))
             continue;
@@ -110,28 +201,28 @@ bool Object_ReadMember(int fh,
          else if (past_colon)
          {
             char temp_end_signal = 0;
-            if (JParser(fh, NULL, &value_node, chr, &temp_end_signal, pe))
+            if (JParser(jr, NULL, &value_node, chr, &temp_end_signal, pe))
             {
                // We have the label string and value node,
-               // so we can build the property now:
+               // so we can build the property now, the
+               // label becoming the property's own payload:
                jd_Node *prop_node = NULL;
-               if (jd_Node_create(&prop_node, parent, NULL))
+               if (jd_Node_create(&prop_node, parent, NULL, jr->allocator))
                {
+                  take_read_string(prop_node, &rsh_label);
                   prop_node->type = JD_PROPERTY;
-                  jd_Node *label_node = NULL;
-                  if (jd_Node_create(&label_node, prop_node, NULL))
-                  {
-                     jd_Node_take_string(label_node, StealReadString(&rsh_label));
-                     jd_Node_adopt(value_node, prop_node, NULL);
+                  jd_Node_adopt(value_node, prop_node, NULL);
 
-                     *new_node = prop_node;
-                     retval = true;
+                  *new_node = prop_node;
+                  retval = true;
 
-                     if (end_signal)
-                        *end_signal = temp_end_signal;
-                  }
-                  else
-                     jd_Node_destroy(&prop_node);
+                  if (end_signal)
+                     *end_signal = temp_end_signal;
+               }
+               else
+               {
+                  report_parse_error(pe, jr, "out of memory");
+                  jd_Node_destroy(&value_node, jr->allocator);
                }
             }
 
@@ -141,7 +232,7 @@ bool Object_ReadMember(int fh,
          else
          {
             // A non-colon character after label is an error
-            report_parse_error(pe, fh,
+            report_parse_error(pe, jr,
                                "colons must follow labels");
             // if ((*Report_Error)(
             //        fh,
@@ -152,8 +243,8 @@ bool Object_ReadMember(int fh,
          }
       } // while (bytes_read = read...)
 
-      if (bytes_read == 0)
-         report_parse_error(pe, fh, "unexpected end-of-file");
+      if (!got_char)
+         report_parse_error(pe, jr, "unexpected end-of-file");
 
    } //  if (JReadString())
 
@@ -181,7 +272,7 @@ CollectionTools objectTools = {
  * data using the struct of function pointers to test and read
  * according to the collection type being created.
  */
-bool parse_collection(int             fh,
+bool parse_collection(JReader         *jr,
                       jd_Node         *parent,
                       CollectionTools *tools,
                       jd_Node         **node,
@@ -191,16 +282,20 @@ bool parse_collection(int             fh,
    bool needs_member = false;
    bool collection_terminated = false;
 
+   // The opening bracket has already been read:
+   const char *span_start = JReaderKeepSpans(jr) ? jr->ptr - 1 : NULL;
+
+   if (++jr->depth > jr->max_depth)
+      jr->max_depth = jr->depth;
 
-   ssize_t chars_read;
    char chr = '\0';
 
    jd_Node *new_node = NULL;
-   if (jd_Node_create(&new_node, NULL, NULL))
+   if (jd_Node_create(&new_node, NULL, NULL, jr->allocator))
    {
       if ((*tools->coerce_type)(new_node))
       {
-         while ( (chars_read = read(fh, &chr, 1)) == 1 )
+         while (JReaderGetChar(jr, &chr))
          {
             if (isspace(chr))
                continue;
@@ -209,7 +304,7 @@ bool parse_collection(int             fh,
             {
                if (chr == ',')
                {
-                  report_parse_error(pe, fh,
+                  report_parse_error(pe, jr,
                                      "comma in collection without preceeding member");
                   goto early_exit;
                }
@@ -220,19 +315,19 @@ bool parse_collection(int             fh,
                {
                   if (needs_member)
                   {
-                     report_parse_error(pe, fh,
+                     report_parse_error(pe, jr,
                                         "collection prematurely terminated");
                      goto early_exit;
                   }
                   else
-                     retval = true;
+                     retval = collection_terminated = true;
 
                   // Goto parent attachment if appropriate
                   break;
                }
                else if (chr==']' || chr=='}')
                {
-                  report_parse_error(pe, fh,
+                  report_parse_error(pe, jr,
                                      "incorrect end char for the collection type");
                   goto early_exit;
                }
@@ -240,7 +335,7 @@ bool parse_collection(int             fh,
                {
                   if (new_node->firstChild == NULL)
                   {
-                     report_parse_error(pe, fh,
+                     report_parse_error(pe, jr,
                                         "comma in collection without preceeding member");
                      goto early_exit;
                   }
@@ -252,7 +347,7 @@ bool parse_collection(int             fh,
                }
                else if (new_node->firstChild != NULL)
                {
-                  report_parse_error(pe, fh,
+                  report_parse_error(pe, jr,
                                      "missing comma between collection members");
                   goto early_exit;
                }
@@ -260,7 +355,7 @@ bool parse_collection(int             fh,
 
             char end_char = '\0';
             jd_Node *new_el = NULL;
-            if ((*tools->read_member)(fh, new_node, &new_el, chr, &end_char, pe))
+            if ((*tools->read_member)(jr, new_node, &new_el, chr, &end_char, pe))
             {
                needs_member = false;
 
@@ -268,7 +363,7 @@ bool parse_collection(int             fh,
                   needs_member = true;
                else if ((*tools->is_end_char)(end_char))
                {
-                  retval = true;
+                  retval = collection_terminated = true;
                   // Goto parent attachment if appropriate
                   break;
                }
@@ -278,7 +373,7 @@ bool parse_collection(int             fh,
                   continue;
                else
                {
-                  report_parse_error(pe, fh,
+                  report_parse_error(pe, jr,
                                      "unexpected member end char");
                   goto early_exit;
                }
@@ -292,6 +387,9 @@ bool parse_collection(int             fh,
 
          if (retval)
          {
+            if (span_start)
+               jd_Node_set_span(new_node, span_start, jr->ptr - span_start);
+
             if (parent)
                jd_Node_adopt(new_node, parent, NULL);
 
@@ -302,13 +400,14 @@ bool parse_collection(int             fh,
    }
 
    if ( !collection_terminated )
-      report_parse_error(pe, fh, "unterminated collection");
+      report_parse_error(pe, jr, "unterminated collection");
 
   early_exit:
 
    if (new_node)
-      jd_Node_destroy(&new_node);
+      jd_Node_destroy(&new_node, jr->allocator);
 
+   --jr->depth;
    return retval;
 }
 
@@ -319,7 +418,7 @@ bool parse_collection(int             fh,
  *    Reads directly from a stream to create a Document Object
  *    Model (DOM) of a JSON document.
  *
- * @param fh          Handle to an open JSON file
+ * @param jr          Reader of a JSON document
  * @param parent      jd_Node under which new jd_Nodes will be inserted
  * @param node        pointer to address of the newly-created jd_Node
  * @param first_char  character that introduces the current string
@@ -328,7 +427,7 @@ bool parse_collection(int             fh,
  *                    consideration.
  * @return True if successful, false if failed
  */
-bool JParser(int fh,
+bool JParser(JReader       *jr,
              jd_Node       *parent,
              jd_Node       **node,
              char          first_char,
@@ -338,13 +437,12 @@ bool JParser(int fh,
    bool retval = true;
 
    // Advance past any whitespace:
-   ssize_t chars_read;
    char chr = first_char ? first_char : ' ';
    while (isspace(chr))
    {
-      if ((chars_read = read(fh, &chr, 1)) == 0 )
+      if (!JReaderGetChar(jr, &chr))
       {
-         report_parse_error(pe, fh, "unexpected end-of-file");
+         report_parse_error(pe, jr, "unexpected end-of-file");
          return false;
       }
    }
@@ -356,7 +454,7 @@ bool JParser(int fh,
    switch(chr)
    {
       case '[':
-         if (! parse_collection(fh, parent, &arrayTools, &new_node, pe))
+         if (! parse_collection(jr, parent, &arrayTools, &new_node, pe))
          {
             retval = false;
             goto early_exit;
@@ -365,7 +463,7 @@ bool JParser(int fh,
          break;
 
       case '{':
-         if (! parse_collection(fh, parent, &objectTools, &new_node, pe))
+         if (! parse_collection(jr, parent, &objectTools, &new_node, pe))
          {
             retval = false;
             goto early_exit;
@@ -377,46 +475,44 @@ bool JParser(int fh,
          // Allocating resources from here, no more
          // 'early_exit' to avoid memory leaks:
          ReadStringInit(&rsh, chr);
-         if (JReadString(fh, &rsh, pe))
+         if (JReadString(jr, &rsh, pe))
          {
             if (end_signal)
                *end_signal = rsh.end_signal;
 
             jd_Node *temp_node;
             // Defer adoption by parent until successfully parsing child:
-            if (jd_Node_create(&temp_node, NULL, NULL))
+            if (jd_Node_create(&temp_node, NULL, NULL, jr->allocator))
             {
                if (chr == '"')
-                  jd_Node_take_string(temp_node, StealReadString(&rsh));
+                  take_read_string(temp_node, &rsh);
                else
                {
-                  if ( 0 == strcmp(rsh.string, "null"))
-                     jd_Node_set_null(temp_node);
-                  else if ( 0 == strcmp(rsh.string, "true"))
-                     jd_Node_set_true(temp_node);
-                  else if ( 0 == strcmp(rsh.string, "false"))
-                     jd_Node_set_false(temp_node);
+                  // Keywords need no payload, so set the type directly:
+                  jd_Type keyword;
+                  if (keyword_type(rsh.string, rsh.length, &keyword))
+                     temp_node->type = keyword;
                   // If first character is a number or sign,
                   // test for number and explicitly warn as such
                   else if ( strchr("0123456789.-+", rsh.string[0]) )
                   {
                      bool isFloat;
-                     if (isJsonNumber(rsh.string, &isFloat))
+                     if (!isJsonNumber(rsh.string, rsh.length, &isFloat))
                      {
-                        if (isFloat)
-                           jd_Node_set_float(temp_node, rsh.string);
-                        else
-                           jd_Node_set_integer(temp_node, rsh.string);
+                        report_parse_error(pe, jr, "invalid number");
+                        retval = false;
                      }
+                     else if (take_read_number(jr, temp_node, &rsh))
+                        temp_node->type = isFloat ? JD_FLOAT : JD_INTEGER;
                      else
                      {
-                        report_parse_error(pe, fh, "invalid number");
+                        report_parse_error(pe, jr, "out of memory");
                         retval = false;
                      }
                   }
                   else
                   {
-                     report_parse_error(pe, fh,
+                     report_parse_error(pe, jr,
                                         "unquoted values must be keywords or numbers");
                      retval = false;
                   }
@@ -430,8 +526,11 @@ bool JParser(int fh,
                   new_node = temp_node;
                }
                else
-                  jd_Node_destroy(&temp_node);
+                  jd_Node_destroy(&temp_node, jr->allocator);
             } // if jd_Node_create
+
+            // Free keyword and number strings that were not stolen:
+            ReadStringDestroy(&rsh);
          }
          else // if JReadString failed:
          {
@@ -456,15 +555,14 @@ bool JParser(int fh,
  * confirms that no additional content follows the current
  * file pointer.  js_parse_file calls this to confirm.
  *
- * @param fh   handle of JSON file
+ * @param jr   reader of JSON document
  * @return true if only whitespace remains;
  *         false returned at first non-whitespace character
  */
-bool confirm_no_further_file_content(int fh)
+bool confirm_no_further_file_content(JReader *jr)
 {
-   ssize_t chars_read;
    char chr = ' ';
-   while ((chars_read = read(fh, &chr, 1))==1)
+   while (JReaderGetChar(jr, &chr))
    {
       if (!isspace(chr))
          return false;
@@ -479,6 +577,10 @@ bool confirm_no_further_file_content(int fh)
 
 #include "CharBag.c"
 #include "jd_Node.c"
+#include "JReader.c"
+#include "JEscape.c"
+#include "JUtf8.c"
+#include "JPool.c"
 #include "JReadString.c"
 
 int main(int argc, const char **argv)
@@ -493,10 +595,16 @@ int main(int argc, const char **argv)
       jd_ParseError pe = {0};
       char end_char;
       jd_Node *root;
-      if (JParser(fh, NULL, &root, 0, &end_char, &pe))
+      JReader jr;
+      if (JReaderInitFile(&jr, fh, 0, NULL))
       {
-         jd_Node_serialize(root, 0);
-         jd_Node_destroy(&root);
+         if (JParser(&jr, NULL, &root, 0, &end_char, &pe))
+         {
+            jd_Node_serialize(root, 0);
+            jd_Node_destroy(&root, NULL);
+         }
+
+         JReaderDestroy(&jr);
       }
 
       close(fh);
@@ -3,29 +3,12 @@
 
 #include "jd_Node.h"
 #include "jsondom.h"
+#include "JReader.h"
 
-void report_parse_error(jd_ParseError *pe, int fh, const char *message);
+void report_parse_error(jd_ParseError *pe, const JReader *jr, const char *message);
 
-/**
- * Function type for overriding standard error reporter
- *
- * @return True to exit, false to continue
- * */
-typedef bool (*Error_Reporter)(
-   int source_fh,       /**<
-                         * @brief handle to JSON document source
-                         * @details
-                         *    Can be used to determine the location
-                         *    of the error in the source file
-                         */
-   const char *format,  ///< printf-style format string
-   ...                  ///< arguments to fill conversion specification
-                        ///< of the format string
-   );
-
-/** Default implementation of Error_Reporter */
-bool Standard_Report_Error(int source_fh, const char *format, ...);
-extern Error_Reporter Report_Error;
+/** Implementation of #jd_Reporter used by the default context */
+void Standard_Report_Error(void *data, const jd_ParseError *pe);
 
 
 /** typedef of CollectionTools_s */
@@ -36,7 +19,7 @@ typedef bool (*Is_End_Char)(char chr);
 /** typedef member of CollectionTools */
 typedef bool (*Coerce_Type)(jd_Node *node);
 /** typedef member of CollectionTools */
-typedef bool (*Read_Member)(int fh,
+typedef bool (*Read_Member)(JReader *jr,
                             jd_Node *parent,
                             jd_Node **new_node,
                             char first_char,
@@ -88,7 +71,7 @@ struct CollectionTools_s {
 /**
  * @ingroup AllFunctions
  */
-bool JParser(int           fh,
+bool JParser(JReader       *jr,
              jd_Node         *parent,
              jd_Node         **node,
              char          first_char,
@@ -96,7 +79,7 @@ bool JParser(int           fh,
              jd_ParseError *parse_error
    );
 
-bool confirm_no_further_file_content(int fh);
+bool confirm_no_further_file_content(JReader *jr);
 
 
 #endif
@@ -0,0 +1,305 @@
+/** @file JPool.c */
+
+#include "JPool.h"
+#include "JAlloc.h"
+#include <stdlib.h>    // malloc/free
+#include <string.h>    // memset
+#include <pthread.h>   // thread-exit destructor
+
+/** Unused block on a freelist */
+typedef struct PoolBlock_s PoolBlock;
+struct PoolBlock_s {
+   PoolBlock *next;     ///< next unused block of the same size
+};
+
+/**
+ * @brief Header before each payload block, recording its size class.
+ * @details
+ *    Payloads too large for any class use #JP_CLASS_COUNT and go
+ *    straight back to @c free.  Payloads from a #jd_Allocator use
+ *    #JP_ALLOCATOR_CLASS and have a second header in front holding
+ *    the allocator, so they can be freed without being told where
+ *    they came from.  The header is as large as a pointer so the
+ *    payload stays suitably aligned.
+ */
+typedef union PoolHeader_u {
+   size_t             size_class;   ///< index of the block's size class
+   const jd_Allocator *allocator;   ///< source of a #JP_ALLOCATOR_CLASS block
+   void               *align;       ///< forces pointer alignment of the payload
+} PoolHeader;
+
+/** Size class of payloads taken from a #jd_Allocator */
+#define JP_ALLOCATOR_CLASS (JP_CLASS_COUNT + 1)
+
+/** Block sizes, header included, of the payload size classes */
+static const size_t class_sizes[JP_CLASS_COUNT] = { 32, 64, 128, 256 };
+
+/**
+ * @brief Memory kept for reuse by a single thread.
+ */
+typedef struct PoolCache_s {
+   PoolBlock    *nodes;                         ///< unused nodes
+   PoolBlock    *payloads[JP_CLASS_COUNT];      ///< unused payload blocks by class
+   size_t       payload_counts[JP_CLASS_COUNT]; ///< blocks on each payload list
+   jd_PoolStats stats;                          ///< activity of this cache
+   bool         registered;                     ///< thread-exit destructor is set
+} PoolCache;
+
+/** Cache of the calling thread */
+static __thread PoolCache pool_cache;
+
+/** Key whose destructor empties a thread's cache when the thread exits */
+static pthread_key_t pool_key;
+/** Guard for creating #pool_key once */
+static pthread_once_t pool_key_once = PTHREAD_ONCE_INIT;
+
+/** Release every block held by @b cache */
+void pool_cache_empty(PoolCache *cache)
+{
+   while (cache->nodes)
+   {
+      PoolBlock *block = cache->nodes;
+      cache->nodes = block->next;
+      free(block);
+   }
+
+   for (int i = 0; i < JP_CLASS_COUNT; ++i)
+   {
+      while (cache->payloads[i])
+      {
+         PoolBlock *block = cache->payloads[i];
+         cache->payloads[i] = block->next;
+         free(block);
+      }
+      cache->payload_counts[i] = 0;
+   }
+
+   cache->stats.nodes_cached = 0;
+   cache->stats.payloads_cached = 0;
+   cache->stats.bytes_cached = 0;
+}
+
+/** Implementation of the #pool_key destructor */
+void pool_thread_exit(void *cache)
+{
+   pool_cache_empty((PoolCache*)cache);
+}
+
+/** Create #pool_key, called through pthread_once */
+void pool_key_create(void)
+{
+   pthread_key_create(&pool_key, pool_thread_exit);
+}
+
+/**
+ * @brief Get the calling thread's cache, ready to hold blocks.
+ * @details
+ *    The first time a thread keeps a block, the cache is
+ *    registered so its blocks are released when the thread exits.
+ */
+static inline PoolCache *pool_cache_for_keeping(void)
+{
+   PoolCache *cache = &pool_cache;
+   if (!cache->registered)
+   {
+      pthread_once(&pool_key_once, pool_key_create);
+      pthread_setspecific(pool_key, cache);
+      cache->registered = true;
+   }
+
+   return cache;
+}
+
+/**
+ * @brief Get memory for a node, from the thread's cache if possible.
+ * @param allocator  source of the memory, or NULL for the thread's
+ *                   cache and @c malloc
+ * @return Uninitialized node memory, or NULL if out of memory
+ */
+jd_Node *pool_node_alloc(const jd_Allocator *allocator)
+{
+   PoolCache *cache = &pool_cache;
+   PoolBlock *block;
+   if (allocator)
+      block = (PoolBlock*)mem_alloc(allocator, sizeof(jd_Node));
+   else if (cache->nodes)
+   {
+      block = cache->nodes;
+      cache->nodes = block->next;
+      --cache->stats.nodes_cached;
+      cache->stats.bytes_cached -= sizeof(jd_Node);
+      ++cache->stats.node_hits;
+   }
+   else
+   {
+      ++cache->stats.node_misses;
+      block = (PoolBlock*)malloc(sizeof(jd_Node));
+   }
+
+   if (block == NULL)
+      return NULL;
+
+   ++cache->stats.allocations;
+   cache->stats.bytes_allocated += sizeof(jd_Node);
+   return (jd_Node*)block;
+}
+
+/**
+ * @brief Return node memory to the thread's cache, or to @c free
+ *        if the cache is full.
+ * @param node       memory from #pool_node_alloc
+ * @param allocator  the allocator given to #pool_node_alloc
+ */
+void pool_node_free(jd_Node *node, const jd_Allocator *allocator)
+{
+   if (allocator)
+   {
+      mem_free(allocator, node);
+      return;
+   }
+
+   PoolCache *cache = pool_cache_for_keeping();
+   if (cache->stats.nodes_cached < JP_NODE_LIMIT)
+   {
+      PoolBlock *block = (PoolBlock*)node;
+      block->next = cache->nodes;
+      cache->nodes = block;
+      ++cache->stats.nodes_cached;
+      cache->stats.bytes_cached += sizeof(jd_Node);
+   }
+   else
+      free(node);
+}
+
+/**
+ * @brief Get memory for a payload, from the thread's cache if possible.
+ * @details
+ *    Memory from this function must be released with #pool_free.
+ * @param size       number of bytes needed
+ * @param allocator  source of the memory, or NULL for the thread's
+ *                   cache and @c malloc
+ * @return Address of the payload memory, or NULL if out of memory
+ */
+void *pool_alloc(size_t size, const jd_Allocator *allocator)
+{
+   PoolCache *cache = &pool_cache;
+   size_t needed = size + sizeof(PoolHeader);
+
+   if (allocator)
+   {
+      needed += sizeof(PoolHeader);
+      PoolHeader *owner = (PoolHeader*)mem_alloc(allocator, needed);
+      if (owner == NULL)
+         return NULL;
+
+      ++cache->stats.allocations;
+      cache->stats.bytes_allocated += needed;
+
+      owner[0].allocator = allocator;
+      owner[1].size_class = JP_ALLOCATOR_CLASS;
+      return owner + 2;
+   }
+
+   size_t size_class = 0;
+   while (size_class < JP_CLASS_COUNT && class_sizes[size_class] < needed)
+      ++size_class;
+
+   PoolHeader *header;
+   if (size_class < JP_CLASS_COUNT && cache->payloads[size_class])
+   {
+      PoolBlock *block = cache->payloads[size_class];
+      cache->payloads[size_class] = block->next;
+      --cache->payload_counts[size_class];
+      --cache->stats.payloads_cached;
+      cache->stats.bytes_cached -= class_sizes[size_class];
+      ++cache->stats.payload_hits;
+      header = (PoolHeader*)block;
+   }
+   else
+   {
+      if (size_class < JP_CLASS_COUNT)
+      {
+         ++cache->stats.payload_misses;
+         needed = class_sizes[size_class];
+      }
+
+      header = (PoolHeader*)malloc(needed);
+      if (header == NULL)
+         return NULL;
+   }
+
+   ++cache->stats.allocations;
+   cache->stats.bytes_allocated += size_class < JP_CLASS_COUNT ? class_sizes[size_class] : needed;
+
+   header->size_class = size_class;
+   return header + 1;
+}
+
+/**
+ * @brief Release payload memory from #pool_alloc, keeping it
+ *        in the thread's cache if there is room.
+ */
+void pool_free(void *ptr)
+{
+   if (ptr == NULL)
+      return;
+
+   PoolHeader *header = (PoolHeader*)ptr - 1;
+   size_t size_class = header->size_class;
+
+   if (size_class == JP_ALLOCATOR_CLASS)
+   {
+      --header;
+      mem_free(header->allocator, header);
+      return;
+   }
+   else if (size_class < JP_CLASS_COUNT)
+   {
+      PoolCache *cache = pool_cache_for_keeping();
+      if (cache->payload_counts[size_class] < JP_PAYLOAD_LIMIT)
+      {
+         PoolBlock *block = (PoolBlock*)header;
+         block->next = cache->payloads[size_class];
+         cache->payloads[size_class] = block;
+         ++cache->payload_counts[size_class];
+         ++cache->stats.payloads_cached;
+         cache->stats.bytes_cached += class_sizes[size_class];
+         return;
+      }
+   }
+
+   free(header);
+}
+
+/**
+ * @brief Size of the block that holds a payload from #pool_alloc.
+ * @param ptr   payload from #pool_alloc
+ * @param size  number of bytes asked of #pool_alloc
+ * @return Bytes of the block, headers and size-class rounding included
+ */
+size_t pool_block_size(const void *ptr, size_t size)
+{
+   const PoolHeader *header = (const PoolHeader*)ptr - 1;
+   if (header->size_class < JP_CLASS_COUNT)
+      return class_sizes[header->size_class];
+   else if (header->size_class == JP_ALLOCATOR_CLASS)
+      return size + 2 * sizeof(PoolHeader);
+   else
+      return size + sizeof(PoolHeader);
+}
+
+/**
+ * @brief Copy the activity counts of the calling thread's cache.
+ */
+void pool_get_stats(jd_PoolStats *stats)
+{
+   *stats = pool_cache.stats;
+}
+
+/**
+ * @brief Release all memory held by the calling thread's cache.
+ */
+void pool_trim(void)
+{
+   pool_cache_empty(&pool_cache);
+}
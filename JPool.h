@@ -0,0 +1,43 @@
+/**
+ * @file JPool.h
+ * @brief Per-thread caches of node and payload memory.
+ *
+ * Nodes and small payloads released by a thread are kept in
+ * that thread's cache and handed out again by its next
+ * allocations, so workloads that build and discard many small
+ * documents rarely reach the global allocator.
+ *
+ * Memory for a document with a #jd_Allocator comes straight from
+ * the allocator and goes straight back to it, bypassing the caches.
+ */
+
+#ifndef JPOOL_H
+#define JPOOL_H
+
+#include <stddef.h>
+#include "jsondom.h"
+
+/** Most nodes a thread will keep for reuse */
+#define JP_NODE_LIMIT 4096
+
+/** Most payload blocks of each size class a thread will keep for reuse */
+#define JP_PAYLOAD_LIMIT 1024
+
+/** Number of payload size classes, sized 32, 64, 128 and 256 bytes */
+#define JP_CLASS_COUNT 4
+
+/**
+ * @ingroup AllFunctions
+ * @defgroup PoolFuncs Functions that recycle node and payload memory
+ * @{
+ */
+jd_Node *pool_node_alloc(const jd_Allocator *allocator);
+void pool_node_free(jd_Node *node, const jd_Allocator *allocator);
+void *pool_alloc(size_t size, const jd_Allocator *allocator);
+void pool_free(void *ptr);
+size_t pool_block_size(const void *ptr, size_t size);
+void pool_get_stats(jd_PoolStats *stats);
+void pool_trim(void);
+/** @} */
+
+#endif
@@ -3,9 +3,11 @@
 #include "JReadString.h"
 #include "CharBag.h"
 #include "JParser.h"   // to access Report_Error function
+#include "JEscape.h"
+#include "JUtf8.h"
+#include "JPool.h"
 #include <stdlib.h>    // malloc/free
-#include <unistd.h>    // read
-#include <string.h>    // strchr
+#include <string.h>    // strchr, memcpy
 #include <ctype.h>    // isspace
 #include <assert.h>
 
@@ -58,7 +60,8 @@ void ReadStringDestroy(RSHandle *handle)
    assert(handle);
    if (handle->string)
    {
-      free((void*)(handle->string));
+      if (!handle->borrowed)
+         pool_free((void*)(handle->string));
       handle->string = NULL;
    }
 }
@@ -80,6 +83,340 @@ const char *StealReadString(RSHandle *handle)
    return retval;
 }
 
+/**
+ * @brief
+ *    Collect a quoted string by leaving it in a memory source.
+ * @details
+ *    Succeeds only if the string can be used exactly as it
+ *    appears in the source, that is, if it has no escape
+ *    sequences or if the parse options call for keeping
+ *    escape sequences raw.  The string will not be
+ *    NUL-terminated.
+ *
+ *    On failure, the reader is left unchanged so the string
+ *    can be read again by #JReadQuotedString, which will
+ *    report any errors, including invalid UTF-8 if the parse
+ *    options call for validation.
+ *
+ * @param jr      reader of a memory source
+ * @param handle  pointer to an empty initialized RSHandle
+ * @return True if the string was collected, false if not
+ */
+bool JReadStringInPlace(JReader *jr, RSHandle *handle)
+{
+   bool keep_raw = (jr->options & JD_PARSE_RAW_ESCAPES) != 0;
+   bool validate = (jr->options & JD_PARSE_VALIDATE_UTF8) != 0;
+   bool escaped = false;
+   bool controls = false;
+
+   const char *start = jr->ptr;
+   const char *ptr = start;
+
+   while ((ptr = json_scan_plain(ptr, jr->end)) < jr->end)
+   {
+      if (*ptr == '"')
+      {
+         bool incomplete;
+         if (validate && utf8_validate(start, ptr - start, &incomplete) < (size_t)(ptr - start))
+            return false;
+
+         handle->string = start;
+         handle->length = ptr - start;
+         handle->borrowed = true;
+         handle->raw = escaped;
+         handle->clean = !escaped && !controls;
+         handle->end_signal = '"';
+         jr->ptr = ptr + 1;
+         return true;
+      }
+      else if (*ptr == '\\')
+      {
+         if (!keep_raw)
+            return false;
+
+         escaped = true;
+         ptr += 2;
+      }
+      else
+      {
+         controls = true;
+         ++ptr;   // control characters are tolerated
+      }
+   }
+
+   return false;
+}
+
+/**
+ * @brief
+ *    Collect an unquoted string by leaving it in the window.
+ * @details
+ *    Succeeds if the whole string, from its first character
+ *    just read, lies in the window without escape sequences.
+ *    The string will not be NUL-terminated, and for a file
+ *    source remains valid only until the next read.
+ *
+ *    On failure, the reader is left unchanged so the string
+ *    can be collected by #JReadString.
+ *
+ * @param jr      reader positioned after the first character
+ * @param handle  pointer to an empty initialized RSHandle
+ * @return True if the string was collected, false if not
+ */
+bool JReadTokenInPlace(JReader *jr, RSHandle *handle)
+{
+   if (jr->ptr == jr->window || jr->ptr[-1] != handle->first_char)
+      return false;
+
+   const char *start = jr->ptr - 1;
+   const char *ptr = jr->ptr;
+
+   while (ptr < jr->end && !end_check_for_unquoted(*ptr))
+   {
+      if (*ptr == '\\')
+         return false;
+      ++ptr;
+   }
+
+   // More of a file may follow the window:
+   if (ptr == jr->end && jr->fh >= 0)
+      return false;
+
+   handle->string = start;
+   handle->length = ptr - start;
+   handle->borrowed = true;
+   if (ptr < jr->end)
+   {
+      handle->end_signal = *ptr;
+      jr->ptr = ptr + 1;
+   }
+   else
+      jr->ptr = ptr;
+
+   return true;
+}
+
+/**
+ * @brief Read four hexadecimal digits of a \\u escape sequence.
+ * @param jr     reader positioned after the 'u'
+ * @param value  address to which the value will be written
+ * @return True for success, false if not four hex digits
+ */
+bool read_hex4(JReader *jr, unsigned long *value)
+{
+   unsigned long result = 0;
+   char chr;
+
+   for (int i = 0; i < 4; ++i)
+   {
+      if (!JReaderGetChar(jr, &chr))
+         return false;
+
+      result <<= 4;
+      if (chr >= '0' && chr <= '9')
+         result |= chr - '0';
+      else if (chr >= 'a' && chr <= 'f')
+         result |= chr - 'a' + 10;
+      else if (chr >= 'A' && chr <= 'F')
+         result |= chr - 'A' + 10;
+      else
+         return false;
+   }
+
+   *value = result;
+   return true;
+}
+
+/**
+ * @brief Decode an escape sequence into the characters it represents.
+ * @details
+ *    Unicode escapes are converted to UTF-8, combining a
+ *    surrogate pair into a single code point.  Unpaired
+ *    surrogates are rejected.
+ *
+ * @param jr     reader positioned after the backslash
+ * @param cbag   CharBag to which the decoded characters are added
+ * @param pe     pointer to parsing error structure
+ * @return True for success, false for failure
+ */
+bool JReadEscape(JReader *jr, CharBag *cbag, jd_ParseError *pe)
+{
+   char chr;
+   if (!JReaderGetChar(jr, &chr))
+   {
+      report_parse_error(pe, jr, "unexpected EOF");
+      return false;
+   }
+
+   switch(chr)
+   {
+      case '"':
+      case '\\':
+      case '/':
+         break;
+      case 'b': chr = '\b'; break;
+      case 'f': chr = '\f'; break;
+      case 'n': chr = '\n'; break;
+      case 'r': chr = '\r'; break;
+      case 't': chr = '\t'; break;
+
+      case 'u':
+      {
+         unsigned long codepoint, low;
+         if (!read_hex4(jr, &codepoint))
+            goto invalid_unicode;
+
+         if (codepoint >= 0xDC00 && codepoint <= 0xDFFF)
+            goto invalid_unicode;
+         else if (codepoint >= 0xD800 && codepoint <= 0xDBFF)
+         {
+            // A high surrogate must be followed by an escaped low surrogate:
+            if (!JReaderGetChar(jr, &chr) || chr != '\\'
+                || !JReaderGetChar(jr, &chr) || chr != 'u'
+                || !read_hex4(jr, &low)
+                || low < 0xDC00 || low > 0xDFFF)
+               goto invalid_unicode;
+
+            codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+         }
+
+         char utf8[4];
+         char *utf8_end = json_utf8_encode(utf8, codepoint);
+         return add_chars_to_bag(cbag, utf8, utf8_end - utf8);
+      }
+
+      default:
+         report_parse_error(pe, jr, "invalid escape sequence");
+         return false;
+   }
+
+   return add_char_to_bag(cbag, chr);
+
+  invalid_unicode:
+   report_parse_error(pe, jr, "invalid unicode escape sequence");
+   return false;
+}
+
+/**
+ * @brief
+ *    Read the rest of a quoted string into a memory block,
+ *    decoding escape sequences.
+ * @details
+ *    Runs of characters that need no decoding are found with
+ *    #json_scan_plain and copied as a block, after being checked
+ *    with #utf8_validate if the parse options call for it.  A
+ *    string found whole in the window is copied once to its own
+ *    block, others are collected in the reader's scratch bag.
+ *    Escape sequences are kept as they are found if the parse
+ *    options call for raw escapes.
+ *
+ * @param jr      reader positioned after the opening quote
+ * @param handle  pointer to an empty initialized RSHandle
+ * @param pe      pointer to parsing error structure
+ * @return True for success, false for failure
+ */
+bool JReadQuotedString(JReader *jr, RSHandle *handle, jd_ParseError *pe)
+{
+   bool retval = false;
+   bool keep_raw = (jr->options & JD_PARSE_RAW_ESCAPES) != 0;
+   bool validate = (jr->options & JD_PARSE_VALIDATE_UTF8) != 0;
+   bool clean = true;
+
+   CharBag *cbag = &jr->scratch;
+   char_bag_reset(cbag);
+
+   while (jr->ptr < jr->end || JReaderFill(jr))
+   {
+      const char *plain_end = json_scan_plain(jr->ptr, jr->end);
+      if (plain_end > jr->ptr)
+      {
+         size_t run = plain_end - jr->ptr;
+         bool incomplete = false;
+         if (validate)
+            run = utf8_validate(jr->ptr, run, &incomplete);
+
+         // A whole string in the window is copied once, bypassing the bag:
+         if (cbag->length == 0 && run == (size_t)(plain_end - jr->ptr)
+             && plain_end < jr->end && *plain_end == '"')
+         {
+            char *value = (char*)pool_alloc(run + 1, jr->allocator);
+            if (!value)
+               goto out_of_memory;
+
+            memcpy(value, jr->ptr, run);
+            value[run] = '\0';
+            jr->ptr = plain_end + 1;
+
+            handle->string = value;
+            handle->length = run;
+            handle->end_signal = '"';
+            handle->clean = clean;
+            return true;
+         }
+
+         if (run && !add_chars_to_bag(cbag, jr->ptr, run))
+            goto out_of_memory;
+
+         jr->ptr += run;
+         if (jr->ptr < plain_end)
+         {
+            // The next read may complete a sequence cut off by the window:
+            if (incomplete && plain_end == jr->end && JReaderFill(jr))
+               continue;
+
+            report_parse_error(pe, jr, "invalid UTF-8");
+            goto cleanup;
+         }
+
+         continue;
+      }
+
+      char chr = *jr->ptr++;
+      if (chr == '"')
+      {
+         char *value;
+         if (!char_bag_to_string(cbag, &value, &handle->length))
+            goto out_of_memory;
+
+         handle->end_signal = chr;
+         handle->string = value;
+         handle->clean = clean;
+         retval = true;
+         goto cleanup;
+      }
+
+      clean = false;
+
+      if (chr == '\\' && keep_raw)
+      {
+         handle->raw = true;
+         if (!add_char_to_bag(cbag, chr))
+            goto out_of_memory;
+         if (!JReaderGetChar(jr, &chr))
+            break;
+         if (!add_char_to_bag(cbag, chr))
+            goto out_of_memory;
+      }
+      else if (chr == '\\')
+      {
+         if (!JReadEscape(jr, cbag, pe))
+            goto cleanup;
+      }
+      else if (!add_char_to_bag(cbag, chr))   // tolerated control character
+         goto out_of_memory;
+   }
+
+   // Not finding the close quote implies an incomplete document.
+   report_parse_error(pe, jr, "unexpected EOF");
+   goto cleanup;
+
+  out_of_memory:
+   report_parse_error(pe, jr, "out of memory");
+
+  cleanup:
+   return retval;
+}
+
 /**
  * @brief
  *    Read the rest of the current string into a memory block.
@@ -96,31 +433,46 @@ const char *StealReadString(RSHandle *handle)
  *    orderly progress on a single reading pass through the
  *    JSON contents.
  *
- * @param fh      handle to an open JSON document file
+ *    Quoted strings in a memory source will be left in place
+ *    if the reader allows zero-copy parsing.
+ *    Unquoted strings are left in the window when possible,
+ *    see #JReadTokenInPlace.
+ *
+ * @param jr      reader from which the string will be read
  * @param handle  pointer to an empty initialized RSHandle
  * @param pe      pointer to parsing error structure
  * @return True for success, false for failure
  */
-bool JReadString(int fh, RSHandle *handle, jd_ParseError *pe)
+bool JReadString(JReader *jr, RSHandle *handle, jd_ParseError *pe)
 {
    bool retval = false;
 
-   CharBag cbag;
-   initialize_CharBag(&cbag);
+   if (handle->first_char == '"')
+   {
+      if (JReaderZeroCopy(jr) && JReadStringInPlace(jr, handle))
+         return true;
+      else
+         return JReadQuotedString(jr, handle, pe);
+   }
 
-   // Prepend the first char if it's not the string-introducing quote character:
-   if (handle->first_char != '"')
-      add_char_to_bag(&cbag, handle->first_char);
+   // Keywords and numbers are almost always whole in the window:
+   if (JReadTokenInPlace(jr, handle))
+      return true;
+
+   CharBag *cbag = &jr->scratch;
+   char_bag_reset(cbag);
+
+   // Unquoted strings (keywords and numbers) begin with the first char:
+   add_char_to_bag(cbag, handle->first_char);
 
    bool escape_state = false;
    char chr;
-   size_t bytes_read;
-   while ((bytes_read = read(fh, &chr, 1)) == 1)
+   while (JReaderGetChar(jr, &chr))
    {
       if (escape_state)
       {
-         add_char_to_bag(&cbag, '\\');
-         add_char_to_bag(&cbag, chr);
+         add_char_to_bag(cbag, '\\');
+         add_char_to_bag(cbag, chr);
          escape_state = false;
       }
       else if (chr == '\\')
@@ -130,7 +482,7 @@ bool JReadString(int fh, RSHandle *handle, jd_ParseError *pe)
       else if ((*handle->end_check)(chr))
       {
          char *value;
-         if (char_bag_to_string(&cbag, &value))
+         if (char_bag_to_string(cbag, &value, &handle->length))
          {
             handle->end_signal = chr;
             handle->string = value;
@@ -139,36 +491,18 @@ bool JReadString(int fh, RSHandle *handle, jd_ParseError *pe)
          }
       }
       else
-         add_char_to_bag(&cbag, chr);
+         add_char_to_bag(cbag, chr);
    }
 
-   if (handle->first_char == '"')
-   {
-      // The loop above SHOULD have found a closing double-quote
-      // and moved to cleanup label. Not finding the close quote
-      // implies an incomplete document.  Leave retval==false
-      // to terminate parsing.
-
-      report_parse_error(pe, fh, "unexpected EOF");
-      // (*Report_Error)(fh, "Unexpected end-of-file while reading a string");
-   }
-   else
+   // An unquoted string can end with the document:
+   char *value;
+   if (char_bag_to_string(cbag, &value, &handle->length))
    {
-      // I don't know why we might get here, so I'm gonna do
-      // some testing in anticipation of removing this dead
-      // code.
-      char *value;
-      if (char_bag_to_string(&cbag, &value))
-      {
-         // handle->end_signal = -1;
-         handle->string = value;
-         retval = true;
-      }
+      handle->string = value;
+      retval = true;
    }
 
   cleanup:
-   char_bag_cleanup(&cbag);
-
    return retval;
 }
 
@@ -176,7 +510,12 @@ bool JReadString(int fh, RSHandle *handle, jd_ParseError *pe)
 #ifdef JREADSTRING_MAIN
 
 #include "CharBag.c"
+#include "JReader.c"
+#include "JEscape.c"
+#include "JUtf8.c"
+#include "JPool.c"
 #include <stdio.h>    // printf, remove
+#include <unistd.h>   // write, lseek
 #include <fcntl.h>    // open/close
 #include <errno.h>    // errno
 #include <string.h>   // strerror()
@@ -212,18 +551,19 @@ bool test_string(const char *str)
 
    // Fake file established, simulate JParser processing:
    char chr;
-   size_t bytes_read;
    jd_ParseError pe = {0};
+   JReader jr;
+   JReaderInitFile(&jr, fh, 0, NULL);
 
-   while ((bytes_read = read(fh, &chr, 1)) == 1)
+   while (JReaderGetChar(&jr, &chr))
    {
       if (isspace(chr))
          continue;
 
       ReadStringInit(&handle, chr);
-      if (JReadString(fh, &handle, &pe))
+      if (JReadString(&jr, &handle, &pe))
       {
-         printf("The output is '%s'.\n", handle.string);
+         printf("The output is '%.*s'.\n", (int)handle.length, handle.string);
       }
       else
       {
@@ -233,6 +573,8 @@ bool test_string(const char *str)
       break;
    }
 
+   JReaderDestroy(&jr);
+
   early_exit:
    ReadStringDestroy(&handle);
    if (fh>0)
@@ -5,6 +5,7 @@
 
 #include <stdbool.h>
 #include "jsondom.h"
+#include "JReader.h"
 
 /** Typedef of RSHandle_s struct */
 typedef struct RSHandle_s RSHandle;
@@ -17,6 +18,19 @@ typedef bool(*RSEndCheck)(char chr);
  */
 struct RSHandle_s {
    const char *string;     ///< Address at which the complete string will be found
+   size_t     length;      ///< Number of characters in #string
+   bool       borrowed;    /**< @brief #string points into the source text
+                            *
+                            *  @details
+                            *     When set, #string is not NUL-terminated and
+                            *     does not belong to the handle, so #length
+                            *     must be used and #string must not be freed.
+                            */
+   bool       raw;         ///< #string includes undecoded escape sequences
+   bool       clean;       /**< @brief #string had no escape sequences or
+                            *   control characters, so it can be written
+                            *   as JSON without escaping
+                            */
    char       first_char;  /**< @brief Character that begins the string
                             *
                             *  @details
@@ -50,7 +64,7 @@ struct RSHandle_s {
 void ReadStringInit(RSHandle *rSHandle, char firstChar);
 void ReadStringDestroy(RSHandle *rSHandle);
 const char *StealReadString(RSHandle *handle);
-bool JReadString(int fh, RSHandle *handle, jd_ParseError *pe);
+bool JReadString(JReader *jr, RSHandle *handle, jd_ParseError *pe);
 /** @} */
 
 
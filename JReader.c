@@ -0,0 +1,241 @@
+/** @file JReader.c */
+
+#include "JReader.h"
+#include "jsondom.h"   // for jd_ParseOption
+#include "JStats.h"    // for stats_clock
+#include "JAlloc.h"
+#include <string.h>    // memset, memmove, memchr
+#include <stddef.h>    // ptrdiff_t
+#include <unistd.h>    // read
+#include <errno.h>     // EINTR
+#include <assert.h>
+
+/**
+ * @brief Prepare a JReader to read from an open file handle.
+ * @param jr         uninitialized JReader memory
+ * @param fh         handle to an open JSON document
+ * @param options    #jd_ParseOption flags for the parse
+ * @param allocator  source of the memory of the read buffer and
+ *                   of the tree, or NULL for @c malloc
+ * @return True for success, false if the read buffer could not be allocated
+ */
+bool JReaderInitFile(JReader            *jr,
+                     int                fh,
+                     unsigned int       options,
+                     const jd_Allocator *allocator)
+{
+   assert(jr);
+
+   memset(jr, 0, sizeof(JReader));
+   jr->fh = fh;
+   jr->options = options;
+   jr->allocator = allocator;
+   initialize_CharBag(&jr->scratch, allocator);
+
+   // Zero-copy and spans are meaningless when the source is discarded as it is read
+   jr->options &= ~(JD_PARSE_ZERO_COPY | JD_PARSE_KEEP_SPANS);
+
+   jr->buffer = (char*)mem_alloc(allocator, JR_BUFFER_SIZE);
+   if (jr->buffer == NULL)
+      return false;
+
+   jr->window = jr->ptr = jr->end = jr->buffer;
+   return true;
+}
+
+/**
+ * @brief Prepare a JReader to read from a block of memory.
+ * @param jr         uninitialized JReader memory
+ * @param source     address of the JSON document text
+ * @param len        number of characters in @b source
+ * @param options    #jd_ParseOption flags for the parse
+ * @param allocator  source of the memory of the tree, or NULL for
+ *                   the default
+ */
+void JReaderInitMemory(JReader            *jr,
+                       const char         *source,
+                       size_t             len,
+                       unsigned int       options,
+                       const jd_Allocator *allocator)
+{
+   assert(jr);
+
+   memset(jr, 0, sizeof(JReader));
+   jr->fh = -1;
+   jr->options = options;
+   jr->allocator = allocator;
+   initialize_CharBag(&jr->scratch, allocator);
+   jr->window = jr->ptr = source;
+   jr->end = source + len;
+}
+
+/**
+ * @brief Release memory held by the JReader.  Does not close the file.
+ */
+void JReaderDestroy(JReader *jr)
+{
+   assert(jr);
+   if (jr->buffer)
+   {
+      mem_free(jr->allocator, jr->buffer);
+      jr->buffer = NULL;
+   }
+
+   char_bag_cleanup(&jr->scratch);
+
+   jr->window = jr->ptr = jr->end = NULL;
+}
+
+/**
+ * @brief Count the newlines of a run of the window.
+ * @param jr     reader whose window holds the run
+ * @param start  first character of the run
+ * @param end    address following the run
+ * @param lines  incremented by the number of newlines
+ * @param line_offset  set to the source offset following the last
+ *                     newline, if there is one
+ */
+static void count_lines(const JReader *jr,
+                        const char    *start,
+                        const char    *end,
+                        size_t        *lines,
+                        size_t        *line_offset)
+{
+   const char *newline;
+   while (start < end && (newline = (const char*)memchr(start, '\n', end - start)))
+   {
+      ++*lines;
+      start = newline + 1;
+      *line_offset = jr->window_offset + (start - jr->window);
+   }
+}
+
+/**
+ * @brief Make more characters available in the window.
+ * @details
+ *    Unread characters are kept at the front of the window
+ *    so callers can look ahead across a buffer boundary.
+ *    Memory sources are presented whole, so there is never
+ *    anything more to read.
+ * @param jr   reader to fill
+ * @return True if new characters were added to the window
+ */
+bool JReaderFill(JReader *jr)
+{
+   if (jr->buffer == NULL)
+      return false;
+
+   // Lines are counted as text leaves the window, so errors can be placed without rereading:
+   count_lines(jr, jr->window, jr->ptr, &jr->lines, &jr->line_offset);
+
+   size_t unread = jr->end - jr->ptr;
+   jr->window_offset += jr->ptr - jr->window;
+
+   if (unread && jr->ptr != jr->buffer)
+      memmove(jr->buffer, jr->ptr, unread);
+
+   jr->window = jr->ptr = jr->buffer;
+   jr->end = jr->buffer + unread;
+
+   if (unread >= JR_BUFFER_SIZE)
+      return false;
+
+   uint64_t began = jr->stats ? stats_clock() : 0;
+
+   ssize_t bytes_read;
+   do
+      bytes_read = read(jr->fh, jr->buffer + unread, JR_BUFFER_SIZE - unread);
+   while (bytes_read < 0 && errno == EINTR);
+
+   if (jr->stats)
+   {
+      ++jr->stats->reads;
+      jr->stats->read_ns += stats_clock() - began;
+   }
+
+   if (bytes_read <= 0)
+      return false;
+
+   jr->end += bytes_read;
+   return true;
+}
+
+/**
+ * @brief Source offset of the next unread character.
+ */
+size_t JReaderOffset(const JReader *jr)
+{
+   return jr->window_offset + (jr->ptr - jr->window);
+}
+
+/**
+ * @brief Find the line and column of a source offset.
+ * @details
+ *    Newlines before the window were counted as the window moved,
+ *    so only the window is searched.
+ * @param jr      reader of the source
+ * @param offset  source offset at or after the start of the window
+ * @param line    set to the line of @b offset, counting from 1
+ * @param column  set to the byte column of @b offset, counting from 1
+ */
+void JReaderPosition(const JReader *jr, size_t offset, size_t *line, size_t *column)
+{
+   size_t lines = jr->lines;
+   size_t line_offset = jr->line_offset;
+
+   const char *target = jr->window + (offset - jr->window_offset);
+   if (target > jr->end)
+      target = jr->end;
+
+   count_lines(jr, jr->window, target, &lines, &line_offset);
+
+   *line = lines + 1;
+   *column = offset - line_offset + 1;
+}
+
+/**
+ * @brief Copy the text of the window around a source offset.
+ * @details
+ *    Takes up to two thirds of the excerpt from before @b offset,
+ *    stopping at the ends of its line and of the window.  Control
+ *    characters are copied as spaces.
+ * @param jr       reader of the source
+ * @param offset   source offset at or after the start of the window
+ * @param excerpt  memory to which the text will be copied
+ * @param size     bytes of @b excerpt, its terminating NUL included
+ */
+void JReaderExcerpt(const JReader *jr, size_t offset, char *excerpt, size_t size)
+{
+   const char *point = jr->window + (offset - jr->window_offset);
+   if (point > jr->end)
+      point = jr->end;
+
+   const char *start = point;
+   while (start > jr->window && point - start < (ptrdiff_t)(size - 1) * 2 / 3 && start[-1] != '\n')
+      --start;
+
+   const char *end = point;
+   while (end < jr->end && end - start < (ptrdiff_t)(size - 1) && *end != '\n')
+      ++end;
+
+   char *out = excerpt;
+   for (const char *chr = start; chr < end; ++chr)
+      *out++ = (unsigned char)*chr < ' ' ? ' ' : *chr;
+   *out = '\0';
+}
+
+/**
+ * @brief Tells if strings may be left in place in the source.
+ */
+bool JReaderZeroCopy(const JReader *jr)
+{
+   return jr->buffer == NULL && (jr->options & JD_PARSE_ZERO_COPY);
+}
+
+/**
+ * @brief Tells if collections should record their place in the source.
+ */
+bool JReaderKeepSpans(const JReader *jr)
+{
+   return jr->buffer == NULL && (jr->options & JD_PARSE_KEEP_SPANS);
+}
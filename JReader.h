@@ -0,0 +1,88 @@
+/**
+ * @file JReader.h
+ * @brief Buffered character source for the parser.
+ *
+ * A JReader presents either an open file handle or a block of
+ * memory as a window of characters.  File handle sources are
+ * read in large blocks to avoid a system call per character,
+ * while memory sources are presented whole, which allows the
+ * parser to refer directly to the source text.
+ */
+
+#ifndef JREADER_H
+#define JREADER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "CharBag.h"
+
+/** Size of the read buffer used for file handle sources */
+#define JR_BUFFER_SIZE 65536
+
+struct jd_ParseStats_s;
+struct jd_Allocator_s;
+
+/** Typedef of JReader_s struct */
+typedef struct JReader_s JReader;
+
+/**
+ * @brief Working values for reading a JSON document
+ */
+struct JReader_s {
+   const char   *ptr;            ///< next unread character
+   const char   *end;            ///< first address past the readable characters
+   const char   *window;         ///< address of the first character in the window
+   size_t       window_offset;   ///< source offset of the first character in the window
+   size_t       lines;           ///< newlines in the source before the window
+   size_t       line_offset;     ///< source offset of the line that continues into the window
+   int          fh;              ///< file handle, -1 for memory sources
+   char         *buffer;         ///< read buffer for file handle sources
+   unsigned int options;         ///< #jd_ParseOption flags for the current parse
+   unsigned int depth;           ///< arrays and objects now open
+   unsigned int max_depth;       ///< most arrays and objects open at once
+   struct jd_ParseStats_s *stats; ///< counts the reads if not NULL
+   const struct jd_Allocator_s *allocator; ///< memory of the buffer and the tree, NULL for @c malloc
+   CharBag      scratch;         ///< collects strings that cannot be taken from the window
+};
+
+/**
+ * @ingroup AllFunctions
+ * @defgroup ReaderFuncs Functions that manage a JReader
+ * @{
+ */
+bool JReaderInitFile(JReader                     *jr,
+                     int                         fh,
+                     unsigned int                options,
+                     const struct jd_Allocator_s *allocator);
+void JReaderInitMemory(JReader                     *jr,
+                       const char                  *source,
+                       size_t                      len,
+                       unsigned int                options,
+                       const struct jd_Allocator_s *allocator);
+void JReaderDestroy(JReader *jr);
+bool JReaderFill(JReader *jr);
+size_t JReaderOffset(const JReader *jr);
+void JReaderPosition(const JReader *jr, size_t offset, size_t *line, size_t *column);
+void JReaderExcerpt(const JReader *jr, size_t offset, char *excerpt, size_t size);
+bool JReaderZeroCopy(const JReader *jr);
+bool JReaderKeepSpans(const JReader *jr);
+/** @} */
+
+/**
+ * @brief Get the next character from the reader.
+ * @param jr   reader from which the character will be taken
+ * @param chr  address to which the character will be copied
+ * @return True if a character was read, false at the end of the source
+ */
+static inline bool JReaderGetChar(JReader *jr, char *chr)
+{
+   if (jr->ptr < jr->end || JReaderFill(jr))
+   {
+      *chr = *jr->ptr++;
+      return true;
+   }
+
+   return false;
+}
+
+#endif
@@ -0,0 +1,148 @@
+/** @file JSerialize.c */
+
+#include "JSerialize.h"
+#include "jd_Node.h"
+#include <assert.h>
+
+/**
+ * @brief Write a string payload in double-quotes, escaped as required.
+ * @details
+ *    Strings the parser found clean, and raw strings that are
+ *    already escaped, are copied whole.  Others are scanned for
+ *    characters that need escaping.
+ * @param jw     writer to which the string will be added
+ * @param node   JD_STRING jd_Node to be written
+ */
+void serialize_string(JWriter *jw, const jd_Node *node)
+{
+   const char *str = (const char*)jd_Node_payload(node);
+   size_t len = jd_Node_payload_length(node);
+
+   JWriterPutChar(jw, '"');
+   if (node->flags & (JDN_RAW | JDN_CLEAN))
+      JWriterPut(jw, str, len);
+   else
+      JWriterPutEscaped(jw, str, len);
+   JWriterPutChar(jw, '"');
+}
+
+/**
+ * @brief Write a node that has no children, including empty collections.
+ */
+void serialize_scalar(JWriter *jw, const jd_Node *node)
+{
+   switch(node->type)
+   {
+      case JD_NULL:
+         JWriterPut(jw, "null", 4);
+         break;
+      case JD_TRUE:
+         JWriterPut(jw, "true", 4);
+         break;
+      case JD_FALSE:
+         JWriterPut(jw, "false", 5);
+         break;
+      case JD_STRING:
+         serialize_string(jw, node);
+         break;
+      case JD_INTEGER:
+      case JD_FLOAT:
+         JWriterPut(jw, (const char*)jd_Node_payload(node), jd_Node_payload_length(node));
+         break;
+      case JD_ARRAY:
+         JWriterPut(jw, "[]", 2);
+         break;
+      case JD_OBJECT:
+         JWriterPut(jw, "{}", 2);
+         break;
+      default:
+         // Properties always have children:
+         assert(0);
+         break;
+   }
+}
+
+/**
+ * @brief Start a new line for pretty output.
+ */
+static inline void serialize_newline(JWriter *jw, int indent, int depth)
+{
+   if (indent > 0)
+   {
+      JWriterPutChar(jw, '\n');
+      JWriterPutRepeated(jw, ' ', (size_t)indent * depth);
+   }
+}
+
+/**
+ * @brief Write a tree as JSON text.
+ * @details
+ *    The tree is walked without recursion, climbing back up
+ *    through the parent links, so deeply nested documents
+ *    cannot exhaust the stack.
+ *
+ *    With a positive indent, each array element and object
+ *    property starts a new line, indented by that many spaces
+ *    per level of nesting, and the document ends with a newline.
+ *    Otherwise the output is compact, with no whitespace at all.
+ *
+ *    If the options allow it, collections whose source span is
+ *    still valid are copied from the source as they were parsed.
+ *
+ * @param jw       writer to which the JSON text will be added
+ * @param root     node at the top of the tree to be written
+ * @param options  output settings
+ */
+void serialize_tree(JWriter *jw, const jd_Node *root, const jd_SerializeOptions *options)
+{
+   const jd_Node *node = root;
+   int indent = options->indent;
+   int depth = 0;
+
+   while (true)
+   {
+      // Write the opening of node, descending as far as possible:
+      if (options->copy_spans && jd_Node_has_clean_span(node))
+         JWriterPutSpan(jw, (const char*)node->payload, node->length);
+      else if (node->type == JD_PROPERTY)
+      {
+         // The label is the property's own payload:
+         serialize_string(jw, node);
+         JWriterPutChar(jw, ':');
+         if (indent > 0)
+            JWriterPutChar(jw, ' ');
+         node = jd_Node_relation(node, JD_LAST);
+         continue;
+      }
+      else if (node->firstChild)
+      {
+         JWriterPutChar(jw, node->type == JD_ARRAY ? '[' : '{');
+         serialize_newline(jw, indent, ++depth);
+         node = jd_Node_relation(node, JD_FIRST);
+         continue;
+      }
+      else
+         serialize_scalar(jw, node);
+
+      // Close finished collections until one has more members:
+      while (node != root && node->nextSibling == NULL)
+      {
+         node = jd_Node_relation(node, JD_PARENT);
+         if (node->type != JD_PROPERTY)
+         {
+            serialize_newline(jw, indent, --depth);
+            JWriterPutChar(jw, node->type == JD_ARRAY ? ']' : '}');
+         }
+      }
+
+      if (node == root)
+         break;
+
+      JWriterPutChar(jw, ',');
+      serialize_newline(jw, indent, depth);
+      node = jd_Node_relation(node, JD_NEXT);
+   }
+
+   if (indent > 0)
+      JWriterPutChar(jw, '\n');
+}
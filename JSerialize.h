@@ -0,0 +1,21 @@
+/**
+ * @file JSerialize.h
+ * @brief Functions that write a jd_Node tree as JSON text.
+ */
+
+#ifndef JSERIALIZE_H
+#define JSERIALIZE_H
+
+#include "jsondom.h"
+#include "JWriter.h"
+
+/**
+ * @ingroup AllFunctions
+ * @defgroup SerializeFuncs Functions that write jd_Node trees as JSON
+ * @{
+ */
+void serialize_scalar(JWriter *jw, const jd_Node *node);
+void serialize_tree(JWriter *jw, const jd_Node *root, const jd_SerializeOptions *options);
+/** @} */
+
+#endif
@@ -0,0 +1,406 @@
+/** @file JSnapshot.c */
+
+#include "JSnapshot.h"
+#include "JFreeze.h"
+#include <string.h>   // memcmp, memcpy, memset
+
+/** Flags every snapshot node has */
+#define JS_REQUIRED_FLAGS (JDN_FROZEN | JDN_RELATIVE)
+
+/** Flags a snapshot node may have */
+#define JS_ALLOWED_FLAGS (JDN_DOCUMENT | JDN_BORROWED | JDN_SIZED | JDN_RAW \
+                          | JDN_CLEAN | JDN_FROZEN | JDN_INDEXED | JDN_RELATIVE)
+
+/** Distance from @b from to @b to, stored where an address was */
+static inline void *relative(const void *from, const void *to)
+{
+   return to ? (void*)((const char*)to - (const char*)from) : NULL;
+}
+
+/** Copy of a frozen node with its links and payload made relative */
+static void relative_node(const jd_Node *node, jd_Node *out)
+{
+   *out = *node;
+   out->parent = (jd_Node*)relative(node, node->parent);
+   out->nextSibling = (jd_Node*)relative(node, node->nextSibling);
+   out->firstChild = (jd_Node*)relative(node, node->firstChild);
+   out->prevSibling = (jd_Node*)relative(node, node->prevSibling);
+   out->lastChild = (jd_Node*)relative(node, node->lastChild);
+   out->payload = relative(node, node->payload);
+   out->flags |= JDN_RELATIVE;
+}
+
+/**
+ * @brief Write a tree as a snapshot.
+ * @details
+ *    The root of a frozen tree is written from its own block.
+ *    Anything else is frozen into a temporary block first.
+ *
+ * @param jw    destination of the snapshot
+ * @param root  top of the tree to be written
+ * @return True for success, false if out of memory
+ */
+bool snapshot_write(JWriter *jw, const jd_Node *root)
+{
+   jd_Node *frozen = NULL;
+   if ((root->flags & (JDN_FROZEN | JDN_DOCUMENT | JDN_RELATIVE)) != (JDN_FROZEN | JDN_DOCUMENT))
+   {
+      root = frozen = freeze_tree(root, NULL);
+      if (frozen == NULL)
+         return false;
+   }
+
+   freeze_size size;
+   freeze_measure(root, &size);
+
+   size_t nodes_bytes = freeze_nodes_bytes(&size);
+
+   char header_bytes[JS_HEADER_SIZE] = { 0 };
+   JSHeader header;
+   memset(&header, 0, sizeof(header));
+   memcpy(header.magic, JS_MAGIC, sizeof(header.magic));
+   header.version = JS_VERSION;
+   header.byte_order = JS_BYTE_ORDER;
+   header.node_size = sizeof(jd_Node);
+   header.document_size = sizeof(jd_Document);
+   header.node_count = size.nodes;
+   header.index_bytes = size.index_bytes;
+   header.file_size = JS_HEADER_SIZE + nodes_bytes + size.index_bytes + size.string_bytes;
+   memcpy(header_bytes, &header, sizeof(header));
+   JWriterPut(jw, header_bytes, JS_HEADER_SIZE);
+
+   // The document keeps only its root, the rest is set when mapped:
+   const jd_Document *doc = (const jd_Document*)root;
+   jd_Document out_doc;
+   memset(&out_doc, 0, sizeof(out_doc));
+   relative_node(&doc->root, &out_doc.root);
+   JWriterPut(jw, (const char*)&out_doc, sizeof(out_doc));
+
+   const jd_Node *nodes = (const jd_Node*)(doc + 1);
+   for (size_t i = 0; i + 1 < size.nodes; ++i)
+   {
+      jd_Node out;
+      relative_node(&nodes[i], &out);
+      JWriterPut(jw, (const char*)&out, sizeof(out));
+   }
+
+   // Indexes follow in the order of their objects:
+   for (const jd_Node *node = root; node; node = jd_Node_next_in_tree(node, root))
+   {
+      if (!(node->flags & JDN_INDEXED))
+         continue;
+
+      const jd_Index *index = (const jd_Index*)node->payload;
+      JWriterPut(jw, (const char*)&index->mask, sizeof(index->mask));
+      for (size_t slot = 0; slot <= index->mask; ++slot)
+      {
+         void *out = relative(index, index->slots[slot]);
+         JWriterPut(jw, (const char*)&out, sizeof(out));
+      }
+   }
+
+   JWriterPut(jw, (const char*)doc + nodes_bytes + size.index_bytes, size.string_bytes);
+
+   if (frozen)
+      jd_Node_destroy(&frozen, NULL);
+
+   return true;
+}
+
+/**
+ * @brief Make a mapped snapshot ready to use.
+ * @details
+ *    Checks the header against the file and this machine, and
+ *    fills in the parts of the document that are set when it is
+ *    mapped.  The nodes themselves are not read, so a snapshot of
+ *    any size is ready at once.  Use #snapshot_verify before
+ *    trusting a snapshot that may have been damaged.
+ *
+ * @param base     start of the mapped file, writable where the
+ *                 document is so its reference count can change
+ * @param len      bytes in the file
+ * @param release  function that will unmap the file
+ * @param pe       set to the offset and description of any problem
+ * @return Root of the snapshot, or NULL if the file is not a
+ *         snapshot this machine can use
+ */
+jd_Node *snapshot_attach(char *base, size_t len, jd_Source_release release, jd_ParseError *pe)
+{
+   JSHeader header;
+   const char *message = NULL;
+   int offset = 0;
+
+   if (len < JS_HEADER_SIZE + sizeof(jd_Document))
+   {
+      message = "file too short for a snapshot";
+      offset = (int)len;
+      goto early_exit;
+   }
+
+   memcpy(&header, base, sizeof(header));
+   if (memcmp(header.magic, JS_MAGIC, sizeof(header.magic)) != 0)
+      message = "not a snapshot";
+   else if (header.version != JS_VERSION)
+      message = "unsupported snapshot version";
+   else if (header.byte_order != JS_BYTE_ORDER
+            || header.node_size != sizeof(jd_Node)
+            || header.document_size != sizeof(jd_Document))
+      message = "snapshot was written by a different kind of machine";
+   else if (header.file_size != len
+            || header.node_count == 0
+            || header.node_count - 1 > (len - JS_HEADER_SIZE - sizeof(jd_Document)) / sizeof(jd_Node)
+            || header.index_bytes > len - JS_HEADER_SIZE - sizeof(jd_Document)
+                                    - (header.node_count - 1) * sizeof(jd_Node))
+      message = "snapshot size does not match its header";
+   else
+   {
+      jd_Document *doc = (jd_Document*)(base + JS_HEADER_SIZE);
+      if ((doc->root.flags & (JS_REQUIRED_FLAGS | JDN_DOCUMENT)) != (JS_REQUIRED_FLAGS | JDN_DOCUMENT))
+      {
+         message = "snapshot root is not a document";
+         offset = JS_HEADER_SIZE;
+         goto early_exit;
+      }
+
+      doc->source = base;
+      doc->source_len = len;
+      doc->release = release;
+      doc->refcount = 1;
+      doc->allocator = NULL;
+      return &doc->root;
+   }
+
+  early_exit:
+   pe->char_loc = offset;
+   pe->message = message;
+   return NULL;
+}
+
+/**
+ * @brief Layout of a mapped snapshot, for checking its offsets.
+ */
+typedef struct JSLayout_s {
+   const char    *base;        ///< start of the file
+   size_t        len;          ///< bytes in the file
+   const jd_Node *root;        ///< node number 0
+   const jd_Node *nodes;       ///< node number 1
+   uint64_t      node_count;   ///< number of nodes, including the root
+} JSLayout;
+
+/**
+ * @brief Find the number of the node at a relative offset.
+ * @param layout  snapshot being checked
+ * @param from    address holding the offset
+ * @param offset  offset to check, not zero
+ * @param number  set to the number of the node found
+ * @return True if the offset leads to the start of a node
+ */
+static bool node_number(const JSLayout *layout, const void *from, uintptr_t offset, uint64_t *number)
+{
+   uintptr_t target = (uintptr_t)from + offset;
+   if (target == (uintptr_t)layout->root)
+   {
+      *number = 0;
+      return true;
+   }
+
+   uintptr_t first = (uintptr_t)layout->nodes;
+   if (target < first || (target - first) % sizeof(jd_Node) != 0)
+      return false;
+
+   *number = (target - first) / sizeof(jd_Node) + 1;
+   return *number < layout->node_count;
+}
+
+/** Node with the given number */
+static inline const jd_Node *layout_node(const JSLayout *layout, uint64_t number)
+{
+   return number == 0 ? layout->root : &layout->nodes[number - 1];
+}
+
+/**
+ * @brief Find where a relative offset leads within the file.
+ * @return True if @b size bytes at the target lie within the file
+ */
+static bool file_range(const JSLayout *layout, const void *from, uintptr_t offset,
+                       size_t size, uintptr_t *place)
+{
+   uintptr_t target = (uintptr_t)from + offset - (uintptr_t)layout->base;
+   if (target >= layout->len || size > layout->len - target)
+      return false;
+
+   *place = target;
+   return true;
+}
+
+/**
+ * @brief Address a link of a snapshot node leads to, or zero.
+ * @details
+ *    Works in integers, as the node it reads may not have been
+ *    checked yet and its offset may lead anywhere.
+ */
+static inline uintptr_t link_address(const jd_Node *node, jd_Relation relation)
+{
+   uintptr_t link = (uintptr_t)((jd_Node* const*)node)[relation];
+   return link ? (uintptr_t)node + link : 0;
+}
+
+/**
+ * @brief Check the property index of a snapshot object.
+ */
+static bool verify_index(const JSLayout *layout, const jd_Node *object, uint64_t number)
+{
+   uintptr_t place;
+   if (!file_range(layout, object, (uintptr_t)object->payload, sizeof(jd_Index), &place)
+       || place % sizeof(void*) != 0)
+      return false;
+
+   const jd_Index *index = (const jd_Index*)(layout->base + place);
+   size_t room = (layout->len - place - sizeof(jd_Index)) / sizeof(jd_Node*);
+   if (index->mask >= room || (index->mask & (index->mask + 1)) != 0)
+      return false;
+
+   // A search ends at an empty slot, so there must be one:
+   bool empty = false;
+   for (size_t slot = 0; slot <= index->mask; ++slot)
+   {
+      uint64_t property;
+      if (index->slots[slot] == NULL)
+         empty = true;
+      else if (!node_number(layout, index, (uintptr_t)index->slots[slot], &property)
+               || property <= number
+               || layout_node(layout, property)->type != JD_PROPERTY
+               || link_address(layout_node(layout, property), JD_PARENT) != (uintptr_t)object)
+         return false;
+   }
+
+   return empty;
+}
+
+/**
+ * @brief Check that the text payload of a node lies in the file,
+ *        NUL-terminated at its recorded length.
+ */
+static bool verify_text(const JSLayout *layout, const jd_Node *node)
+{
+   uintptr_t place;
+   return (node->flags & JDN_SIZED)
+      && node->length < layout->len
+      && file_range(layout, node, (uintptr_t)node->payload, node->length + 1, &place)
+      && layout->base[place + node->length] == '\0';
+}
+
+/**
+ * @brief Check one node of a snapshot.
+ */
+static bool verify_node(const JSLayout *layout, const jd_Node *node, uint64_t number)
+{
+   if ((node->flags & JS_REQUIRED_FLAGS) != JS_REQUIRED_FLAGS
+       || (node->flags & ~JS_ALLOWED_FLAGS)
+       || (bool)(node->flags & JDN_DOCUMENT) != (number == 0)
+       || (unsigned int)node->type > JD_OBJECT)
+      return false;
+
+   // Links lead to nodes, down and ahead to later ones, up and back to earlier ones:
+   jd_Node * const *links = (jd_Node * const *)node;
+   for (int relation = JD_PARENT; relation <= JD_LAST; ++relation)
+   {
+      uint64_t linked;
+      if (links[relation] == NULL)
+         continue;
+      if (!node_number(layout, node, (uintptr_t)links[relation], &linked))
+         return false;
+
+      bool ahead = relation == JD_NEXT || relation == JD_FIRST || relation == JD_LAST;
+      if (ahead ? linked <= number : linked >= number)
+         return false;
+   }
+
+   if (number == 0 && (node->parent || node->nextSibling || node->prevSibling))
+      return false;
+
+   if ((node->firstChild == NULL) != (node->lastChild == NULL))
+      return false;
+
+   // Links agree with those of the nodes they lead to, so the nodes form one tree:
+   const jd_Node *up = jd_Node_relation(node, JD_PARENT);
+   const jd_Node *next = jd_Node_relation(node, JD_NEXT);
+   const jd_Node *prev = jd_Node_relation(node, JD_PREVIOUS);
+   const jd_Node *first = jd_Node_relation(node, JD_FIRST);
+   const jd_Node *last = jd_Node_relation(node, JD_LAST);
+   uintptr_t self = (uintptr_t)node;
+
+   if ((number != 0 && up == NULL)
+       || (up && (up->type == JD_OBJECT) != (node->type == JD_PROPERTY))
+       || (up && prev == NULL && link_address(up, JD_FIRST) != self)
+       || (up && next == NULL && link_address(up, JD_LAST) != self)
+       || (next && (link_address(next, JD_PREVIOUS) != self
+                    || link_address(next, JD_PARENT) != (uintptr_t)up))
+       || (prev && link_address(prev, JD_NEXT) != self)
+       || (first && (link_address(first, JD_PARENT) != self || first->prevSibling))
+       || (last && (link_address(last, JD_PARENT) != self || last->nextSibling)))
+      return false;
+
+   switch (node->type)
+   {
+      case JD_STRING:
+      case JD_INTEGER:
+      case JD_FLOAT:
+         if (node->payload == NULL)
+            return false;
+         // fall through
+      case JD_NULL:
+      case JD_TRUE:
+      case JD_FALSE:
+         return (node->payload == NULL || verify_text(layout, node))
+            && node->firstChild == NULL && !(node->flags & JDN_INDEXED);
+
+      case JD_PROPERTY:
+         // The label is the payload, the value the only child:
+         return node->payload && verify_text(layout, node)
+            && first && first == last
+            && first->type != JD_PROPERTY
+            && !(node->flags & JDN_INDEXED);
+
+      case JD_OBJECT:
+         if (node->flags & JDN_INDEXED)
+            return verify_index(layout, node, number);
+         // fall through
+      default:
+         return node->payload == NULL && !(node->flags & JDN_INDEXED);
+   }
+}
+
+/**
+ * @brief Check every node of a mapped snapshot.
+ * @details
+ *    Confirms that every offset leads into the file, that links
+ *    lead to nodes in the directions a tree allows and agree
+ *    with the links of the nodes they reach, so that no
+ *    walk can loop, and that the nodes are shaped as the
+ *    navigation functions expect.  Reads the whole snapshot.
+ *
+ * @param root  root of a snapshot made ready by #snapshot_attach
+ * @return True if the snapshot can be navigated safely
+ */
+bool snapshot_verify(const jd_Node *root)
+{
+   const jd_Document *doc = (const jd_Document*)root;
+
+   JSHeader header;
+   memcpy(&header, doc->source, sizeof(header));
+
+   JSLayout layout = {
+      doc->source,
+      doc->source_len,
+      root,
+      (const jd_Node*)(doc + 1),
+      header.node_count
+   };
+
+   for (uint64_t number = 0; number < layout.node_count; ++number)
+      if (!verify_node(&layout, layout_node(&layout, number), number))
+         return false;
+
+   return true;
+}
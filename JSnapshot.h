@@ -0,0 +1,60 @@
+/**
+ * @file JSnapshot.h
+ * @brief Functions that write and check snapshots, frozen trees
+ *        that are used in place wherever they are mapped.
+ *
+ * A snapshot file is a header followed by the block of a frozen
+ * tree, as made by freeze_tree, in which every address has been
+ * replaced by an offset from the node or index that holds it.
+ * Nodes are marked #JDN_RELATIVE so the navigation functions
+ * turn the offsets back into addresses as they are followed.
+ *
+ * Snapshots use the memory layout of the machine that wrote
+ * them, which the header records so that a snapshot from a
+ * different kind of machine is refused.
+ */
+
+#ifndef JSNAPSHOT_H
+#define JSNAPSHOT_H
+
+#include <stdint.h>
+#include "jd_Node.h"
+#include "JWriter.h"
+
+/** First eight bytes of every snapshot */
+#define JS_MAGIC "jdsnap\x00\x1a"
+
+/** Version of the snapshot layout written */
+#define JS_VERSION 3
+
+/** Value whose bytes show the byte order of the writing machine */
+#define JS_BYTE_ORDER 0x01020304
+
+/** Bytes before the document, keeping it aligned for any node member */
+#define JS_HEADER_SIZE 64
+
+/**
+ * @brief Start of a snapshot file
+ */
+typedef struct JSHeader_s {
+   char     magic[8];        ///< #JS_MAGIC
+   uint32_t version;         ///< #JS_VERSION
+   uint32_t byte_order;      ///< #JS_BYTE_ORDER as stored by the writer
+   uint32_t node_size;       ///< sizeof(jd_Node) of the writer
+   uint32_t document_size;   ///< sizeof(jd_Document) of the writer
+   uint64_t node_count;      ///< number of nodes, including the root
+   uint64_t index_bytes;     ///< bytes of property indexes after the nodes
+   uint64_t file_size;       ///< bytes in the whole file
+} JSHeader;
+
+/**
+ * @ingroup AllFunctions
+ * @defgroup SnapshotFuncs Functions that write and check snapshots
+ * @{
+ */
+bool snapshot_write(JWriter *jw, const jd_Node *root);
+jd_Node *snapshot_attach(char *base, size_t len, jd_Source_release release, jd_ParseError *pe);
+bool snapshot_verify(const jd_Node *root);
+/** @} */
+
+#endif
@@ -0,0 +1,87 @@
+/** @file JStats.c */
+
+/** Enable clock_gettime: */
+#define _POSIX_C_SOURCE 200809L
+
+#include "JStats.h"
+#include "jd_Node.h"
+#include "JPool.h"
+#include <string.h>   // memset
+#include <time.h>     // clock_gettime
+
+/** Monotonic clock in nanoseconds */
+uint64_t stats_clock(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Begin measuring a parse.
+ * @param run    uninitialized run memory
+ * @param stats  structure to fill in, or NULL to collect nothing
+ * @param jr     reader of the parse, which will count its reads
+ */
+void stats_start(JStatsRun *run, jd_ParseStats *stats, JReader *jr)
+{
+   memset(run, 0, sizeof(JStatsRun));
+   run->stats = stats;
+   if (stats == NULL)
+      return;
+
+   memset(stats, 0, sizeof(jd_ParseStats));
+   jr->stats = stats;
+
+   jd_PoolStats pool;
+   pool_get_stats(&pool);
+   run->allocations = pool.allocations;
+   run->allocated_bytes = pool.bytes_allocated;
+
+   run->start = stats_clock();
+}
+
+/**
+ * @brief Mark the end of building the tree, whether or not it succeeded.
+ */
+void stats_built(JStatsRun *run)
+{
+   if (run->stats)
+      run->built = stats_clock();
+}
+
+/**
+ * @brief Finish measuring a parse.
+ * @param run   run begun with #stats_start
+ * @param jr    reader of the parse
+ * @param tree  the finished tree, or NULL if the parse failed
+ */
+void stats_end(JStatsRun *run, const JReader *jr, const jd_Node *tree)
+{
+   jd_ParseStats *stats = run->stats;
+   if (stats == NULL)
+      return;
+
+   uint64_t end = stats_clock();
+   stats->total_ns = end - run->start;
+   stats->finish_ns = end - run->built;
+   stats->build_ns = run->built - run->start - stats->read_ns;
+
+   stats->bytes = JReaderOffset(jr);
+   stats->max_depth = jr->max_depth;
+
+   jd_PoolStats pool;
+   pool_get_stats(&pool);
+   stats->allocations = pool.allocations - run->allocations;
+   stats->allocated_bytes = pool.bytes_allocated - run->allocated_bytes;
+
+   for (const jd_Node *node = tree; node; node = jd_Node_next_in_tree(node, tree))
+   {
+      ++stats->nodes[node->type];
+      if (node->type == JD_STRING || node->type == JD_PROPERTY)
+      {
+         ++stats->strings;
+         stats->string_bytes += jd_Node_payload_length(node);
+      }
+   }
+}
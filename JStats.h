@@ -0,0 +1,40 @@
+/**
+ * @file JStats.h
+ * @brief Collection of the counters and timers of a jd_ParseStats.
+ *
+ * A parse that collects statistics brackets its work with
+ * #stats_start, #stats_built and #stats_end.  The reader counts
+ * its own @c read calls.  Nothing is collected, and no clock is
+ * read, when no jd_ParseStats was requested.
+ */
+
+#ifndef JSTATS_H
+#define JSTATS_H
+
+#include <stdint.h>
+#include "jsondom.h"
+#include "JReader.h"
+
+/**
+ * @brief Starting values of a parse being measured
+ */
+typedef struct JStatsRun_s {
+   jd_ParseStats *stats;           ///< destination, or NULL when not collecting
+   uint64_t      start;            ///< clock when the parse began
+   uint64_t      built;            ///< clock when the tree was complete
+   size_t        allocations;      ///< thread's pool allocations when the parse began
+   size_t        allocated_bytes;  ///< thread's pool bytes allocated when the parse began
+} JStatsRun;
+
+/**
+ * @ingroup AllFunctions
+ * @defgroup StatsFuncs Functions that collect parse statistics
+ * @{
+ */
+uint64_t stats_clock(void);
+void stats_start(JStatsRun *run, jd_ParseStats *stats, JReader *jr);
+void stats_built(JStatsRun *run);
+void stats_end(JStatsRun *run, const JReader *jr, const jd_Node *tree);
+/** @} */
+
+#endif
@@ -0,0 +1,232 @@
+/** @file JUtf8.c */
+
+#include "JUtf8.h"
+#include <stdint.h>   // uint64_t
+#include <string.h>   // memcpy
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * @brief Validate UTF-8 one sequence at a time.
+ * @details
+ *    Follows the well-formed byte sequences of Table 3-7 of the
+ *    Unicode Standard, which excludes overlong forms, surrogates,
+ *    and code points above U+10FFFF.
+ *
+ * @param str         text to validate
+ * @param len         number of bytes in @b str
+ * @param incomplete  set if @b str ends in the middle of a sequence
+ *                    that is valid as far as it goes
+ * @return Length of the valid prefix of @b str, which is the offset
+ *         of the first invalid or incomplete sequence if less
+ *         than @b len
+ */
+size_t utf8_validate_scalar(const unsigned char *str, size_t len, bool *incomplete)
+{
+   size_t pos = 0;
+   *incomplete = false;
+
+   while (pos < len)
+   {
+      // Skip ASCII a word at a time:
+      uint64_t word;
+      while (len - pos >= sizeof(word))
+      {
+         memcpy(&word, str + pos, sizeof(word));
+         if (word & 0x8080808080808080ULL)
+            break;
+         pos += sizeof(word);
+      }
+
+      if (pos == len)
+         break;
+
+      unsigned char lead = str[pos];
+      if (lead < 0x80)
+      {
+         ++pos;
+         continue;
+      }
+
+      // Allowed range of the second byte, and number of following bytes:
+      unsigned char lo = 0x80, hi = 0xBF;
+      int trailing;
+      if (lead >= 0xC2 && lead <= 0xDF)
+         trailing = 1;
+      else if (lead >= 0xE0 && lead <= 0xEF)
+      {
+         trailing = 2;
+         if (lead == 0xE0)
+            lo = 0xA0;        // overlong
+         else if (lead == 0xED)
+            hi = 0x9F;        // surrogates
+      }
+      else if (lead >= 0xF0 && lead <= 0xF4)
+      {
+         trailing = 3;
+         if (lead == 0xF0)
+            lo = 0x90;        // overlong
+         else if (lead == 0xF4)
+            hi = 0x8F;        // above U+10FFFF
+      }
+      else
+         return pos;
+
+      for (int i = 1; i <= trailing; ++i)
+      {
+         if (pos + i >= len)
+         {
+            *incomplete = true;
+            return pos;
+         }
+
+         unsigned char chr = str[pos + i];
+         if (chr < lo || chr > hi)
+            return pos;
+
+         lo = 0x80;
+         hi = 0xBF;
+      }
+
+      pos += trailing + 1;
+   }
+
+   return pos;
+}
+
+#if defined(__SSE2__)
+
+/** Bytes of @b cur moved @b n places later, filled from the end of @b prev */
+#define EARLIER(cur, prev, n) \
+   _mm_or_si128(_mm_slli_si128(cur, n), _mm_srli_si128(prev, 16 - (n)))
+
+/** Mask of bytes of @b x from @b lo to @b hi, unsigned */
+static inline __m128i bytes_in_range(__m128i x, unsigned char lo, unsigned char hi)
+{
+   __m128i ge = _mm_cmpeq_epi8(_mm_max_epu8(x, _mm_set1_epi8((char)lo)), x);
+   __m128i le = _mm_cmpeq_epi8(_mm_min_epu8(x, _mm_set1_epi8((char)hi)), x);
+   return _mm_and_si128(ge, le);
+}
+
+/** Mask of bytes of @b x equal to @b value */
+static inline __m128i bytes_equal(__m128i x, unsigned char value)
+{
+   return _mm_cmpeq_epi8(x, _mm_set1_epi8((char)value));
+}
+
+/**
+ * @brief Validate UTF-8 sixteen bytes at a time.
+ * @details
+ *    Each byte is classified by range, and the classes of the
+ *    preceding one to three bytes tell where continuation bytes
+ *    are required.  A block is invalid if continuation bytes
+ *    are missing or unexpected, if it contains bytes that never
+ *    appear in UTF-8, or if a second byte falls outside the
+ *    narrower range allowed after E0, ED, F0 or F4.
+ *
+ *    Blocks of pure ASCII that do not continue a sequence from
+ *    the previous block are skipped after a single test.
+ *
+ * @param str   text to validate
+ * @param len   number of bytes in @b str
+ * @return Number of bytes, a multiple of sixteen, in the blocks
+ *         found valid.  A sequence may straddle the end of the
+ *         last valid block.
+ */
+size_t utf8_validate_blocks(const unsigned char *str, size_t len)
+{
+   __m128i prev = _mm_setzero_si128();
+   __m128i prev_needs_more = _mm_setzero_si128();
+   size_t pos = 0;
+
+   for (; len - pos >= 16; pos += 16)
+   {
+      __m128i cur = _mm_loadu_si128((const __m128i*)(str + pos));
+
+      if (_mm_movemask_epi8(_mm_or_si128(cur, prev_needs_more)) == 0)
+      {
+         prev = cur;
+         continue;
+      }
+
+      __m128i prev1 = EARLIER(cur, prev, 1);
+      __m128i prev2 = EARLIER(cur, prev, 2);
+      __m128i prev3 = EARLIER(cur, prev, 3);
+
+      __m128i continuation = bytes_in_range(cur, 0x80, 0xBF);
+      __m128i required = _mm_or_si128(bytes_in_range(prev1, 0xC0, 0xFF),
+                                      _mm_or_si128(bytes_in_range(prev2, 0xE0, 0xFF),
+                                                   bytes_in_range(prev3, 0xF0, 0xFF)));
+
+      __m128i errors = _mm_xor_si128(continuation, required);
+      errors = _mm_or_si128(errors, bytes_in_range(cur, 0xC0, 0xC1));
+      errors = _mm_or_si128(errors, bytes_in_range(cur, 0xF5, 0xFF));
+      errors = _mm_or_si128(errors,
+                            _mm_and_si128(bytes_equal(prev1, 0xE0),
+                                          bytes_in_range(cur, 0x80, 0x9F)));
+      errors = _mm_or_si128(errors,
+                            _mm_and_si128(bytes_equal(prev1, 0xED),
+                                          bytes_in_range(cur, 0xA0, 0xBF)));
+      errors = _mm_or_si128(errors,
+                            _mm_and_si128(bytes_equal(prev1, 0xF0),
+                                          bytes_in_range(cur, 0x80, 0x8F)));
+      errors = _mm_or_si128(errors,
+                            _mm_and_si128(bytes_equal(prev1, 0xF4),
+                                          bytes_in_range(cur, 0x90, 0xBF)));
+
+      if (_mm_movemask_epi8(errors))
+         break;
+
+      // Leads near the end of this block need continuations in the next:
+      prev_needs_more = _mm_or_si128(
+         _mm_srli_si128(bytes_in_range(cur, 0xC0, 0xFF), 15),
+         _mm_or_si128(_mm_srli_si128(bytes_in_range(cur, 0xE0, 0xFF), 14),
+                      _mm_srli_si128(bytes_in_range(cur, 0xF0, 0xFF), 13)));
+      prev = cur;
+   }
+
+   return pos;
+}
+
+#endif   // __SSE2__
+
+/**
+ * @brief Find how much of a string is valid UTF-8.
+ * @details
+ *    Most of the text is checked in blocks by a vectorized
+ *    validator when one is available.  The scalar validator
+ *    handles the tail, and rescans from the last sequence
+ *    boundary before a failing block to find the exact offset
+ *    of the error.
+ *
+ * @param str         text to validate
+ * @param len         number of bytes in @b str
+ * @param incomplete  set if @b str ends in the middle of a sequence
+ *                    that is valid as far as it goes
+ * @return Length of the valid prefix of @b str, which is the offset
+ *         of the first invalid or incomplete sequence if less
+ *         than @b len
+ */
+size_t utf8_validate(const char *str, size_t len, bool *incomplete)
+{
+   const unsigned char *ustr = (const unsigned char*)str;
+   size_t start = 0;
+
+#if defined(__SSE2__)
+   start = utf8_validate_blocks(ustr, len);
+
+   // Back up to the start of any sequence straddling the boundary:
+   size_t backed = 0;
+   while (start > 0 && backed < 3 && (ustr[start - 1] & 0xC0) == 0x80)
+   {
+      --start;
+      ++backed;
+   }
+   if (start > 0 && ustr[start - 1] >= 0xC0)
+      --start;
+#endif
+
+   return start + utf8_validate_scalar(ustr + start, len - start, incomplete);
+}
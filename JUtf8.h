@@ -0,0 +1,20 @@
+/**
+ * @file JUtf8.h
+ * @brief UTF-8 validation of string contents
+ */
+
+#ifndef JUTF8_H
+#define JUTF8_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @ingroup AllFunctions
+ * @defgroup Utf8Funcs Functions that validate UTF-8 text
+ * @{
+ */
+size_t utf8_validate(const char *str, size_t len, bool *incomplete);
+/** @} */
+
+#endif
@@ -0,0 +1,347 @@
+/** @file JWriter.c */
+
+#include "JWriter.h"
+#include "JEscape.h"
+#include <stdlib.h>    // malloc/free
+#include <unistd.h>    // write
+#include <errno.h>     // EINTR
+#include <assert.h>
+
+/**
+ * @brief Prepare a JWriter to write to an open file handle.
+ * @details
+ *    If the buffer cannot be allocated, the writer is left
+ *    counting so it can be used and destroyed as usual, but
+ *    it is marked as failed.
+ * @param jw   uninitialized JWriter memory
+ * @param fh   handle to which the output will be written
+ * @return True for success, false if the buffer could not be allocated
+ */
+bool JWriterInitFile(JWriter *jw, int fh)
+{
+   assert(jw);
+
+   memset(jw, 0, sizeof(JWriter));
+   jw->fh = fh;
+
+   jw->buffer = (char*)malloc(JW_BUFFER_SIZE);
+   if (jw->buffer == NULL)
+   {
+      jw->mode = JW_COUNT;
+      jw->failed = true;
+      return false;
+   }
+
+   jw->mode = JW_FILE;
+   jw->ptr = jw->segment = jw->buffer;
+   jw->end = jw->buffer + JW_BUFFER_SIZE;
+   return true;
+}
+
+/**
+ * @brief Prepare a JWriter to fill a block of memory.
+ * @details
+ *    Output that does not fit in the block is counted but
+ *    discarded, so #JWriterTotal still reports the length
+ *    the complete output would need.
+ * @param jw      uninitialized JWriter memory
+ * @param buffer  memory to which the output will be copied
+ * @param len     number of characters available at @b buffer
+ */
+void JWriterInitMemory(JWriter *jw, char *buffer, size_t len)
+{
+   assert(jw);
+
+   memset(jw, 0, sizeof(JWriter));
+   jw->fh = -1;
+   jw->mode = JW_MEMORY;
+   jw->buffer = jw->ptr = buffer;
+   jw->end = buffer + len;
+}
+
+/**
+ * @brief Prepare a JWriter that only counts the characters it is given.
+ * @param jw   uninitialized JWriter memory
+ */
+void JWriterInitCount(JWriter *jw)
+{
+   assert(jw);
+
+   memset(jw, 0, sizeof(JWriter));
+   jw->fh = -1;
+   jw->mode = JW_COUNT;
+}
+
+/**
+ * @brief Flush any buffered output and release the buffer.
+ *        Does not close the file.
+ * @return True if all of the output was written
+ */
+bool JWriterDestroy(JWriter *jw)
+{
+   assert(jw);
+
+   if (jw->mode == JW_FILE)
+   {
+      JWriterFlush(jw);
+      free(jw->buffer);
+      jw->buffer = jw->ptr = jw->end = NULL;
+   }
+
+   return !jw->failed;
+}
+
+/**
+ * @brief Number of characters given to the writer so far.
+ */
+size_t JWriterTotal(const JWriter *jw)
+{
+   size_t pending = jw->buffer ? (size_t)(jw->ptr - jw->buffer) : 0;
+   return jw->total + pending;
+}
+
+/**
+ * @brief Write characters to the file handle, retrying short writes.
+ * @return True if every character was written
+ */
+bool write_fully(int fh, const char *str, size_t len)
+{
+   while (len > 0)
+   {
+      ssize_t bytes_written = write(fh, str, len);
+      if (bytes_written < 0)
+      {
+         if (errno == EINTR)
+            continue;
+         return false;
+      }
+
+      str += bytes_written;
+      len -= bytes_written;
+   }
+
+   return true;
+}
+
+/**
+ * @brief Write gathered pieces to the file handle, retrying short writes.
+ * @details
+ *    The iovec array is consumed in the process.
+ * @return True if every character was written
+ */
+bool writev_fully(int fh, struct iovec *iov, int count)
+{
+   while (count > 0)
+   {
+      ssize_t bytes_written = writev(fh, iov, count);
+      if (bytes_written < 0)
+      {
+         if (errno == EINTR)
+            continue;
+         return false;
+      }
+
+      while (count > 0 && (size_t)bytes_written >= iov->iov_len)
+      {
+         bytes_written -= iov->iov_len;
+         ++iov;
+         --count;
+      }
+
+      if (count > 0)
+      {
+         iov->iov_base = (char*)iov->iov_base + bytes_written;
+         iov->iov_len -= bytes_written;
+      }
+   }
+
+   return true;
+}
+
+/**
+ * @brief Make room in the buffer by passing on its contents.
+ * @details
+ *    After a failed write, the buffer is emptied without
+ *    writing so the caller can carry on to the end of the
+ *    document and check for the failure once.
+ *
+ *    A full memory buffer cannot be emptied, so the writer
+ *    switches to counting the rest of the output.
+ *
+ * @return True if there is room in the buffer for more output
+ */
+bool JWriterFlush(JWriter *jw)
+{
+   size_t pending = jw->ptr - jw->buffer;
+
+   switch(jw->mode)
+   {
+      case JW_FILE:
+         if (jw->iov_count == 0)
+         {
+            if (!jw->failed && pending)
+               jw->failed = !write_fully(jw->fh, jw->buffer, pending);
+         }
+         else
+         {
+            if (jw->ptr > jw->segment)
+            {
+               jw->iov[jw->iov_count].iov_base = jw->segment;
+               jw->iov[jw->iov_count].iov_len = jw->ptr - jw->segment;
+               ++jw->iov_count;
+            }
+
+            if (!jw->failed)
+               jw->failed = !writev_fully(jw->fh, jw->iov, jw->iov_count);
+            jw->iov_count = 0;
+         }
+
+         jw->total += pending;
+         jw->ptr = jw->segment = jw->buffer;
+         return true;
+
+      case JW_MEMORY:
+         jw->total += pending;
+         jw->buffer = jw->ptr = jw->end = NULL;
+         jw->mode = JW_COUNT;
+         return false;
+
+      default:
+         return false;
+   }
+}
+
+/**
+ * @brief Add characters that may not fit in the buffer.
+ * @details
+ *    Runs at least as long as the buffer are written directly
+ *    to a file handle after flushing, saving a copy.
+ */
+void JWriterPutLarge(JWriter *jw, const char *str, size_t len)
+{
+   while (len > 0)
+   {
+      if (jw->mode == JW_COUNT)
+      {
+         jw->total += len;
+         return;
+      }
+
+      size_t room = jw->end - jw->ptr;
+      if (room == 0)
+      {
+         if (!JWriterFlush(jw))
+            continue;
+
+         if (len >= JW_BUFFER_SIZE)
+         {
+            if (!jw->failed)
+               jw->failed = !write_fully(jw->fh, str, len);
+            jw->total += len;
+            return;
+         }
+
+         room = jw->end - jw->ptr;
+      }
+
+      size_t count = len < room ? len : room;
+      memcpy(jw->ptr, str, count);
+      jw->ptr += count;
+      str += count;
+      len -= count;
+   }
+}
+
+/**
+ * @brief Add characters that will not change before the next flush.
+ * @details
+ *    Long spans bound for a file handle are passed by reference
+ *    rather than copied into the buffer.  Everything else is
+ *    added as usual.
+ */
+void JWriterPutSpan(JWriter *jw, const char *str, size_t len)
+{
+   if (jw->mode != JW_FILE || len < JW_SPAN_MIN)
+   {
+      JWriterPut(jw, str, len);
+      return;
+   }
+
+   // Leave room for the span, the buffered output that precedes it,
+   // and any that follows it when the writer is flushed:
+   if (jw->iov_count + 3 > JW_IOV_MAX)
+      JWriterFlush(jw);
+
+   if (jw->ptr > jw->segment)
+   {
+      jw->iov[jw->iov_count].iov_base = jw->segment;
+      jw->iov[jw->iov_count].iov_len = jw->ptr - jw->segment;
+      ++jw->iov_count;
+      jw->segment = jw->ptr;
+   }
+
+   jw->iov[jw->iov_count].iov_base = (void*)str;
+   jw->iov[jw->iov_count].iov_len = len;
+   ++jw->iov_count;
+
+   jw->total += len;
+}
+
+/**
+ * @brief Add string contents, escaping characters as JSON requires.
+ * @details
+ *    Runs of plain characters are added as blocks, and each
+ *    character needing an escape is translated in a small
+ *    scratch area.  Enclosing quotes are not written.
+ */
+void JWriterPutEscaped(JWriter *jw, const char *str, size_t len)
+{
+   if (jw->mode == JW_COUNT)
+   {
+      jw->total += json_escaped_length(str, len);
+      return;
+   }
+
+   const char *end = str + len;
+
+   while (str < end)
+   {
+      const char *plain_end = json_scan_plain(str, end);
+      if (plain_end > str)
+         JWriterPut(jw, str, plain_end - str);
+
+      if (plain_end < end)
+      {
+         char escape[6];
+         char *escape_end = json_escape(escape, plain_end, 1);
+         JWriterPut(jw, escape, escape_end - escape);
+         ++plain_end;
+      }
+
+      str = plain_end;
+   }
+}
+
+/**
+ * @brief Add a character @b count times, as for indentation.
+ */
+void JWriterPutRepeated(JWriter *jw, char chr, size_t count)
+{
+   while (count > 0)
+   {
+      if (jw->mode == JW_COUNT)
+      {
+         jw->total += count;
+         return;
+      }
+
+      if (jw->ptr == jw->end && !JWriterFlush(jw))
+         continue;
+
+      size_t room = jw->end - jw->ptr;
+      size_t run = count < room ? count : room;
+      memset(jw->ptr, chr, run);
+      jw->ptr += run;
+      count -= run;
+   }
+}
@@ -0,0 +1,112 @@
+/**
+ * @file JWriter.h
+ * @brief Buffered character sink for the serializer.
+ *
+ * A JWriter collects output in a large buffer and passes it
+ * to an open file handle in a few large writes, rather than
+ * making a library or system call for each token.
+ *
+ * Long runs that will not change before the output is
+ * flushed, like text copied from a parsed source, can be
+ * passed to the file by reference, gathered with the
+ * buffered output by @c writev.
+ *
+ * A JWriter can also fill a caller's block of memory, or
+ * simply count the characters it is given in order to find
+ * the size of the output before producing it.
+ */
+
+#ifndef JWRITER_H
+#define JWRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>   // memcpy
+#include <sys/uio.h>  // struct iovec
+
+/** Size of the write buffer used for file handle sinks */
+#define JW_BUFFER_SIZE 262144
+
+/** Number of pieces gathered for a single flush */
+#define JW_IOV_MAX 64
+
+/** Shortest span worth passing by reference rather than copying */
+#define JW_SPAN_MIN 4096
+
+/** Typedef of JWriter_s struct */
+typedef struct JWriter_s JWriter;
+
+/**
+ * @brief Destinations of JWriter output
+ */
+typedef enum JWriterMode_e {
+   JW_FILE,     ///< buffer is flushed to a file handle
+   JW_MEMORY,   ///< buffer belongs to the caller and is never flushed
+   JW_COUNT     ///< characters are counted, not stored
+} JWriterMode;
+
+/**
+ * @brief Working values for writing a JSON document
+ */
+struct JWriter_s {
+   char        *ptr;      ///< next free position in the buffer
+   char        *end;      ///< first address past the buffer
+   char        *buffer;   ///< address of the output buffer
+   char        *segment;  ///< start of buffered output not yet in #iov
+   struct iovec iov[JW_IOV_MAX];  ///< pieces of output to be gathered by the next flush
+   int         iov_count; ///< number of pieces in #iov
+   size_t      total;     ///< characters passed on from the buffer, or counted
+   int         fh;        ///< file handle to which the buffer is flushed
+   JWriterMode mode;      ///< destination of the output
+   bool        failed;    ///< set when a write fails, suppresses further output
+};
+
+/**
+ * @ingroup AllFunctions
+ * @defgroup WriterFuncs Functions that manage a JWriter
+ * @{
+ */
+bool JWriterInitFile(JWriter *jw, int fh);
+void JWriterInitMemory(JWriter *jw, char *buffer, size_t len);
+void JWriterInitCount(JWriter *jw);
+bool JWriterDestroy(JWriter *jw);
+size_t JWriterTotal(const JWriter *jw);
+bool JWriterFlush(JWriter *jw);
+void JWriterPutLarge(JWriter *jw, const char *str, size_t len);
+void JWriterPutSpan(JWriter *jw, const char *str, size_t len);
+void JWriterPutEscaped(JWriter *jw, const char *str, size_t len);
+void JWriterPutRepeated(JWriter *jw, char chr, size_t count);
+/** @} */
+
+/**
+ * @brief Add characters to the output.
+ * @details
+ *    Short runs are copied to the buffer inline; anything
+ *    that does not fit is handed to #JWriterPutLarge.
+ * @param jw   writer to which the characters will be added
+ * @param str  characters to add
+ * @param len  number of characters in @b str
+ */
+static inline void JWriterPut(JWriter *jw, const char *str, size_t len)
+{
+   if (len <= (size_t)(jw->end - jw->ptr))
+   {
+      memcpy(jw->ptr, str, len);
+      jw->ptr += len;
+   }
+   else
+      JWriterPutLarge(jw, str, len);
+}
+
+/**
+ * @brief Add a single character to the output.
+ */
+static inline void JWriterPutChar(JWriter *jw, char chr)
+{
+   if (jw->ptr < jw->end)
+      *jw->ptr++ = chr;
+   else
+      JWriterPutLarge(jw, &chr, 1);
+}
+
+#endif
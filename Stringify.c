@@ -1,11 +1,16 @@
 #include "jsondom.h"
-#include "JParser.h"  // for Report_Error function pointer
+#include "jd_Node.h"  // for jd_Node_payload_length
 #include <string.h>   // for strlen, memcpy, etc
 #include <stdlib.h>   // for labs
 
-jd_NodeError jn_error = JNE_SUCCESS;
-
-int jd_Node_stringify_generic(const jd_Node *node,
+/**
+ * @brief Copy the text of a node's value into a buffer.
+ * @details
+ *    The result code is left in the context, or in the
+ *    default context if @b ctx is NULL.
+ */
+int jd_Node_stringify_generic(jd_Context *ctx,
+                            const jd_Node *node,
                             char *buffer,
                             int bufflen,
                             jd_Type type,
@@ -13,28 +18,35 @@ int jd_Node_stringify_generic(const jd_Node *node,
 {
    int retval = 0;
 
+   if (ctx == NULL)
+      ctx = &jd_default_context;
+
    if (node == NULL)
-      jn_error = JNE_NULL_NODE;
+      ctx->node_error = JNE_NULL_NODE;
    else if (node->type != type)
-      jn_error = JNE_INVALID_TYPE;
+      ctx->node_error = JNE_INVALID_TYPE;
    else
    {
       // No calling errors
-      jn_error = JNE_SUCCESS;
+      ctx->node_error = JNE_SUCCESS;
 
       if (value)
       {
-         retval = strlen(value) + 1;
+         if (type == JD_STRING || type == JD_INTEGER || type == JD_FLOAT)
+            retval = jd_Node_payload_length(node) + 1;
+         else
+            retval = strlen(value) + 1;
 
          if (buffer && bufflen > 0)
          {
+            // Copy characters only: value may not be NUL-terminated
             int copylen;
             if (bufflen < retval)
                copylen = bufflen - 1;
             else
-               copylen = retval;
+               copylen = retval - 1;
 
-            if (copylen > 1)
+            if (copylen > 0)
                memcpy(buffer, value, copylen);
             buffer[copylen] = '\0';
          }
@@ -44,24 +56,24 @@ int jd_Node_stringify_generic(const jd_Node *node,
    return retval;
 }
 
-int jd_Node_stringify_null(const jd_Node *node, char *buffer, int bufflen)
+int jd_Node_stringify_null(jd_Context *ctx, const jd_Node *node, char *buffer, int bufflen)
 {
-   return jd_Node_stringify_generic(node, buffer, bufflen, JD_NULL, "null");
+   return jd_Node_stringify_generic(ctx, node, buffer, bufflen, JD_NULL, "null");
 }
 
-int jd_Node_stringify_true(const jd_Node *node, char *buffer, int bufflen)
+int jd_Node_stringify_true(jd_Context *ctx, const jd_Node *node, char *buffer, int bufflen)
 {
-   return jd_Node_stringify_generic(node, buffer, bufflen, JD_TRUE, "true");
+   return jd_Node_stringify_generic(ctx, node, buffer, bufflen, JD_TRUE, "true");
 }
 
-int jd_Node_stringify_false(const jd_Node *node, char *buffer, int bufflen)
+int jd_Node_stringify_false(jd_Context *ctx, const jd_Node *node, char *buffer, int bufflen)
 {
-   return jd_Node_stringify_generic(node, buffer, bufflen, JD_FALSE, "false");
+   return jd_Node_stringify_generic(ctx, node, buffer, bufflen, JD_FALSE, "false");
 }
 
-int jd_Node_stringify_string(const jd_Node *node, char *buffer, int bufflen)
+int jd_Node_stringify_string(jd_Context *ctx, const jd_Node *node, char *buffer, int bufflen)
 {
-   return jd_Node_stringify_generic(node, buffer, bufflen, JD_STRING, (char*)node->payload);
+   return jd_Node_stringify_generic(ctx, node, buffer, bufflen, JD_STRING, (char*)node->payload);
 }
 
 void limited_long_copy(long lval, char **ptr, char *end)
@@ -80,17 +92,17 @@ void limited_long_copy(long lval, char **ptr, char *end)
    }
 }
 
-int jd_Node_stringify_integer(const jd_Node *node, char *buffer, int bufflen)
+int jd_Node_stringify_integer(jd_Context *ctx, const jd_Node *node, char *buffer, int bufflen)
 {
-   return jd_Node_stringify_generic(node, buffer, bufflen, JD_INTEGER, (char*)node->payload);
+   return jd_Node_stringify_generic(ctx, node, buffer, bufflen, JD_INTEGER, (char*)node->payload);
 }
 
-int jd_Node_stringify_float(const jd_Node *node, char *buffer, int bufflen)
+int jd_Node_stringify_float(jd_Context *ctx, const jd_Node *node, char *buffer, int bufflen)
 {
-   return jd_Node_stringify_generic(node, buffer, bufflen, JD_FLOAT, (char*)node->payload);
+   return jd_Node_stringify_generic(ctx, node, buffer, bufflen, JD_FLOAT, (char*)node->payload);
 }
 
-int jd_Node_stringify_property(const jd_Node *node, char *buffer, int bufflen)
+int jd_Node_stringify_property(jd_Context *ctx, const jd_Node *node, char *buffer, int bufflen)
 {
    return 0;
 }
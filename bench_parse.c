@@ -0,0 +1,441 @@
+/**
+ * @file bench_parse.c
+ * @brief Times parsing, navigating, serializing and destroying
+ *        documents, and reports throughput and memory use.
+ *
+ * Each file is read into memory once, then put through the
+ * four stages a number of times, and the best time of each
+ * stage is kept so that results are steady from run to run.
+ * Build and run it with `make bench`.
+ */
+
+/** Enable clock_gettime and getopt: */
+#define _POSIX_C_SOURCE 200809L
+
+#include "jsondom.h"
+#include <stdio.h>
+#include <stdlib.h>        // for malloc/free
+#include <string.h>        // for strcmp
+#include <time.h>          // for clock_gettime
+#include <fcntl.h>         // for open
+#include <unistd.h>        // for read, getopt
+#include <sys/stat.h>      // for fstat
+#include <sys/resource.h>  // for getrusage
+#ifdef __GLIBC__
+#include <malloc.h>        // for mallinfo2
+#endif
+
+/** Passes over each file unless set with -n */
+#define BENCH_ITERATIONS 5
+
+/** Bytes in the megabyte of MB/s */
+#define BENCH_MB 1000000.0
+
+typedef enum BenchFormat_e {
+   BENCH_TEXT,
+   BENCH_CSV,
+   BENCH_JSON
+} BenchFormat;
+
+/**
+ * @brief Measurements of one file, or the sum of all of them
+ */
+typedef struct BenchResult_s {
+   const char *name;         ///< file name, or "total"
+   size_t     bytes;         ///< bytes of JSON input
+   size_t     nodes;         ///< nodes in the document
+   size_t     output_bytes;  ///< bytes of compact serialized output
+   size_t     dom_bytes;     ///< heap memory held by the document
+   double     parse;         ///< best seconds to parse
+   double     navigate;      ///< best seconds to visit every node
+   double     serialize;     ///< best seconds to serialize to memory
+   double     destroy;       ///< best seconds to destroy
+} BenchResult;
+
+/** Settings for compact output, so the serializer does all the work */
+static const jd_SerializeOptions compact = { 0, false };
+
+/** Keeps the compiler from discarding the work of #walk */
+static volatile size_t bench_sink;
+
+/** Monotonic time in seconds */
+static double now(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/** Largest resident set size of the process so far, in kilobytes */
+static long peak_rss_kb(void)
+{
+   struct rusage usage;
+   getrusage(RUSAGE_SELF, &usage);
+   return usage.ru_maxrss;
+}
+
+/**
+ * @brief Bytes of heap memory now allocated.
+ * @details
+ *    Without glibc there is no way to ask, so the DOM size is
+ *    reported as zero.
+ */
+static size_t heap_in_use(void)
+{
+#ifdef __GLIBC__
+   struct mallinfo2 info = mallinfo2();
+   return info.uordblks + info.hblkhd;
+#else
+   return 0;
+#endif
+}
+
+/**
+ * @brief Read a whole file into a new buffer.
+ * @return The contents, to be freed by the caller, or NULL
+ */
+static char *read_file(const char *path, size_t *len)
+{
+   int fd = open(path, O_RDONLY);
+   if (fd < 0)
+      return NULL;
+
+   char *buffer = NULL;
+   struct stat fstats;
+   if (fstat(fd, &fstats) == 0 && (buffer = (char*)malloc(fstats.st_size + 1)))
+   {
+      size_t got = 0;
+      ssize_t bytes;
+      while (got < (size_t)fstats.st_size
+             && (bytes = read(fd, buffer + got, fstats.st_size - got)) > 0)
+         got += bytes;
+
+      buffer[got] = '\0';
+      *len = got;
+   }
+
+   close(fd);
+   return buffer;
+}
+
+/**
+ * @brief Visit every node through the public navigation functions.
+ * @return Number of nodes visited
+ */
+static size_t walk(jd_Node *root)
+{
+   size_t count = 0;
+   size_t sink = 0;
+   jd_Node *node = root;
+   while (node)
+   {
+      ++count;
+      sink += jd_id_type(node) + (size_t)jd_generic_value(node);
+
+      jd_Node *next = firstChild(node);
+      if (next == NULL)
+      {
+         while (node != root && (next = nextSibling(node)) == NULL)
+            node = parent(node);
+      }
+
+      node = next;
+   }
+
+   bench_sink = sink;
+   return count;
+}
+
+/** Keep the smaller of a best time and a new one, or the first */
+static void keep_best(double *best, double seconds, bool first)
+{
+   if (first || seconds < *best)
+      *best = seconds;
+}
+
+/**
+ * @brief Measure one file.
+ * @return True for success, false if the file could not be read or parsed
+ */
+static bool bench_file(const char *path, int iterations, BenchResult *result)
+{
+   memset(result, 0, sizeof(BenchResult));
+   result->name = path;
+
+   char *source = read_file(path, &result->bytes);
+   if (source == NULL)
+   {
+      fprintf(stderr, "Unable to read '%s'.\n", path);
+      return false;
+   }
+
+   char *output = NULL;
+   bool retval = true;
+
+   for (int i = 0; i < iterations && retval; ++i)
+   {
+      jd_Node *tree;
+      jd_ParseError pe;
+
+      // Measure the DOM on the first pass, before cached memory is reused:
+      if (i == 0)
+         jd_pool_trim();
+      size_t heap_before = heap_in_use();
+
+      double t0 = now();
+      if (!jd_parse_buffer(source, result->bytes, JD_PARSE_DEFAULT, &tree, &pe))
+      {
+         fprintf(stderr, "Unable to parse '%s': %s at %d.\n", path, pe.message, pe.char_loc);
+         retval = false;
+         break;
+      }
+      double t1 = now();
+
+      if (i == 0)
+      {
+         result->dom_bytes = heap_in_use() - heap_before;
+         result->output_bytes = jd_serialized_length(tree, &compact);
+         output = (char*)malloc(result->output_bytes + 1);
+         if (output == NULL)
+         {
+            fprintf(stderr, "Out of memory for output of '%s'.\n", path);
+            jd_destroy(&tree);
+            retval = false;
+            break;
+         }
+      }
+
+      double t2 = now();
+      result->nodes = walk(tree);
+      double t3 = now();
+      jd_serialize_to_buffer(tree, output, result->output_bytes + 1, &compact);
+      double t4 = now();
+      jd_destroy(&tree);
+      double t5 = now();
+
+      keep_best(&result->parse, t1 - t0, i == 0);
+      keep_best(&result->navigate, t3 - t2, i == 0);
+      keep_best(&result->serialize, t4 - t3, i == 0);
+      keep_best(&result->destroy, t5 - t4, i == 0);
+   }
+
+   free(output);
+   free(source);
+   return retval;
+}
+
+/** Add the measurements of one file to the total */
+static void add_result(BenchResult *total, const BenchResult *result)
+{
+   total->bytes += result->bytes;
+   total->nodes += result->nodes;
+   total->output_bytes += result->output_bytes;
+   total->dom_bytes += result->dom_bytes;
+   total->parse += result->parse;
+   total->navigate += result->navigate;
+   total->serialize += result->serialize;
+   total->destroy += result->destroy;
+}
+
+/** Megabytes per second, or zero when too fast to time */
+static double mb_per_second(size_t bytes, double seconds)
+{
+   return seconds > 0 ? (double)bytes / BENCH_MB / seconds : 0;
+}
+
+/** Nanoseconds per node */
+static double ns_per_node(double seconds, size_t nodes)
+{
+   return nodes ? seconds * 1e9 / (double)nodes : 0;
+}
+
+/** Bytes of DOM per byte of input */
+static double dom_ratio(const BenchResult *result)
+{
+   return result->bytes ? (double)result->dom_bytes / (double)result->bytes : 0;
+}
+
+/**
+ * @brief Print the heading of a report.
+ */
+static void print_heading(BenchFormat format, int iterations)
+{
+   switch (format)
+   {
+      case BENCH_TEXT:
+         printf("Best of %d passes; MB is %.0f bytes\n", iterations, BENCH_MB);
+         printf("%-32s %10s %9s %9s %8s %8s %9s %8s %8s %9s\n",
+                "file", "bytes", "nodes", "parse", "parse", "walk",
+                "serialize", "destroy", "DOM", "peak RSS");
+         printf("%-32s %10s %9s %9s %8s %8s %9s %8s %8s %9s\n",
+                "", "", "", "MB/s", "ns/node", "ns/node",
+                "MB/s", "ns/node", "B/byte", "KB");
+         break;
+      case BENCH_CSV:
+         printf("file,bytes,nodes,iterations,"
+                "parse_s,parse_mb_s,parse_ns_node,"
+                "navigate_s,navigate_ns_node,"
+                "serialize_s,serialize_mb_s,"
+                "destroy_s,destroy_ns_node,"
+                "dom_bytes,dom_per_byte,peak_rss_kb\n");
+         break;
+      case BENCH_JSON:
+         printf("{\n  \"iterations\": %d,\n  \"results\": [", iterations);
+         break;
+   }
+}
+
+/**
+ * @brief Print the measurements of one file or the total.
+ * @param first  true for the first row of the report
+ */
+static void print_result(BenchFormat format, int iterations, const BenchResult *result, bool first)
+{
+   long rss = peak_rss_kb();
+
+   switch (format)
+   {
+      case BENCH_TEXT:
+         printf("%-32s %10zu %9zu %9.1f %8.1f %8.1f %9.1f %8.1f %8.2f %9ld\n",
+                result->name,
+                result->bytes,
+                result->nodes,
+                mb_per_second(result->bytes, result->parse),
+                ns_per_node(result->parse, result->nodes),
+                ns_per_node(result->navigate, result->nodes),
+                mb_per_second(result->output_bytes, result->serialize),
+                ns_per_node(result->destroy, result->nodes),
+                dom_ratio(result),
+                rss);
+         break;
+      case BENCH_CSV:
+         printf("%s,%zu,%zu,%d,%.9f,%.3f,%.3f,%.9f,%.3f,%.9f,%.3f,%.9f,%.3f,%zu,%.4f,%ld\n",
+                result->name,
+                result->bytes,
+                result->nodes,
+                iterations,
+                result->parse,
+                mb_per_second(result->bytes, result->parse),
+                ns_per_node(result->parse, result->nodes),
+                result->navigate,
+                ns_per_node(result->navigate, result->nodes),
+                result->serialize,
+                mb_per_second(result->output_bytes, result->serialize),
+                result->destroy,
+                ns_per_node(result->destroy, result->nodes),
+                result->dom_bytes,
+                dom_ratio(result),
+                rss);
+         break;
+      case BENCH_JSON:
+         // Names are file paths, which are written as they are:
+         printf("%s\n    {\"file\": \"%s\", \"bytes\": %zu, \"nodes\": %zu,"
+                " \"parse_s\": %.9f, \"parse_mb_s\": %.3f, \"parse_ns_node\": %.3f,"
+                " \"navigate_s\": %.9f, \"navigate_ns_node\": %.3f,"
+                " \"serialize_s\": %.9f, \"serialize_mb_s\": %.3f,"
+                " \"destroy_s\": %.9f, \"destroy_ns_node\": %.3f,"
+                " \"dom_bytes\": %zu, \"dom_per_byte\": %.4f, \"peak_rss_kb\": %ld}",
+                first ? "" : ",",
+                result->name,
+                result->bytes,
+                result->nodes,
+                result->parse,
+                mb_per_second(result->bytes, result->parse),
+                ns_per_node(result->parse, result->nodes),
+                result->navigate,
+                ns_per_node(result->navigate, result->nodes),
+                result->serialize,
+                mb_per_second(result->output_bytes, result->serialize),
+                result->destroy,
+                ns_per_node(result->destroy, result->nodes),
+                result->dom_bytes,
+                dom_ratio(result),
+                rss);
+         break;
+   }
+}
+
+/** Print the end of a report */
+static void print_ending(BenchFormat format)
+{
+   if (format == BENCH_JSON)
+      printf("\n  ]\n}\n");
+}
+
+static void show_usage(const char *program)
+{
+   fprintf(stderr,
+           "Usage: %s [-f text|csv|json] [-n passes] file.json ...\n"
+           "Times parse, navigate, serialize and destroy of each file,\n"
+           "keeping the best of %d passes unless set with -n.\n",
+           program, BENCH_ITERATIONS);
+}
+
+int main(int argc, char **argv)
+{
+   BenchFormat format = BENCH_TEXT;
+   int iterations = BENCH_ITERATIONS;
+
+   int opt;
+   while ((opt = getopt(argc, argv, "f:n:h")) != -1)
+   {
+      switch (opt)
+      {
+         case 'f':
+            if (strcmp(optarg, "text") == 0)
+               format = BENCH_TEXT;
+            else if (strcmp(optarg, "csv") == 0)
+               format = BENCH_CSV;
+            else if (strcmp(optarg, "json") == 0)
+               format = BENCH_JSON;
+            else
+            {
+               show_usage(argv[0]);
+               return 1;
+            }
+            break;
+         case 'n':
+            iterations = atoi(optarg);
+            if (iterations < 1)
+            {
+               show_usage(argv[0]);
+               return 1;
+            }
+            break;
+         default:
+            show_usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+      }
+   }
+
+   if (optind >= argc)
+   {
+      show_usage(argv[0]);
+      return 1;
+   }
+
+   BenchResult total;
+   memset(&total, 0, sizeof(total));
+   total.name = "total";
+
+   int failures = 0;
+   bool first = true;
+
+   print_heading(format, iterations);
+   for (int i = optind; i < argc; ++i)
+   {
+      BenchResult result;
+      if (bench_file(argv[i], iterations, &result))
+      {
+         print_result(format, iterations, &result, first);
+         add_result(&total, &result);
+         first = false;
+      }
+      else
+         ++failures;
+   }
+   print_result(format, iterations, &total, first);
+   print_ending(format);
+
+   return failures ? 1 : 0;
+}
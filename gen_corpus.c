@@ -0,0 +1,499 @@
+/**
+ * @file gen_corpus.c
+ * @brief Writes synthetic JSON documents for benchmarks and stress tests.
+ *
+ * Documents are made from a seeded generator, so the same seed,
+ * size and shape always produce the same bytes on any machine,
+ * with no download needed.  Each shape stresses a different part
+ * of a parser:
+ *
+ * - @b deep       arrays and objects nested many levels deep
+ * - @b wide       one flat array of many small scalars
+ * - @b records    an array of objects with the same keys
+ * - @b telemetry  objects that are mostly integers and floats
+ * - @b strings    long strings full of escapes and UTF-8
+ *
+ * Any shape can be written minified or pretty.  A pretty document
+ * holds the same values as the minified one of the same seed and
+ * size, so the two show the cost of whitespace alone.
+ *
+ * `make bench` builds the program and fills the corpus directory.
+ */
+
+/** Enable snprintf and getopt: */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>      // for strtoull
+#include <stdint.h>      // for uint64_t
+#include <stdbool.h>
+#include <string.h>      // for strcmp, strlen
+#include <unistd.h>      // for getopt
+#include <errno.h>       // for EEXIST
+#include <sys/stat.h>    // for mkdir
+
+/** Bytes of minified JSON written unless set with -b */
+#define GEN_SIZE (1024 * 1024)
+
+/** Seed used unless set with -s */
+#define GEN_SEED 1
+
+/** Levels in each nest of the deep shape unless set with -D */
+#define GEN_DEPTH 64
+
+/** Spaces per level of a pretty document */
+#define GEN_INDENT 2
+
+/**
+ * @brief State of a document being written.
+ */
+typedef struct Gen_s {
+   FILE     *out;      ///< destination of the document
+   uint64_t rng;       ///< state of the random number generator
+   size_t   bytes;     ///< bytes written, not counting pretty whitespace
+   bool     pretty;    ///< add newlines and indentation
+   int      level;     ///< number of collections now open
+   bool     first;     ///< nothing yet written in the innermost collection
+   bool     labelled;  ///< a label was written, so its value comes next
+} Gen;
+
+/**
+ * @brief Next random number, from the SplitMix64 sequence.
+ * @details
+ *    Used in place of @c rand so the output does not depend
+ *    on the C library.
+ */
+static uint64_t next_random(Gen *gen)
+{
+   uint64_t z = (gen->rng += 0x9E3779B97F4A7C15ULL);
+   z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+   z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+   return z ^ (z >> 31);
+}
+
+/** Random number from 0 to @b limit - 1 */
+static uint64_t random_below(Gen *gen, uint64_t limit)
+{
+   return next_random(gen) % limit;
+}
+
+/** Write JSON text */
+static void put(Gen *gen, const char *text)
+{
+   size_t len = strlen(text);
+   fwrite(text, 1, len, gen->out);
+   gen->bytes += len;
+}
+
+/** Write a newline and indentation in a pretty document */
+static void put_break(Gen *gen)
+{
+   if (gen->pretty)
+   {
+      fputc('\n', gen->out);
+      for (int i = gen->level * GEN_INDENT; i > 0; --i)
+         fputc(' ', gen->out);
+   }
+}
+
+/** Separate a new value or label from the one before it */
+static void begin_value(Gen *gen)
+{
+   if (gen->labelled)
+      gen->labelled = false;
+   else if (gen->level > 0)
+   {
+      if (!gen->first)
+         put(gen, ",");
+      put_break(gen);
+   }
+   gen->first = false;
+}
+
+/** Start an array or object */
+static void open_collection(Gen *gen, const char *open)
+{
+   begin_value(gen);
+   put(gen, open);
+   ++gen->level;
+   gen->first = true;
+}
+
+/** End an array or object */
+static void close_collection(Gen *gen, const char *close)
+{
+   --gen->level;
+   if (!gen->first)
+      put_break(gen);
+   put(gen, close);
+   gen->first = false;
+}
+
+/** Write the label of the next property of an object */
+static void put_label(Gen *gen, const char *label)
+{
+   begin_value(gen);
+   put(gen, "\"");
+   put(gen, label);
+   put(gen, "\":");
+   if (gen->pretty)
+      fputc(' ', gen->out);
+   gen->labelled = true;
+}
+
+/** Write a scalar value */
+static void put_scalar(Gen *gen, const char *text)
+{
+   begin_value(gen);
+   put(gen, text);
+}
+
+/** Write an integer */
+static void put_integer(Gen *gen, long long value)
+{
+   char buffer[32];
+   snprintf(buffer, sizeof(buffer), "%lld", value);
+   put_scalar(gen, buffer);
+}
+
+/** Write a float with fraction digits, and sometimes an exponent */
+static void put_float(Gen *gen, double scale)
+{
+   char buffer[48];
+   double value = ((double)(next_random(gen) >> 11) / 9007199254740992.0 - 0.5) * scale;
+   if (random_below(gen, 8) == 0)
+      snprintf(buffer, sizeof(buffer), "%.*e", (int)random_below(gen, 12) + 1, value);
+   else
+      snprintf(buffer, sizeof(buffer), "%.*f", (int)random_below(gen, 6) + 1, value);
+   put_scalar(gen, buffer);
+}
+
+/** Words from which plain strings are made */
+static const char *words[] = {
+   "alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf",
+   "hotel", "india", "juliet", "kilo", "lima", "mike", "november",
+   "oscar", "papa", "quebec", "romeo", "sierra", "tango", "uniform",
+   "victor", "whiskey", "xray", "yankee", "zulu"
+};
+
+/** Number of entries in #words */
+#define WORD_COUNT (sizeof(words) / sizeof(words[0]))
+
+/** Write a string of @b count words joined by @b separator */
+static void put_words(Gen *gen, int count, const char *separator)
+{
+   begin_value(gen);
+   put(gen, "\"");
+   for (int i = 0; i < count; ++i)
+   {
+      if (i)
+         put(gen, separator);
+      put(gen, words[random_below(gen, WORD_COUNT)]);
+   }
+   put(gen, "\"");
+}
+
+/** Pieces of escape-heavy strings: escapes, raw UTF-8 and plain text */
+static const char *string_pieces[] = {
+   "\\\"", "\\\\", "\\/", "\\b", "\\f", "\\n", "\\r", "\\t",
+   "\\u00e9", "\\u20ac", "\\ud83d\\ude00", "\\u0001",
+   "\xc3\xa9", "\xe2\x82\xac", "\xe6\x97\xa5\xe6\x9c\xac", "\xf0\x9f\x98\x80",
+   "plain text ", "more plain text, ", "x"
+};
+
+/** Number of entries in #string_pieces */
+#define PIECE_COUNT (sizeof(string_pieces) / sizeof(string_pieces[0]))
+
+/** Write a string of about @b length bytes made of random #string_pieces */
+static void put_escaped_string(Gen *gen, size_t length)
+{
+   begin_value(gen);
+   put(gen, "\"");
+   size_t end = gen->bytes + length;
+   while (gen->bytes < end)
+      put(gen, string_pieces[random_below(gen, PIECE_COUNT)]);
+   put(gen, "\"");
+}
+
+/**
+ * @brief Write one nest of the deep shape.
+ * @details
+ *    Levels alternate between objects and arrays, each holding
+ *    its level number and the next level, down to a string.
+ */
+static void put_nest(Gen *gen, int depth)
+{
+   for (int level = 0; level < depth; ++level)
+   {
+      if (level % 2 == 0)
+      {
+         open_collection(gen, "{");
+         put_label(gen, "depth");
+         put_integer(gen, level);
+         put_label(gen, "child");
+      }
+      else
+      {
+         open_collection(gen, "[");
+         put_integer(gen, level);
+      }
+   }
+
+   put_words(gen, 2, " ");
+
+   for (int level = depth - 1; level >= 0; --level)
+      close_collection(gen, level % 2 == 0 ? "}" : "]");
+}
+
+/** Write one scalar of the wide shape */
+static void put_wide_item(Gen *gen)
+{
+   switch (random_below(gen, 8))
+   {
+      case 0: put_scalar(gen, "null"); break;
+      case 1: put_scalar(gen, "true"); break;
+      case 2: put_scalar(gen, "false"); break;
+      case 3: put_words(gen, 1, ""); break;
+      case 4: put_float(gen, 1e4); break;
+      default:
+         put_integer(gen, (long long)random_below(gen, 2000000) - 1000000);
+         break;
+   }
+}
+
+/** Write one object of the records shape */
+static void put_record(Gen *gen, uint64_t id)
+{
+   open_collection(gen, "{");
+   put_label(gen, "id");
+   put_integer(gen, (long long)id);
+   put_label(gen, "name");
+   put_words(gen, 2, " ");
+   put_label(gen, "email");
+   put_words(gen, 2, ".");
+   put_label(gen, "active");
+   put_scalar(gen, random_below(gen, 2) ? "true" : "false");
+   put_label(gen, "score");
+   put_float(gen, 200);
+   put_label(gen, "manager");
+   if (random_below(gen, 4) == 0)
+      put_scalar(gen, "null");
+   else
+      put_integer(gen, (long long)random_below(gen, id + 1));
+   put_label(gen, "tags");
+   open_collection(gen, "[");
+   for (int i = (int)random_below(gen, 5); i > 0; --i)
+      put_words(gen, 1, "");
+   close_collection(gen, "]");
+   put_label(gen, "address");
+   open_collection(gen, "{");
+   put_label(gen, "street");
+   put_words(gen, 2, " ");
+   put_label(gen, "city");
+   put_words(gen, 1, "");
+   put_label(gen, "zip");
+   put_integer(gen, (long long)random_below(gen, 100000));
+   close_collection(gen, "}");
+   close_collection(gen, "}");
+}
+
+/** Write one reading of the telemetry shape */
+static void put_reading(Gen *gen, uint64_t sequence)
+{
+   open_collection(gen, "{");
+   put_label(gen, "ts");
+   put_integer(gen, 1700000000000LL + (long long)sequence * 250);
+   put_label(gen, "sensor");
+   put_integer(gen, (long long)random_below(gen, 512));
+   put_label(gen, "temperature");
+   put_float(gen, 120);
+   put_label(gen, "pressure");
+   put_float(gen, 2e5);
+   put_label(gen, "status");
+   put_integer(gen, (long long)random_below(gen, 16));
+   put_label(gen, "samples");
+   open_collection(gen, "[");
+   for (int i = 0; i < 16; ++i)
+      put_float(gen, 10);
+   close_collection(gen, "]");
+   put_label(gen, "counters");
+   open_collection(gen, "[");
+   for (int i = 0; i < 8; ++i)
+      put_integer(gen, (long long)(next_random(gen) >> 24));
+   close_collection(gen, "]");
+   close_collection(gen, "}");
+}
+
+/** Names of the shapes, in the order of #Shape */
+static const char *shape_names[] = {
+   "deep", "wide", "records", "telemetry", "strings"
+};
+
+typedef enum Shape_e {
+   SHAPE_DEEP,
+   SHAPE_WIDE,
+   SHAPE_RECORDS,
+   SHAPE_TELEMETRY,
+   SHAPE_STRINGS,
+   SHAPE_COUNT
+} Shape;
+
+/**
+ * @brief Write a whole document.
+ * @details
+ *    The document is an array of items of the shape, added until
+ *    its minified length reaches @b size.
+ */
+static void generate(FILE *out, Shape shape, uint64_t seed, size_t size, bool pretty, int depth)
+{
+   Gen gen = { out, seed, 0, pretty, 0, true, false };
+
+   open_collection(&gen, "[");
+   for (uint64_t item = 0; gen.bytes < size; ++item)
+   {
+      switch (shape)
+      {
+         case SHAPE_DEEP:      put_nest(&gen, depth);                                        break;
+         case SHAPE_WIDE:      put_wide_item(&gen);                                          break;
+         case SHAPE_RECORDS:   put_record(&gen, item);                                       break;
+         case SHAPE_TELEMETRY: put_reading(&gen, item);                                      break;
+         case SHAPE_STRINGS:   put_escaped_string(&gen, 256 + random_below(&gen, 16 * 1024)); break;
+         case SHAPE_COUNT:                                                                   break;
+      }
+   }
+   close_collection(&gen, "]");
+   fputc('\n', out);
+}
+
+/**
+ * @brief Read a size with an optional k, m or g suffix for
+ *        multiples of 1024.
+ * @return The size, or 0 if it is not valid
+ */
+static size_t parse_size(const char *text)
+{
+   char *end;
+   unsigned long long size = strtoull(text, &end, 10);
+   switch (*end)
+   {
+      case 'k': case 'K': size <<= 10; ++end; break;
+      case 'm': case 'M': size <<= 20; ++end; break;
+      case 'g': case 'G': size <<= 30; ++end; break;
+   }
+
+   return *end ? 0 : (size_t)size;
+}
+
+/**
+ * @brief Write every shape, minified and pretty, into a directory.
+ * @return True for success, false if a file could not be written
+ */
+static bool generate_corpus(const char *dir, uint64_t seed, size_t size, int depth)
+{
+   if (mkdir(dir, 0775) != 0 && errno != EEXIST)
+   {
+      fprintf(stderr, "Unable to make directory '%s'.\n", dir);
+      return false;
+   }
+
+   for (int shape = 0; shape < SHAPE_COUNT; ++shape)
+   {
+      for (int pretty = 0; pretty < 2; ++pretty)
+      {
+         char path[1024];
+         snprintf(path, sizeof(path), "%s/%s%s.json", dir, shape_names[shape], pretty ? "-pretty" : "");
+
+         FILE *out = fopen(path, "w");
+         if (out == NULL)
+         {
+            fprintf(stderr, "Unable to write '%s'.\n", path);
+            return false;
+         }
+
+         generate(out, (Shape)shape, seed, size, pretty, depth);
+         if (fclose(out) != 0)
+         {
+            fprintf(stderr, "Unable to write '%s'.\n", path);
+            return false;
+         }
+      }
+   }
+
+   return true;
+}
+
+static void show_usage(const char *program)
+{
+   fprintf(stderr,
+           "Usage: %s [-s seed] [-b size] [-D depth] [-p] shape\n"
+           "       %s [-s seed] [-b size] [-D depth] -o directory\n"
+           "Writes a synthetic JSON document of a shape to standard output,\n"
+           "or every shape, minified and pretty, into a directory.\n"
+           "Shapes: deep, wide, records, telemetry, strings.\n"
+           "Sizes take a k, m or g suffix; the default is 1m of minified JSON.\n",
+           program, program);
+}
+
+int main(int argc, char **argv)
+{
+   uint64_t seed = GEN_SEED;
+   size_t size = GEN_SIZE;
+   int depth = GEN_DEPTH;
+   bool pretty = false;
+   const char *dir = NULL;
+
+   int opt;
+   while ((opt = getopt(argc, argv, "s:b:D:po:h")) != -1)
+   {
+      switch (opt)
+      {
+         case 's':
+            seed = strtoull(optarg, NULL, 10);
+            break;
+         case 'b':
+            if ((size = parse_size(optarg)) == 0)
+            {
+               show_usage(argv[0]);
+               return 1;
+            }
+            break;
+         case 'D':
+            if ((depth = atoi(optarg)) < 1)
+            {
+               show_usage(argv[0]);
+               return 1;
+            }
+            break;
+         case 'p':
+            pretty = true;
+            break;
+         case 'o':
+            dir = optarg;
+            break;
+         default:
+            show_usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+      }
+   }
+
+   if (dir)
+      return generate_corpus(dir, seed, size, depth) ? 0 : 1;
+
+   if (optind + 1 != argc)
+   {
+      show_usage(argv[0]);
+      return 1;
+   }
+
+   for (int shape = 0; shape < SHAPE_COUNT; ++shape)
+   {
+      if (strcmp(argv[optind], shape_names[shape]) == 0)
+      {
+         generate(stdout, (Shape)shape, seed, size, pretty, depth);
+         return fflush(stdout) == 0 ? 0 : 1;
+      }
+   }
+
+   show_usage(argv[0]);
+   return 1;
+}
@@ -1,8 +1,8 @@
 #include <stdbool.h>
 #include <ctype.h>    // for isdigit()
-#include <stddef.h>   // for NULL
+#include <stddef.h>   // for NULL, size_t
 
-bool isJsonNumber(const char *str, bool *isFloatReturn)
+bool isJsonNumber(const char *str, size_t len, bool *isFloatReturn)
 {
    bool retval = false;
 
@@ -12,13 +12,14 @@ bool isJsonNumber(const char *str, bool *isFloatReturn)
    bool is_exponent = false;
 
    const char *ptr = str;
+   const char *end = str + len;
    const char *first_numeral = NULL;
 
    // Leading minus sign is permitted and skipped if found:
-   if (*ptr == '-')
+   if (ptr < end && *ptr == '-')
       ++ptr;
 
-   while (*ptr)
+   while (ptr < end)
    {
       // RFC 8259 doesn't allow hex numbers, and we also
       // won't try to parse octal or binary prefixes
@@ -32,7 +33,7 @@ bool isJsonNumber(const char *str, bool *isFloatReturn)
       else if (*ptr == '.')
       {
          // .123, -.123, and 23. are invalid
-         if ( ptr==str || !isdigit(*(ptr-1)) || !isdigit(*(ptr+1)))
+         if ( ptr==str || !isdigit(*(ptr-1)) || ptr+1 == end || !isdigit(*(ptr+1)))
             goto early_exit;
          // encountering a second period or a period
          // in the exponent are invalid:
@@ -52,7 +53,7 @@ bool isJsonNumber(const char *str, bool *isFloatReturn)
             goto early_exit;
 
          // Next char can be a sign:
-         if (*(ptr+1) == '-' || *(ptr+1) == '+')
+         if (ptr+1 < end && (*(ptr+1) == '-' || *(ptr+1) == '+'))
             ++ptr;
 
          is_exponent = is_float= true;
@@ -72,7 +73,7 @@ bool isJsonNumber(const char *str, bool *isFloatReturn)
    // It's only a number if several factors line up:
    retval = has_numerals &&
       (*first_numeral != '0'             // leading 0 is invalid UNLESS
-       || *(first_numeral+1)=='\0'       // it's also the last numeral
+       || first_numeral+1 == end         // it's also the last numeral
        || is_exponent                    // coefficient of 0 OK (ie 0e0 is valid)
        || has_decimal);                  // leading 0 ok for mixed number (ie 0.1234)
 
@@ -2,7 +2,8 @@
 #define ISJSONNUMBER_H
 
 #include <stdbool.h>
+#include <stddef.h>
 
-bool isJsonNumber(const char *str, bool *isFloat);
+bool isJsonNumber(const char *str, size_t len, bool *isFloat);
 
 #endif
@@ -3,9 +3,13 @@
 #include <stdlib.h>   // malloc/free
 #include <string.h>   // memset
 #include <stdio.h>    // printf
+#include <stdint.h>   // intptr_t
 #include <assert.h>
 
 #include "jd_Node.h"
+#include "JEscape.h"
+#include "JPool.h"
+#include "JAlloc.h"
 
 /**
  * @brief Array of type names aligned to #JDataType enumeration.
@@ -31,11 +35,17 @@ const char* jd_Node_TypeLabels[] = {
  * children of @b node will be left intact.
  *
  * @param node Pointer to jd_Node instance to be removed from its family.
+ * @return True for success, false if @b node belongs to a frozen tree
  */
-void jd_Node_emancipate(jd_Node *node)
+bool jd_Node_emancipate(jd_Node *node)
 {
+   if (node->flags & JDN_FROZEN)
+      return false;
+
    if (node->parent)
    {
+      jd_Node_mark_dirty(node->parent);
+
       // Remove/replace parent direct links to node
       if (node->parent->firstChild == node)
          node->parent->firstChild = node->nextSibling;
@@ -52,6 +62,8 @@ void jd_Node_emancipate(jd_Node *node)
       // then remove node's links to siblings
       node->nextSibling = node->prevSibling = NULL;
    }
+
+   return true;
 }
 
 /**
@@ -68,17 +80,22 @@ void jd_Node_emancipate(jd_Node *node)
  * @param parent    The jd_Node instance to use as the parent of @b adoptee
  * @param before    Optional jd_Node instance of a child of @b parent
  *                  after which @b adoptee will be placed
+ * @return True for success, false if either node belongs to a frozen tree
  */
-void jd_Node_adopt(jd_Node *adoptee, jd_Node *parent, jd_Node *before)
+bool jd_Node_adopt(jd_Node *adoptee, jd_Node *parent, jd_Node *before)
 {
    assert(parent && adoptee);
 
+   if ((adoptee->flags | parent->flags) & JDN_FROZEN)
+      return false;
+
    // Previous family connections should have been severed:
    assert(adoptee->parent==NULL);
    assert(adoptee->prevSibling==NULL);
    assert(adoptee->nextSibling==NULL);
 
    adoptee->parent = parent;
+   jd_Node_mark_dirty(parent);
 
    // Adjust all the links If inserting within children:
    if (before)
@@ -109,6 +126,8 @@ void jd_Node_adopt(jd_Node *adoptee, jd_Node *parent, jd_Node *before)
       else
          parent->firstChild = parent->lastChild = adoptee;
    }
+
+   return true;
 }
 
 
@@ -116,31 +135,39 @@ void jd_Node_adopt(jd_Node *adoptee, jd_Node *parent, jd_Node *before)
  * @brief
  *    Returns a new jd_Node instance of type JD_NULL.
  * @details
- *    Uses @c malloc to create a new jd_Node instance, using
+ *    Uses #pool_node_alloc to create a new jd_Node instance, using
  *    #jd_Node_adopt to incorporate the new node into an existing
  *    family of nodes.
  *
- * @param new_node  Address of pointer to which the new jd_Node
- *                  instance will be copied
- * @param parent    The jd_Node instance to use as the parent of @b new_node
- * @param before    Optional jd_Node instance of a child of @b parent
- *                  after which @b new_node will be placed
+ * @param new_node   Address of pointer to which the new jd_Node
+ *                   instance will be copied
+ * @param parent     The jd_Node instance to use as the parent of @b new_node
+ * @param before     Optional jd_Node instance of a child of @b parent
+ *                   after which @b new_node will be placed
+ * @param allocator  source of the node's memory, that of the tree
+ *                   it will join, or NULL for the default
  *
  * @return
  *    True if successful
- *    False if failed to get needed memory
+ *    False if failed to get needed memory, or if @b parent is frozen
  */
-bool jd_Node_create(jd_Node **new_node, jd_Node *parent, jd_Node *before)
+bool jd_Node_create(jd_Node            **new_node,
+                    jd_Node            *parent,
+                    jd_Node            *before,
+                    const jd_Allocator *allocator)
 {
-   jd_Node *node = (jd_Node*)malloc(sizeof(jd_Node));
+   jd_Node *node = pool_node_alloc(allocator);
    if (node)
    {
       memset(node, 0, sizeof(jd_Node));
       node->type = JD_NULL;
 
       // Adjust family relationships
-      if (parent)
-         jd_Node_adopt(node, parent, before);
+      if (parent && !jd_Node_adopt(node, parent, before))
+      {
+         pool_node_free(node, allocator);
+         return false;
+      }
 
       *new_node = node;
       return true;
@@ -149,38 +176,92 @@ bool jd_Node_create(jd_Node **new_node, jd_Node *parent, jd_Node *before)
    return false;
 }
 
+/**
+ * @brief Free a payload according to where it came from.
+ */
+static inline void free_payload(jd_Node *node)
+{
+   if (node->payload && !(node->flags & JDN_BORROWED))
+   {
+      if (node->flags & JDN_POOLED)
+         pool_free(node->payload);
+      else
+         free(node->payload);
+   }
+}
+
 /**
  * @brief
  *    Deletes jd_Node instance @b node after deleting everything
  *    to which it points.
  * @details
- *    Recursively deletes children, then siblings of @b node, then
- *    uses @c free to delete its payload (if appropriate) and finally,
- *    itself.
+ *    Deletes children and following siblings of @b node, their
+ *    payloads (if appropriate), and finally, itself.
+ *
+ *    Rather than recursing, each node's children are spliced into
+ *    the chain of siblings ahead of its next sibling, so wide and
+ *    deep trees are destroyed in constant stack space.
  *
- * @param node   Instance to be deleted after its pointers are freed.
+ *    A frozen tree is a single block of memory, or a mapped
+ *    snapshot, which is freed whole when its root is destroyed.
+ *    Other nodes of a frozen tree cannot be destroyed
+ *    individually.
+ *
+ * @param node       Instance to be deleted after its pointers are freed.
+ * @param allocator  source of the nodes' memory, given when they
+ *                   were created; the root of a document uses the
+ *                   document's own
  *
  * @warning
  *    Use with care: jd_Node_destroy clears the jd_Node pointer in the
  *    calling function.  Avoid attempting to free the memory twice.
  */
-void jd_Node_destroy(jd_Node **node)
+void jd_Node_destroy(jd_Node **node, const jd_Allocator *allocator)
 {
-   if (*node)
+   jd_Node *cur = *node;
+   if (cur && (cur->flags & JDN_DOCUMENT))
+      allocator = ((jd_Document*)cur)->allocator;
+
+   if (cur && (cur->flags & JDN_FROZEN))
    {
-      // The child will destroy siblings, so we won't have to:
-      if ((*node)->firstChild)
-         jd_Node_destroy(&(*node)->firstChild);
+      if (cur->flags & JDN_DOCUMENT)
+      {
+         // A snapshot is released with its mapping, other frozen trees are one block:
+         jd_Document *doc = (jd_Document*)cur;
+         if (doc->release)
+            (*doc->release)(doc->source, doc->source_len);
+         else
+            mem_free(allocator, doc);
+         *node = NULL;
+      }
+      return;
+   }
 
-      if ((*node)->nextSibling)
-         jd_Node_destroy(&(*node)->nextSibling);
+   while (cur)
+   {
+      if (cur->firstChild)
+      {
+         cur->lastChild->nextSibling = cur->nextSibling;
+         cur->nextSibling = cur->firstChild;
+      }
 
-      if ((*node)->payload)
-         free((void*)(*node)->payload);
+      jd_Node *next = cur->nextSibling;
+      free_payload(cur);
 
-      free(*node);
-      *node = NULL;
+      if (cur->flags & JDN_DOCUMENT)
+      {
+         jd_Document *doc = (jd_Document*)cur;
+         if (doc->release)
+            (*doc->release)(doc->source, doc->source_len);
+         mem_free(allocator, doc);
+      }
+      else
+         pool_node_free(cur, allocator);
+
+      cur = next;
    }
+
+   *node = NULL;
 }
 
 /**
@@ -188,15 +269,190 @@ void jd_Node_destroy(jd_Node **node)
  */
 bool jd_Node_discard_payload(jd_Node *node)
 {
-   if (node->payload)
+   if (node->flags & JDN_FROZEN)
+      return false;
+
+   free_payload(node);
+   node->payload = NULL;
+
+   node->flags &= ~(JDN_BORROWED | JDN_POOLED | JDN_SIZED | JDN_RAW | JDN_CLEAN | JDN_SPAN);
+   node->length = 0;
+
+   jd_Node_mark_dirty(node);
+
+   return true;
+}
+
+/**
+ * @brief Record the text of a collection in the source.
+ * @details
+ *    The span is kept in the otherwise unused payload and
+ *    length members, and is valid until the collection or
+ *    one of its descendants is changed.
+ * @param node   completely parsed JD_ARRAY or JD_OBJECT jd_Node
+ * @param start  address of the opening bracket in the source
+ * @param len    number of characters through the closing bracket
+ */
+void jd_Node_set_span(jd_Node *node, const char *start, size_t len)
+{
+   assert(node->type == JD_ARRAY || node->type == JD_OBJECT);
+   assert(node->payload == NULL);
+
+   node->payload = (void*)start;
+   node->length = len;
+   node->flags |= JDN_SPAN | JDN_BORROWED;
+   node->flags &= ~JDN_DIRTY;
+}
+
+/**
+ * @brief Tells if the source text of a collection can stand for it.
+ */
+bool jd_Node_has_clean_span(const jd_Node *node)
+{
+   return (node->flags & (JDN_SPAN | JDN_DIRTY)) == JDN_SPAN;
+}
+
+/**
+ * @brief Note that @b node has changed, invalidating its span and
+ *        those of its ancestors.
+ * @details
+ *    The parser builds each collection before attaching it to
+ *    its parent, so the climb is short while parsing.
+ */
+void jd_Node_mark_dirty(jd_Node *node)
+{
+   while (node)
+   {
+      node->flags |= JDN_DIRTY;
+      node = node->parent;
+   }
+}
+
+/**
+ * @brief Next node of the tree under @b root in document order.
+ * @details
+ *    Walks the family links, so a whole tree, a snapshot
+ *    included, can be visited without recursion or a stack.
+ *
+ * @param node  node of the tree under @b root
+ * @param root  top of the tree being walked
+ * @return The following node, or NULL after the last node under @b root
+ */
+const jd_Node *jd_Node_next_in_tree(const jd_Node *node, const jd_Node *root)
+{
+   if (node->firstChild)
+      return jd_Node_relation(node, JD_FIRST);
+
+   while (node != root && !node->nextSibling)
+      node = jd_Node_relation(node, JD_PARENT);
+
+   return node == root ? NULL : jd_Node_relation(node, JD_NEXT);
+}
+
+/**
+ * @brief Follow a link of a node, which may hold an offset.
+ * @details
+ *    A #JDN_RELATIVE node keeps the distance in bytes from
+ *    itself to each relation, zero standing for none, so a
+ *    snapshot can be used wherever it is mapped.
+ *
+ * @param node      node whose relation is wanted
+ * @param relation  link to follow
+ * @return The related node, or NULL if there is none
+ */
+jd_Node *jd_Node_relation(const jd_Node *node, jd_Relation relation)
+{
+   jd_Node *link = ((jd_Node* const*)node)[relation];
+   if (link && (node->flags & JDN_RELATIVE))
+      link = (jd_Node*)((const char*)node + (intptr_t)link);
+
+   return link;
+}
+
+/**
+ * @brief Address of a node's payload, which may be held as an offset.
+ */
+const void *jd_Node_payload(const jd_Node *node)
+{
+   const void *payload = node->payload;
+   if (payload && (node->flags & JDN_RELATIVE))
+      payload = (const char*)node + (intptr_t)payload;
+
+   return payload;
+}
+
+/**
+ * @brief Move a tree root into a new #jd_Document.
+ * @details
+ *    The root node is copied into the document and the
+ *    parent links of its children are updated, then the
+ *    original root node is freed.  The document will call
+ *    @b release on @b source when it is destroyed.
+ *
+ * @param root        address of pointer to the root node, which
+ *                    will be replaced with the document root
+ * @param source      text from which the tree was parsed
+ * @param source_len  number of characters in @b source
+ * @param release     function to free @b source, NULL if the
+ *                    caller retains ownership
+ * @param allocator   source of the memory of the tree, which the
+ *                    document will also use, or NULL for the default
+ * @return True for success, false if out of memory, in which
+ *         case @b root is unchanged
+ */
+bool jd_Document_wrap(jd_Node            **root,
+                      const char         *source,
+                      size_t             source_len,
+                      jd_Source_release  release,
+                      const jd_Allocator *allocator)
+{
+   assert(root && *root && (*root)->parent == NULL);
+
+   jd_Document *doc = (jd_Document*)mem_alloc(allocator, sizeof(jd_Document));
+   if (doc == NULL)
+      return false;
+
+   memset(doc, 0, sizeof(jd_Document));
+   doc->root = **root;
+   doc->root.flags |= JDN_DOCUMENT;
+   doc->source = source;
+   doc->source_len = source_len;
+   doc->release = release;
+   doc->refcount = 1;
+   doc->allocator = allocator;
+
+   jd_Node *child = doc->root.firstChild;
+   while (child)
    {
-      free((void*)node->payload);
-      node->payload = NULL;
+      child->parent = &doc->root;
+      child = child->nextSibling;
    }
 
+   pool_node_free(*root, allocator);
+   *root = &doc->root;
+
    return true;
 }
 
+/**
+ * @brief Allocator of the tree to which @b node belongs.
+ * @details
+ *    Found in the document at the top of the tree.  Nodes of a
+ *    tree that is not a document use the default.
+ * @return The allocator of the document, or NULL for the default
+ */
+const jd_Allocator *jd_Node_allocator(const jd_Node *node)
+{
+   const jd_Node *parent;
+   while ((parent = jd_Node_relation(node, JD_PARENT)))
+      node = parent;
+
+   if (node->flags & JDN_DOCUMENT)
+      return ((const jd_Document*)node)->allocator;
+   else
+      return NULL;
+}
+
 /**
  * @brief Safely converts an initialized jd_Node of any type to a JD_NULL jd_Node.
  * @param node   jd_Node to be converted
@@ -204,7 +460,8 @@ bool jd_Node_discard_payload(jd_Node *node)
  */
 bool jd_Node_set_null(jd_Node *node)
 {
-   jd_Node_discard_payload(node);
+   if (!jd_Node_discard_payload(node))
+      return false;
    node->type = JD_NULL;
    return true;
 }
@@ -216,7 +473,8 @@ bool jd_Node_set_null(jd_Node *node)
  */
 bool jd_Node_set_true(jd_Node *node)
 {
-   jd_Node_discard_payload(node);
+   if (!jd_Node_discard_payload(node))
+      return false;
    node->type = JD_TRUE;
    return true;
 }
@@ -228,7 +486,8 @@ bool jd_Node_set_true(jd_Node *node)
  */
 bool jd_Node_set_false(jd_Node *node)
 {
-   jd_Node_discard_payload(node);
+   if (!jd_Node_discard_payload(node))
+      return false;
    node->type = JD_FALSE;
    return true;
 }
@@ -271,31 +530,64 @@ bool jd_Node_set_float(jd_Node *node, const char *value)
  * @brief Use supplied string as node's payload.
  *
  * jd_Node_destroy will take responsibility for deleting
- * the string argument when the jd_Node is destroyed.
+ * the string argument when the jd_Node is destroyed.  The
+ * length is measured once and saved with the payload.
  */
 bool jd_Node_take_string(jd_Node *node, const char *str)
 {
-   jd_Node_discard_payload(node);
+   return jd_Node_take_sized_string(node, str, strlen(str));
+}
+
+/**
+ * @brief Use supplied string of known length as node's payload.
+ *
+ * Like #jd_Node_take_string, but the length is not measured,
+ * so strings with embedded '\0' characters are kept whole.
+ */
+bool jd_Node_take_sized_string(jd_Node *node, const char *str, size_t len)
+{
+   if (!jd_Node_discard_payload(node))
+      return false;
    node->payload = (void*)str;
+   node->length = len;
+   node->flags |= JDN_SIZED;
 
    node->type = JD_STRING;
 
    return true;
 }
 
+/**
+ * @brief Use a string from #pool_alloc as the node's payload.
+ *
+ * Like #jd_Node_take_sized_string, but the string will be
+ * released with #pool_free.
+ */
+bool jd_Node_take_pooled_string(jd_Node *node, const char *str, size_t len)
+{
+   if (!jd_Node_take_sized_string(node, str, len))
+      return false;
+   node->flags |= JDN_POOLED;
+
+   return true;
+}
+
 /**
  * @brief Allocate new payload memory into which 'str' will be copied
  */
 bool jd_Node_copy_string(jd_Node *node, const char *str)
 {
-   jd_Node_discard_payload(node);
-   int len = strlen(str);
-   char *new_payload = (char*)malloc(len+1);
+   if (!jd_Node_discard_payload(node))
+      return false;
+   size_t len = strlen(str);
+   char *new_payload = (char*)pool_alloc(len+1, jd_Node_allocator(node));
    if (new_payload)
    {
       memcpy(new_payload, str, len);
       new_payload[len] = '\0';
       node->payload = (void*)new_payload;
+      node->length = len;
+      node->flags |= JDN_POOLED | JDN_SIZED;
 
       node->type = JD_STRING;
 
@@ -305,28 +597,83 @@ bool jd_Node_copy_string(jd_Node *node, const char *str)
    return false;
 }
 
+/**
+ * @brief Use a string owned by someone else as the node's payload.
+ * @details
+ *    The string need not be NUL-terminated, so its length is
+ *    saved with it.  The string must outlive the node, usually
+ *    by being part of the source text held by a #jd_Document.
+ */
+bool jd_Node_borrow_string(jd_Node *node, const char *str, size_t len)
+{
+   if (!jd_Node_discard_payload(node))
+      return false;
+   node->payload = (void*)str;
+   node->length = len;
+   node->flags |= JDN_BORROWED | JDN_SIZED;
+
+   node->type = JD_STRING;
+
+   return true;
+}
+
+/**
+ * @brief Length in bytes of a string, integer, or float payload
+ * @details
+ *    Every payload set by the library carries its length, so
+ *    the string is measured only if it was set some other way.
+ */
+size_t jd_Node_payload_length(const jd_Node *node)
+{
+   if (node->flags & JDN_SIZED)
+      return node->length;
+   else if (node->payload)
+      return strlen((const char*)node->payload);
+   else
+      return 0;
+}
+
+/**
+ * @brief Tells if a node's payload is text: the value of a
+ *        string or number, or the label of a property.
+ */
+bool jd_Node_has_text(const jd_Node *node)
+{
+   return node->type < JD_ARRAY || node->type == JD_PROPERTY;
+}
+
 /**
  * @brief Discards all subordinate memory and values
+ * @details
+ *    The label is kept in the property node itself, whose
+ *    only child is the value.  Any children the node had are
+ *    destroyed first, so it may be made a property again.
+ * @return True for success, false if out of memory or if
+ *         @b node belongs to a frozen tree
  */
 bool jd_Node_make_null_property(jd_Node *node, const char *label)
 {
+   if (node->flags & (JDN_FROZEN | JDN_RELATIVE))
+      return false;
+
    jd_Node_discard_payload(node);
+   const jd_Allocator *allocator = jd_Node_allocator(node);
    if (node->firstChild)
-      jd_Node_destroy(&(node->firstChild));
+   {
+      // Destroying the first child takes its following siblings too:
+      jd_Node_destroy(&(node->firstChild), allocator);
+      node->firstChild = node->lastChild = NULL;
+   }
+
+   if (!jd_Node_copy_string(node, label))
+      return false;
    node->type = JD_PROPERTY;
 
-   jd_Node *label_node, *value_node;
-   if (jd_Node_create(&label_node, node, NULL))
+   jd_Node *value_node;
+   if (jd_Node_create(&value_node, node, NULL, allocator))
    {
-      if (jd_Node_create(&value_node, node, NULL))
-      {
-         jd_Node_copy_string(label_node, label);
-         jd_Node_set_null(value_node);
-
-         return true;
-      }
-      else
-         jd_Node_destroy(&(node->firstChild));
+      jd_Node_set_null(value_node);
+      return true;
    }
 
    return false;
@@ -339,7 +686,8 @@ bool jd_Node_make_null_property(jd_Node *node, const char *label)
  */
 bool jd_Node_make_array(jd_Node *node)
 {
-   jd_Node_discard_payload(node);
+   if (!jd_Node_discard_payload(node))
+      return false;
    node->type = JD_ARRAY;
 
    return true;
@@ -355,8 +703,7 @@ bool jd_Node_make_array(jd_Node *node)
 bool jd_Node_array_insert_element(jd_Node *array, jd_Node *new_element, jd_Node *element_before)
 {
    assert(array->type == JD_ARRAY);
-   jd_Node_adopt(new_element, array, element_before);
-   return true;
+   return jd_Node_adopt(new_element, array, element_before);
 }
 
 /**
@@ -366,7 +713,8 @@ bool jd_Node_array_insert_element(jd_Node *array, jd_Node *new_element, jd_Node
  */
 bool jd_Node_make_object(jd_Node *node)
 {
-   jd_Node_discard_payload(node);
+   if (!jd_Node_discard_payload(node))
+      return false;
    node->type = JD_OBJECT;
 
    return true;
@@ -432,6 +780,37 @@ void jd_Node_print_false(const jd_Node *node, int indent)
       printf("\n%*cfalse", indent, ' ');
 }
 
+/**
+ * @brief Print a string payload in double-quotes, escaped as required.
+ * @param node   JD_STRING jd_Node to be printed
+ */
+void jd_Node_print_json_string(const jd_Node *node)
+{
+   const char *str = (const char*)node->payload;
+   size_t len = jd_Node_payload_length(node);
+
+   putchar('"');
+   if (node->flags & (JDN_RAW | JDN_CLEAN))
+      fwrite(str, 1, len, stdout);
+   else
+   {
+      size_t escaped_len = json_escaped_length(str, len);
+      if (escaped_len == len)
+         fwrite(str, 1, len, stdout);
+      else
+      {
+         char *escaped = (char*)malloc(escaped_len);
+         if (escaped)
+         {
+            json_escape(escaped, str, len);
+            fwrite(escaped, 1, escaped_len, stdout);
+            free(escaped);
+         }
+      }
+   }
+   putchar('"');
+}
+
 /**
  * @brief JD_STRING jd_Node printing function for jNode_printers array
  * @param node   jd_Node to be printed
@@ -440,10 +819,9 @@ void jd_Node_print_false(const jd_Node *node, int indent)
 void jd_Node_print_string(const jd_Node *node, int indent)
 {
    assert(node && node->type==JD_STRING);
-   if (indent<0)
-      printf("\"%s\"", (char*)node->payload);
-   else
-      printf("\n%*c\"%s\"", indent, ' ', (char*)node->payload);
+   if (indent>=0)
+      printf("\n%*c", indent, ' ');
+   jd_Node_print_json_string(node);
 }
 
 /**
@@ -454,10 +832,11 @@ void jd_Node_print_string(const jd_Node *node, int indent)
 void jd_Node_print_integer(const jd_Node *node, int indent)
 {
    assert(node && node->type==JD_INTEGER);
+   int len = (int)jd_Node_payload_length(node);
    if (indent<0)
-      printf("%s", (char*)node->payload);
+      printf("%.*s", len, (char*)node->payload);
    else
-      printf("\n%*c%s", indent, ' ', (char*)node->payload);
+      printf("\n%*c%.*s", indent, ' ', len, (char*)node->payload);
 }
 
 /**
@@ -468,10 +847,11 @@ void jd_Node_print_integer(const jd_Node *node, int indent)
 void jd_Node_print_float(const jd_Node *node, int indent)
 {
    assert(node && node->type==JD_FLOAT);
+   int len = (int)jd_Node_payload_length(node);
    if (indent<0)
-      printf("%s", (char*)node->payload);
+      printf("%.*s", len, (char*)node->payload);
    else
-      printf("\n%*c%s", indent, ' ', (char*)node->payload);
+      printf("\n%*c%.*s", indent, ' ', len, (char*)node->payload);
 }
 
 /**
@@ -517,21 +897,22 @@ void jd_Node_print_array(const jd_Node *node, int indent)
 void jd_Node_print_property(const jd_Node *node, int indent)
 {
    assert(node && node->type==JD_PROPERTY);
-   assert(node->firstChild && node->firstChild->type == JD_STRING);
-   assert(node->firstChild->nextSibling == node->lastChild);
+   assert(node->firstChild && node->firstChild == node->lastChild);
 
-   const char *label = (char*)node->firstChild->payload;
    jd_Node *value = node->lastChild;
    bool is_collection = value->type >= JD_ARRAY;
 
    if (indent < 0)
    {
-      printf("\"%s\":",  label);
+      jd_Node_print_json_string(node);
+      putchar(':');
       (*jNode_printers[value->type])(value, indent);
    }
    else
    {
-      printf("\n%*c\"%s\":", indent, ' ', label);
+      printf("\n%*c", indent, ' ');
+      jd_Node_print_json_string(node);
+      putchar(':');
       if (is_collection)
          indent += 4;
       else
@@ -589,12 +970,12 @@ void jd_Node_serialize(const jd_Node *node, int indent)
 void populate_simple_array(jd_Node *parent)
 {
    jd_Node *child;
-   jd_Node_create(&child, parent, NULL);
-   jd_Node_create(&child, parent, NULL);
+   jd_Node_create(&child, parent, NULL, NULL);
+   jd_Node_create(&child, parent, NULL, NULL);
    jd_Node_set_true(child);
-   jd_Node_create(&child, parent, NULL);
+   jd_Node_create(&child, parent, NULL, NULL);
    jd_Node_set_false(child);
-   jd_Node_create(&child, parent, NULL);
+   jd_Node_create(&child, parent, NULL, NULL);
    jd_Node_copy_string(child, "This is a string");
 }
 
@@ -602,27 +983,27 @@ void populate_simple_object(jd_Node *parent)
 {
    jd_Node *child;
 
-   jd_Node_create(&child, parent, NULL);
+   jd_Node_create(&child, parent, NULL, NULL);
    jd_Node_make_null_property(child, "one_array");
    populate_simple_array(child->lastChild);
 
-   jd_Node_create(&child, parent, NULL);
+   jd_Node_create(&child, parent, NULL, NULL);
    jd_Node_make_null_property(child, "two_true");
    jd_Node_set_true(child->lastChild);
 
-   jd_Node_create(&child, parent, NULL);
+   jd_Node_create(&child, parent, NULL, NULL);
    jd_Node_make_null_property(child, "three_false");
    jd_Node_set_false(child->lastChild);
 
-   jd_Node_create(&child, parent, NULL);
+   jd_Node_create(&child, parent, NULL, NULL);
    jd_Node_make_null_property(child, "four_string");
    jd_Node_copy_string(child->lastChild, "String value");
 
-   jd_Node_create(&child, parent, NULL);
+   jd_Node_create(&child, parent, NULL, NULL);
    jd_Node_make_null_property(child, "five_integer");
    jd_Node_set_integer(child->lastChild, "1000");
 
-   jd_Node_create(&child, parent, NULL);
+   jd_Node_create(&child, parent, NULL, NULL);
    jd_Node_make_null_property(child, "six_float");
    jd_Node_set_float(child->lastChild, "3.141592653589");
 }
@@ -630,29 +1011,29 @@ void populate_simple_object(jd_Node *parent)
 void test_array_of_arrays(void)
 {
    jd_Node *root;
-   if (jd_Node_create(&root, NULL, NULL))
+   if (jd_Node_create(&root, NULL, NULL, NULL))
    {
       jd_Node_make_array(root);
 
       jd_Node *array;
-      jd_Node_create(&array, root, NULL);
+      jd_Node_create(&array, root, NULL, NULL);
       jd_Node_make_array(array);
       populate_simple_array(array);
 
-      jd_Node_create(&array, root, NULL);
+      jd_Node_create(&array, root, NULL, NULL);
       jd_Node_make_array(array);
       populate_simple_array(array);
 
-      jd_Node_create(&array, root, NULL);
+      jd_Node_create(&array, root, NULL, NULL);
       jd_Node_make_object(array);
       populate_simple_object(array);
 
-      jd_Node_create(&array, root, NULL);
+      jd_Node_create(&array, root, NULL, NULL);
       jd_Node_make_array(array);
       populate_simple_array(array);
 
       jd_Node_serialize(root, 0);
-      jd_Node_destroy(&root);
+      jd_Node_destroy(&root, NULL);
    }
 }
 
@@ -32,9 +32,66 @@ typedef enum jd_NodeError_e {
 } jd_NodeError;
 
 /**
- * @brief Global variable defined in Stringify.c
+ * @brief Bits for jd_Node::flags
  */
-extern jd_NodeError jn_error;
+typedef enum jd_NodeFlag_e {
+   JDN_DOCUMENT = 1 << 0,    ///< node is the root member of a #jd_Document
+   JDN_BORROWED = 1 << 1,    ///< payload belongs to someone else, do not free it
+   JDN_SIZED    = 1 << 2,    ///< jd_Node::length holds the payload length
+   JDN_RAW      = 1 << 3,    ///< string payload includes undecoded escape sequences
+   JDN_CLEAN    = 1 << 4,    ///< string payload has no characters that need escaping
+   JDN_SPAN     = 1 << 5,    ///< collection payload and length give its text in the source
+   JDN_DIRTY    = 1 << 6,    ///< node or a descendant changed since its span was recorded
+   JDN_POOLED   = 1 << 7,    ///< payload came from pool_alloc and goes back with pool_free
+   JDN_FROZEN   = 1 << 8,    ///< node belongs to an immutable tree made by jd_freeze
+   JDN_INDEXED  = 1 << 9,    ///< object payload is a #jd_Index of its properties
+   JDN_RELATIVE = 1 << 10    /**< links, payload and index entries are byte offsets
+                              *   from the node or index holding them, see jd_Node_relation
+                              */
+} jd_NodeFlag;
+
+/** Function that releases a document source when the document is destroyed */
+typedef void (*jd_Source_release)(const char *source, size_t len);
+
+/**
+ * @brief Root node with resources shared by the whole tree.
+ * @details
+ *    A document is created when the tree refers to memory it
+ *    does not own, like string payloads left in the source
+ *    text, or when its memory comes from a #jd_Allocator.  The
+ *    root member must be first so the address of the document
+ *    is also the address of the root node.
+ */
+typedef struct jd_Document_s {
+   jd_Node            root;        ///< root node of the tree
+   const char         *source;     ///< text from which the tree was parsed
+   size_t             source_len;  ///< number of characters in #source
+   jd_Source_release  release;     ///< frees #source, NULL if not owned
+   unsigned long      refcount;    ///< holders of the document, changed atomically
+   const jd_Allocator *allocator;  ///< source of the document's memory, NULL for @c malloc
+} jd_Document;
+
+/**
+ * @brief Hash table of the properties of a frozen object.
+ * @details
+ *    Properties are placed by the hash of their labels, with
+ *    linear probing.  The table is at most half full, so
+ *    every search ends at an empty slot.
+ */
+typedef struct jd_Index_s {
+   size_t  mask;            ///< number of slots less one, slots being a power of two
+   jd_Node *slots[];        ///< properties, NULL where a slot is empty
+} jd_Index;
+
+/**
+ * @brief Context used when NULL is given for a context, defined in jsondom.c
+ */
+extern jd_Context jd_default_context;
+
+/**
+ * @brief Stringify result of the default context, once a global variable
+ */
+#define jn_error (jd_default_context.node_error)
 
 /** typedef */
 /** typedef for destructor function pointer array */
@@ -58,11 +115,44 @@ typedef void (*jd_Node_printer)(const jd_Node *node, int indent);
  *    Functions that create and destroy jd_Node instances.
  * @{
  */
-void jd_Node_emancipate(jd_Node *node);
-void jd_Node_adopt(jd_Node *adoptee, jd_Node *parent, jd_Node *before);
-bool jd_Node_create(jd_Node **new_node, jd_Node *parent, jd_Node *before);
-void jd_Node_destroy(jd_Node **node);
+bool jd_Node_emancipate(jd_Node *node);
+bool jd_Node_adopt(jd_Node *adoptee, jd_Node *parent, jd_Node *before);
+bool jd_Node_create(jd_Node **new_node,
+                    jd_Node *parent,
+                    jd_Node *before,
+                    const jd_Allocator *allocator);
+void jd_Node_destroy(jd_Node **node, const jd_Allocator *allocator);
 bool jd_Node_discard_payload(jd_Node *node);
+bool jd_Document_wrap(jd_Node **root,
+                      const char *source,
+                      size_t source_len,
+                      jd_Source_release release,
+                      const jd_Allocator *allocator);
+const jd_Allocator *jd_Node_allocator(const jd_Node *node);
+const jd_Node *jd_Node_next_in_tree(const jd_Node *node, const jd_Node *root);
+/** @} */
+
+/**
+ * @ingroup AllFunctions
+ * @defgroup Relative Functions that follow links of any kind of node
+ * @brief
+ *    Nodes of a snapshot hold offsets instead of addresses, so
+ *    code that may be given one reads its links and payload
+ *    through these functions.
+ * @{
+ */
+jd_Node *jd_Node_relation(const jd_Node *node, jd_Relation relation);
+const void *jd_Node_payload(const jd_Node *node);
+/** @} */
+
+/**
+ * @ingroup AllFunctions
+ * @defgroup SourceSpans Functions that track collection text in the source
+ * @{
+ */
+void jd_Node_set_span(jd_Node *node, const char *start, size_t len);
+bool jd_Node_has_clean_span(const jd_Node *node);
+void jd_Node_mark_dirty(jd_Node *node);
 /** @} */
 
 /**
@@ -87,6 +177,11 @@ bool jd_Node_make_object(jd_Node *node);
  */
 bool jd_Node_take_string(jd_Node *node, const char *str);
 bool jd_Node_copy_string(jd_Node *node, const char *str);
+bool jd_Node_take_sized_string(jd_Node *node, const char *str, size_t len);
+bool jd_Node_take_pooled_string(jd_Node *node, const char *str, size_t len);
+bool jd_Node_borrow_string(jd_Node *node, const char *str, size_t len);
+size_t jd_Node_payload_length(const jd_Node *node);
+bool jd_Node_has_text(const jd_Node *node);
 /** @} */
 
 
@@ -117,15 +212,16 @@ void jd_Node_print_float(const jd_Node *node, int indent);
 void jd_Node_print_array(const jd_Node *node, int indent);
 void jd_Node_print_property(const jd_Node *node, int indent);
 void jd_Node_print_object(const jd_Node *node, int indent);
+void jd_Node_print_json_string(const jd_Node *node);
 /** @} */
 
-int jd_Node_stringify_null(const jd_Node *node, char *buffer, int bufflen);
-int jd_Node_stringify_true(const jd_Node *node, char *buffer, int bufflen);
-int jd_Node_stringify_false(const jd_Node *node, char *buffer, int bufflen);
-int jd_Node_stringify_string(const jd_Node *node, char *buffer, int bufflen);
-int jd_Node_stringify_integer(const jd_Node *node, char *buffer, int bufflen);
-int jd_Node_stringify_float(const jd_Node *node, char *buffer, int bufflen);
-int jd_Node_stringify_property(const jd_Node *node, char *buffer, int bufflen);
+int jd_Node_stringify_null(jd_Context *ctx, const jd_Node *node, char *buffer, int bufflen);
+int jd_Node_stringify_true(jd_Context *ctx, const jd_Node *node, char *buffer, int bufflen);
+int jd_Node_stringify_false(jd_Context *ctx, const jd_Node *node, char *buffer, int bufflen);
+int jd_Node_stringify_string(jd_Context *ctx, const jd_Node *node, char *buffer, int bufflen);
+int jd_Node_stringify_integer(jd_Context *ctx, const jd_Node *node, char *buffer, int bufflen);
+int jd_Node_stringify_float(jd_Context *ctx, const jd_Node *node, char *buffer, int bufflen);
+int jd_Node_stringify_property(jd_Context *ctx, const jd_Node *node, char *buffer, int bufflen);
 
 /**
  * @ingroup AllFunctions
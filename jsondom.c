@@ -1,12 +1,36 @@
 /** @file jsondom.c */
 
+/** Enable usage of mmap and fstat: */
+#define _POSIX_C_SOURCE 200809L
+
 #include "JParser.h"
+#include "JSerialize.h"
+#include "JPool.h"
+#include "JFreeze.h"
+#include "JBinary.h"
+#include "JSnapshot.h"
+#include "JCache.h"
+#include "JStats.h"
+#include "JMemory.h"
+#include "JCompact.h"
 #include "jsondom.h"
-#include <string.h>  // for strlen
+#include <string.h>    // for strlen, memset
+#include <stdlib.h>    // for free
+#include <sys/mman.h>  // for mmap/munmap
+#include <sys/stat.h>  // for fstat
+#include <fcntl.h>     // for open
+#include <unistd.h>    // for read
+#include <errno.h>     // for EINTR
 #include <assert.h>
 
 #define EXPORT __attribute((visibility("default")))
 
+/** Spaces per level of nesting written by jd_serialize */
+#define JD_SERIALIZE_INDENT 4
+
+/** Settings used when serializing functions are given NULL options */
+const jd_SerializeOptions default_serialize_options = { JD_SERIALIZE_INDENT, false };
+
 /**
  * @brief Array of names for jd_id_type
  */
@@ -23,26 +47,106 @@ const char *TypeNames[] = {
 };
 
 /**
- * @brief Parse the file into new_tree.
- * @param fh        handle to an open file
+ * @brief Context used by functions that are given a NULL context.
+ * @details
+ *    Holds the settings that were once global: errors are
+ *    reported by #Standard_Report_Error, and stringify results
+ *    are kept where #jn_error finds them.
+ */
+jd_Context jd_default_context = {
+   JD_PARSE_DEFAULT,
+   Standard_Report_Error,
+   NULL,
+   { 0, NULL },
+   NULL,
+   NULL,
+   JNE_SUCCESS
+};
+
+/**
+ * @brief Bit set in the address of a property to stand for its label.
+ * @details
+ *    A property keeps its label as its own text, with its value as
+ *    its only child.  Callers still find the label where it always
+ *    was, as a #JD_STRING first child followed by the value: for it
+ *    jd_get_relation gives the address of the property with this
+ *    bit set, which the public functions read as a string node.
+ *    Nodes are at least pointer-aligned, so the bit is otherwise
+ *    clear.
+ */
+#define LABEL_TAG ((uintptr_t)1)
+
+/**
+ * @brief Tells if @b node stands for the label of a property.
+ */
+bool is_label(const jd_Node *node)
+{
+   return ((uintptr_t)node & LABEL_TAG) != 0;
+}
+
+/**
+ * @brief The label of a property, as jd_get_relation gives it.
+ */
+jd_Node *label_of(const jd_Node *property)
+{
+   return (jd_Node*)((uintptr_t)property | LABEL_TAG);
+}
+
+/**
+ * @brief The property whose label @b label stands for.
+ */
+const jd_Node *label_property(const jd_Node *label)
+{
+   return (const jd_Node*)((uintptr_t)label & ~LABEL_TAG);
+}
+
+/**
+ * @brief Get a node that can be read in place of @b node.
+ * @details
+ *    A label is read through @b scratch, made a string node
+ *    that borrows the label text of its property.  Any other
+ *    node is read as it is.
+ *
+ * @param node     node or label to be read
+ * @param scratch  memory for the stand-in of a label
+ * @return @b node, or @b scratch standing in for a label
+ */
+const jd_Node *readable_node(const jd_Node *node, jd_Node *scratch)
+{
+   if (!is_label(node))
+      return node;
+
+   const jd_Node *property = label_property(node);
+   memset(scratch, 0, sizeof(jd_Node));
+   scratch->type = JD_STRING;
+   scratch->flags = JDN_BORROWED | JDN_SIZED | (property->flags & (JDN_RAW | JDN_CLEAN));
+   scratch->payload = (void*)jd_Node_payload(property);
+   scratch->length = jd_Node_payload_length(property);
+   return scratch;
+}
+
+/**
+ * @brief Parse a complete document from an initialized reader.
+ * @param jr        reader positioned at the start of a document
  * @param new_tree  address of pointer to which the result will be written
+ * @param pe        pointer to parsing error structure
  * @return True for success, false for failure
  */
-EXPORT bool jd_parse_file(int fh, jd_Node **new_tree, jd_ParseError *pe)
+bool parse_document(JReader *jr, jd_Node **new_tree, jd_ParseError *pe)
 {
    *new_tree = NULL;
 
    jd_Node *node = NULL;
-   bool retval = JParser(fh, NULL, &node, 0, NULL, pe);
+   bool retval = JParser(jr, NULL, &node, 0, NULL, pe);
    if (retval)
    {
-      if (confirm_no_further_file_content(fh))
+      if (confirm_no_further_file_content(jr))
          *new_tree = (jd_Node*)node;
       else
       {
-         report_parse_error(pe, fh,
+         report_parse_error(pe, jr,
                             "forbidden characters following singleton root object");
-         jd_Node_destroy(&node);
+         jd_Node_destroy(&node, jr->allocator);
          retval = false;
       }
    }
@@ -50,17 +154,767 @@ EXPORT bool jd_parse_file(int fh, jd_Node **new_tree, jd_ParseError *pe)
    return retval;
 }
 
+/**
+ * @brief Reset @b pe to report no error.
+ * @details
+ *    Errors found outside of JSON text set only
+ *    jd_ParseError::char_loc and jd_ParseError::message, leaving
+ *    jd_ParseError::line at 0.
+ */
+void clear_parse_error(jd_ParseError *pe)
+{
+   memset(pe, 0, sizeof(jd_ParseError));
+}
+
+/**
+ * @brief Put a parsed tree into a #jd_Document.
+ * @details
+ *    On failure the tree is destroyed and the error recorded.
+ * @param new_tree   address of pointer to the root of the tree
+ * @param source     text the document will keep, or NULL
+ * @param len        number of characters in @b source
+ * @param release    function to free @b source, or NULL
+ * @param allocator  source of the tree's memory, or NULL
+ * @param pe         pointer to parsing error structure
+ * @return True for success, false if out of memory
+ */
+bool wrap_parsed_tree(jd_Node            **new_tree,
+                      const char         *source,
+                      size_t             len,
+                      jd_Source_release  release,
+                      const jd_Allocator *allocator,
+                      jd_ParseError      *pe)
+{
+   if (jd_Document_wrap(new_tree, source, len, release, allocator))
+      return true;
+
+   jd_Node_destroy(new_tree, allocator);
+   pe->char_loc = 0;
+   pe->message = "out of memory";
+   return false;
+}
+
+/**
+ * @brief Parse a file by reading it through a buffer.
+ * @param fh         handle to an open file
+ * @param options    #jd_ParseOption flags
+ * @param allocator  source of the memory of the tree, or NULL
+ * @param new_tree   address of pointer to which the result will be written
+ * @param pe         pointer to parsing error structure
+ * @param stats      structure to fill in with statistics, or NULL
+ * @return True for success, false for failure
+ */
+bool parse_file(int                fh,
+                unsigned int       options,
+                const jd_Allocator *allocator,
+                jd_Node            **new_tree,
+                jd_ParseError      *pe,
+                jd_ParseStats      *stats)
+{
+   clear_parse_error(pe);
+   *new_tree = NULL;
+
+   JReader jr;
+   if (!JReaderInitFile(&jr, fh, options, allocator))
+   {
+      pe->char_loc = 0;
+      pe->message = "out of memory";
+      return false;
+   }
+
+   JStatsRun run;
+   stats_start(&run, stats, &jr);
+
+   bool retval = parse_document(&jr, new_tree, pe);
+
+   stats_built(&run);
+   if (retval && allocator)
+      retval = wrap_parsed_tree(new_tree, NULL, 0, NULL, allocator, pe);
+
+   stats_end(&run, &jr, *new_tree);
+
+   JReaderDestroy(&jr);
+
+   return retval;
+}
+
+/**
+ * @brief Parse the file into new_tree.
+ * @param fh        handle to an open file
+ * @param new_tree  address of pointer to which the result will be written
+ * @param pe        pointer to parsing error structure
+ * @return True for success, false for failure
+ */
+EXPORT bool jd_parse_file(int fh, jd_Node **new_tree, jd_ParseError *pe)
+{
+   return parse_file(fh, JD_PARSE_DEFAULT, NULL, new_tree, pe, NULL);
+}
+
+/** Implementation of #jd_Source_release for JD_PARSE_TAKE_BUFFER */
+void release_malloced_source(const char *source, size_t len)
+{
+   free((void*)source);
+}
+
+/** Implementation of #jd_Source_release for a block from #pool_alloc */
+void release_pooled_source(const char *source, size_t len)
+{
+   pool_free((void*)source);
+}
+
+/** Implementation of #jd_Source_release for jd_parse_mapped */
+void release_mapped_source(const char *source, size_t len)
+{
+   munmap((void*)source, len);
+}
+
+/**
+ * @brief Parse a document held in memory
+ * @details
+ *    Conclude a successful zero-copy or span-keeping parse by
+ *    putting the tree into a #jd_Document that keeps the source
+ *    for the tree's lifetime.  Otherwise, release the source
+ *    immediately, though a tree built from an allocator still
+ *    becomes a document to remember it.
+ *
+ *    If @b release is not NULL, the source will be released
+ *    whether or not the parse succeeds.
+ *
+ * @param source     JSON document text
+ * @param len        number of characters in @b source
+ * @param options    #jd_ParseOption flags
+ * @param allocator  source of the memory of the tree, or NULL
+ * @param release    function to free @b source, or NULL
+ * @param new_tree   address of pointer to which the result will be written
+ * @param pe         pointer to parsing error structure
+ * @param stats      structure to fill in with statistics, or NULL
+ * @return True for success, false for failure
+ */
+bool parse_source(const char         *source,
+                  size_t             len,
+                  unsigned int       options,
+                  const jd_Allocator *allocator,
+                  jd_Source_release  release,
+                  jd_Node            **new_tree,
+                  jd_ParseError      *pe,
+                  jd_ParseStats      *stats)
+{
+   clear_parse_error(pe);
+
+   JReader jr;
+   JReaderInitMemory(&jr, source, len, options, allocator);
+
+   JStatsRun run;
+   stats_start(&run, stats, &jr);
+
+   bool retval = parse_document(&jr, new_tree, pe);
+   stats_built(&run);
+   if (retval && (options & (JD_PARSE_ZERO_COPY | JD_PARSE_KEEP_SPANS)))
+   {
+      retval = wrap_parsed_tree(new_tree, source, len, release, allocator, pe);
+      if (retval)
+         release = NULL;   // the document owns the source now
+   }
+   else if (retval && allocator)
+      retval = wrap_parsed_tree(new_tree, NULL, 0, NULL, allocator, pe);
+
+   if (release)
+      (*release)(source, len);
+
+   stats_end(&run, &jr, *new_tree);
+   JReaderDestroy(&jr);
+
+   return retval;
+}
+
+/**
+ * @brief Parse a document from a block of memory, see jd_parse_buffer.
+ * @param buffer     JSON document text
+ * @param len        number of characters in @b buffer
+ * @param options    #jd_ParseOption flags
+ * @param allocator  source of the memory of the tree, or NULL
+ * @param new_tree   address of pointer to which the result will be written
+ * @param pe         pointer to parsing error structure
+ * @param stats      structure to fill in with statistics, or NULL
+ * @return True for success, false for failure
+ */
+bool parse_buffer(const char         *buffer,
+                  size_t             len,
+                  unsigned int       options,
+                  const jd_Allocator *allocator,
+                  jd_Node            **new_tree,
+                  jd_ParseError      *pe,
+                  jd_ParseStats      *stats)
+{
+   jd_Source_release release = NULL;
+   if (options & JD_PARSE_TAKE_BUFFER)
+      release = release_malloced_source;
+
+   return parse_source(buffer, len, options, allocator, release, new_tree, pe, stats);
+}
+
+/**
+ * @brief Parse a document from a block of memory.
+ * @details
+ *    With #JD_PARSE_ZERO_COPY, string payloads will point into
+ *    @b buffer instead of being copied.  The buffer must then
+ *    outlive the tree, unless #JD_PARSE_TAKE_BUFFER is also set,
+ *    in which case the tree will free the buffer when it is
+ *    destroyed.
+ *
+ *    With #JD_PARSE_TAKE_BUFFER, @b buffer must have been allocated
+ *    with @c malloc, and will be freed by the library even if the
+ *    parse fails.
+ *
+ * @param buffer    JSON document text
+ * @param len       number of characters in @b buffer
+ * @param options   #jd_ParseOption flags
+ * @param new_tree  address of pointer to which the result will be written
+ * @param pe        pointer to parsing error structure
+ * @return True for success, false for failure
+ */
+EXPORT bool jd_parse_buffer(const char    *buffer,
+                            size_t        len,
+                            unsigned int  options,
+                            jd_Node       **new_tree,
+                            jd_ParseError *pe)
+{
+   return parse_buffer(buffer, len, options, NULL, new_tree, pe, NULL);
+}
+
+/**
+ * @brief Parse a file by mapping it into memory, see jd_parse_mapped.
+ * @param fh         handle to an open regular file
+ * @param options    #jd_ParseOption flags
+ * @param allocator  source of the memory of the tree, or NULL
+ * @param new_tree   address of pointer to which the result will be written
+ * @param pe         pointer to parsing error structure
+ * @param stats      structure to fill in with statistics, or NULL
+ * @return True for success, false for failure
+ */
+bool parse_mapped(int                fh,
+                  unsigned int       options,
+                  const jd_Allocator *allocator,
+                  jd_Node            **new_tree,
+                  jd_ParseError      *pe,
+                  jd_ParseStats      *stats)
+{
+   clear_parse_error(pe);
+   *new_tree = NULL;
+
+   struct stat fstats;
+   if (fstat(fh, &fstats) != 0)
+   {
+      pe->char_loc = 0;
+      pe->message = "unable to stat file";
+      return false;
+   }
+
+   size_t len = (size_t)fstats.st_size;
+   if (len == 0)
+      return parse_source("", 0, options & ~JD_PARSE_TAKE_BUFFER, allocator, NULL,
+                          new_tree, pe, stats);
+
+   void *source = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fh, 0);
+   if (source == MAP_FAILED)
+   {
+      pe->char_loc = 0;
+      pe->message = "unable to map file";
+      return false;
+   }
+
+   return parse_source((const char*)source,
+                       len,
+                       options & ~JD_PARSE_TAKE_BUFFER,
+                       allocator,
+                       release_mapped_source,
+                       new_tree,
+                       pe,
+                       stats);
+}
+
+/**
+ * @brief Parse a file by mapping it into memory.
+ * @details
+ *    With #JD_PARSE_ZERO_COPY, the tree will keep the file
+ *    mapped and its string payloads will point into the
+ *    mapping.  The mapping is released when the tree is
+ *    destroyed.  The file handle may be closed as soon as
+ *    this function returns.
+ *
+ * @param fh        handle to an open regular file
+ * @param options   #jd_ParseOption flags
+ * @param new_tree  address of pointer to which the result will be written
+ * @param pe        pointer to parsing error structure
+ * @return True for success, false for failure
+ */
+EXPORT bool jd_parse_mapped(int           fh,
+                            unsigned int  options,
+                            jd_Node       **new_tree,
+                            jd_ParseError *pe)
+{
+   return parse_mapped(fh, options, NULL, new_tree, pe, NULL);
+}
+
+/**
+ * @brief Report the activity of the calling thread's memory cache.
+ * @details
+ *    Each thread keeps the nodes and small string payloads it
+ *    releases for reuse by its later allocations.
+ * @param stats   structure to which the counts will be copied
+ */
+EXPORT void jd_pool_stats(jd_PoolStats *stats)
+{
+   pool_get_stats(stats);
+}
+
+/**
+ * @brief Release the memory held for reuse by the calling thread.
+ * @details
+ *    Memory held by a thread is also released when the thread exits.
+ */
+EXPORT void jd_pool_trim(void)
+{
+   pool_trim();
+}
+
+/**
+ * @brief Report the memory held by a tree or subtree.
+ * @details
+ *    Walks the tree without recursion, counting its nodes and
+ *    the memory of their payloads by type, the indexes of frozen
+ *    objects, and, at the root of a document, the document and
+ *    the source it keeps.  Allocator headers and rounding are
+ *    estimated.
+ *
+ *    The label of a property is kept in the property, so it
+ *    holds no memory of its own.
+ *
+ * @param node   top of the tree to measure, or NULL
+ * @param usage  structure to which the report will be written
+ */
+EXPORT void jd_memory_usage(const jd_Node *node, jd_MemoryUsage *usage)
+{
+   // A label's text is counted with its property:
+   memory_usage(is_label(node) ? NULL : node, usage);
+}
+
+/**
+ * @brief Prepare a context with default settings.
+ * @details
+ *    A new context parses with #JD_PARSE_DEFAULT and reports
+ *    errors only through jd_Context::error.
+ * @param ctx   uninitialized jd_Context memory
+ */
+EXPORT void jd_context_init(jd_Context *ctx)
+{
+   memset(ctx, 0, sizeof(jd_Context));
+   ctx->options = JD_PARSE_DEFAULT;
+}
+
+/**
+ * @brief Start work on behalf of a context.
+ * @param ctx   context given by the caller, or NULL for the default
+ * @return Context to be used, with its error cleared
+ */
+jd_Context *context_begin(jd_Context *ctx)
+{
+   if (ctx == NULL)
+      ctx = &jd_default_context;
+
+   clear_parse_error(&ctx->error);
+
+   return ctx;
+}
+
+/**
+ * @brief Finish work on behalf of a context, reporting any error.
+ * @param ctx     context in use
+ * @param result  result of the work
+ * @return @b result, for use in a return statement
+ */
+bool context_end(jd_Context *ctx, bool result)
+{
+   if (!result && ctx->reporter)
+      (*ctx->reporter)(ctx->reporter_data, &ctx->error);
+
+   return result;
+}
+
+/**
+ * @brief Parse the file into @b new_tree using the settings of a context.
+ * @param ctx       context of the parse, or NULL for the default context
+ * @param fh        handle to an open file
+ * @param new_tree  address of pointer to which the result will be written
+ * @return True for success, false for failure, described in jd_Context::error
+ */
+EXPORT bool jd_ctx_parse_file(jd_Context *ctx, int fh, jd_Node **new_tree)
+{
+   ctx = context_begin(ctx);
+   return context_end(ctx, parse_file(fh, ctx->options, ctx->allocator,
+                                      new_tree, &ctx->error, ctx->stats));
+}
+
+/**
+ * @brief Parse a block of memory using the settings of a context.
+ * @details
+ *    Like jd_parse_buffer, with @b options added to the options
+ *    of the context.
+ * @return True for success, false for failure, described in jd_Context::error
+ */
+EXPORT bool jd_ctx_parse_buffer(jd_Context   *ctx,
+                                const char   *buffer,
+                                size_t       len,
+                                unsigned int options,
+                                jd_Node      **new_tree)
+{
+   ctx = context_begin(ctx);
+   return context_end(ctx, parse_buffer(buffer, len, ctx->options | options, ctx->allocator,
+                                        new_tree, &ctx->error, ctx->stats));
+}
+
+/**
+ * @brief Parse a file by mapping it into memory, using the settings of a context.
+ * @details
+ *    Like jd_parse_mapped, with @b options added to the options
+ *    of the context.
+ * @return True for success, false for failure, described in jd_Context::error
+ */
+EXPORT bool jd_ctx_parse_mapped(jd_Context   *ctx,
+                                int          fh,
+                                unsigned int options,
+                                jd_Node      **new_tree)
+{
+   ctx = context_begin(ctx);
+   return context_end(ctx, parse_mapped(fh, ctx->options | options, ctx->allocator,
+                                        new_tree, &ctx->error, ctx->stats));
+}
+
 /**
  * @brief Free memory in the memory tree
+ * @details
+ *    A document that has been retained is only released: it is
+ *    not freed until every holder has let go of it.
  * @param node   Pointer to node to be destroyed
  */
 EXPORT void jd_destroy(jd_Node **node)
 {
-   jd_Node_destroy((jd_Node**)&node);
+   if (*node)
+   {
+      jd_release(*node);
+      *node = NULL;
+   }
+}
+
+/**
+ * @brief Replace a tree with an immutable copy that threads can share.
+ * @details
+ *    The copy occupies a single block of memory with its nodes in
+ *    document order and an index of the properties of each object,
+ *    which jd_find_property searches.  Functions that would change
+ *    a frozen tree refuse to do so, so any number of threads may
+ *    read it at once without locking.  Use jd_retain and
+ *    jd_release to share it.
+ *
+ *    The original tree is released once the copy is made, so
+ *    it must be the top of its tree.  A subtree is refused: to
+ *    freeze one, detach it first or freeze a jd_clone of it.
+ *
+ * @param root  address of the pointer to the tree to be frozen
+ * @return True for success, false if out of memory or @b root
+ *         has a parent or is the label of a property, in which
+ *         case the original tree is left unchanged
+ */
+EXPORT bool jd_freeze(jd_Node **root)
+{
+   assert(root && *root);
+
+   if (is_label(*root))
+      return false;
+
+   if ((*root)->flags & JDN_FROZEN)
+      return true;
+
+   // Releasing a subtree would free the siblings that follow it:
+   if (jd_Node_relation(*root, JD_PARENT))
+      return false;
+
+   jd_Node *frozen = freeze_tree(*root, jd_Node_allocator(*root));
+   if (frozen == NULL)
+      return false;
+
+   jd_release(*root);
+   *root = frozen;
+   return true;
+}
+
+/**
+ * @brief Make a deep copy of a tree or subtree.
+ * @details
+ *    A copy of a frozen tree is frozen, with its own indexes,
+ *    and occupies a single block of memory.  Any other copy can
+ *    be changed: its payload text is copied into a single block
+ *    owned by the copy, which is a document if it has any text.
+ *    Either way the copy is made in one pass without recursion,
+ *    from the memory of the original's #jd_Allocator if it has one.
+ *
+ *    The copy does not keep the spans of the original, so it
+ *    is serialized from its nodes.
+ *
+ * @param node  top of the tree to be copied
+ * @return Root of the copy, to be freed with jd_destroy, or
+ *         NULL if out of memory
+ */
+EXPORT jd_Node *jd_clone(const jd_Node *node)
+{
+   if (node == NULL)
+      return NULL;
+
+   jd_Node scratch;
+   node = readable_node(node, &scratch);
+   const jd_Allocator *allocator = jd_Node_allocator(node);
+   if (node->flags & JDN_FROZEN)
+      return freeze_tree(node, allocator);
+
+   char *heap;
+   size_t heap_len;
+   jd_Node *copy = clone_tree(node, allocator, &heap, &heap_len);
+   if (copy && (heap || allocator)
+       && !jd_Document_wrap(&copy, heap, heap_len, release_pooled_source, allocator))
+   {
+      jd_Node_destroy(&copy, allocator);
+      pool_free(heap);
+   }
+
+   return copy;
+}
+
+/**
+ * @brief Tells if a tree is frozen.
+ */
+EXPORT bool jd_is_frozen(const jd_Node *node)
+{
+   if (is_label(node))
+      node = label_property(node);
+
+   return node && (node->flags & JDN_FROZEN);
+}
+
+/**
+ * @brief Add a holder of a document.
+ * @details
+ *    Safe to call from any thread holding a reference.  Each
+ *    call must be matched by a call to jd_release.
+ *
+ * @param node  root of a document, as returned by jd_freeze
+ *              or a parse with #JD_PARSE_KEEP_SPANS
+ * @return @b node, or NULL if it is not the root of a document
+ */
+EXPORT jd_Node *jd_retain(jd_Node *node)
+{
+   if (node == NULL || is_label(node) || !(node->flags & JDN_DOCUMENT))
+      return NULL;
+
+   __atomic_add_fetch(&((jd_Document*)node)->refcount, 1, __ATOMIC_RELAXED);
+   return node;
+}
+
+/**
+ * @brief Let go of a tree, freeing it when no holders remain.
+ * @details
+ *    Trees that are not documents have a single holder and
+ *    are freed at once, their nodes returned to the allocator
+ *    of the document above them, if any.  A subtree is first
+ *    detached from its parent, so only it and its descendants
+ *    are freed.  The nodes of a frozen tree, and the label of
+ *    a property, are part of something larger and are left
+ *    alone.
+ *
+ * @param node  tree to be released
+ */
+EXPORT void jd_release(jd_Node *node)
+{
+   if (node == NULL || is_label(node))
+      return;
+
+   if ((node->flags & JDN_DOCUMENT)
+       && __atomic_sub_fetch(&((jd_Document*)node)->refcount, 1, __ATOMIC_ACQ_REL) != 0)
+      return;
+
+   // jd_Node_destroy takes the siblings that follow, so detach a subtree:
+   const jd_Allocator *allocator = jd_Node_allocator(node);
+   if (jd_Node_relation(node, JD_PARENT) && !jd_Node_emancipate(node))
+      return;
+
+   jd_Node_destroy(&node, allocator);
+}
+
+/**
+ * @brief Find a property of an object by its label.
+ * @details
+ *    Frozen objects are searched by hash, others one property
+ *    at a time.  Labels are compared as stored, so the labels
+ *    of a tree parsed with #JD_PARSE_RAW_ESCAPES keep their
+ *    escape sequences.
+ *
+ * @param object  object to search
+ * @param label   label of the property sought
+ * @return The first property with the label, or NULL if there
+ *         is none or @b object is not an object
+ */
+EXPORT jd_Node *jd_find_property(const jd_Node *object, const char *label)
+{
+   if (object == NULL || label == NULL || is_label(object) || object->type != JD_OBJECT)
+      return NULL;
+
+   return find_property(object, label, strlen(label));
+}
+
+/**
+ * @brief Make a compact, read-only copy of a tree or subtree.
+ * @details
+ *    The copy holds its nodes in one array in document order,
+ *    linked by 32-bit index, and their text in a heap after them,
+ *    all in a single block from the memory of the original's
+ *    #jd_Allocator if it has one.  At 20 bytes a node against
+ *    the 64 of a jd_Node, it suits large trees that are read
+ *    in order and kept a long time.
+ *
+ *    Nodes are named by index, with the root at 0 and the first
+ *    child of a node, if any, just after it.
+ *
+ * @param node  top of the tree to be copied
+ * @return The copy, to be freed with jd_compact_destroy, or NULL
+ *         if out of memory or the tree is too large for 32-bit
+ *         indexes
+ */
+EXPORT jd_Compact *jd_compact(const jd_Node *node)
+{
+   if (node == NULL)
+      return NULL;
+
+   jd_Node scratch;
+   node = readable_node(node, &scratch);
+   return compact_tree(node, jd_Node_allocator(node));
+}
+
+/**
+ * @brief Free a copy made by jd_compact.
+ */
+EXPORT void jd_compact_destroy(jd_Compact *doc)
+{
+   if (doc)
+      compact_destroy(doc);
+}
+
+/**
+ * @brief Number of nodes in a compact tree.
+ * @details
+ *    Indexes run from 0 to one less than the count, in document
+ *    order, so a compact tree can also be read as a flat array.
+ */
+EXPORT uint32_t jd_compact_count(const jd_Compact *doc)
+{
+   return doc ? doc->count : 0;
+}
+
+/**
+ * @brief Type of a compact node.
+ * @return Type of the node, -1 if there is no such node
+ */
+EXPORT jd_Type jd_compact_type(const jd_Compact *doc, uint32_t node)
+{
+   if (doc && node < doc->count)
+      return (jd_Type)doc->nodes[node].type;
+
+   return (jd_Type)-1;
+}
+
+/**
+ * @brief Get the index of a relation of a compact node.
+ * @details
+ *    The parent, next sibling and first child are found at once.
+ *    The previous sibling and the last child are found by walking
+ *    the siblings, in time proportional to their number.
+ *
+ *    A compact property has no label node: its label is its own
+ *    text, and its value is both its first and last child.
+ *
+ * @param doc       compact tree
+ * @param node      starting point
+ * @param relation  relation direction to return
+ * @return Index of the relation, or #JD_COMPACT_NONE if the
+ *         relation or the node does not exist
+ */
+EXPORT uint32_t jd_compact_relation(const jd_Compact *doc, uint32_t node, jd_Relation relation)
+{
+   if (doc && node < doc->count && (unsigned int)relation <= JD_LAST)
+      return compact_relation(doc, node, relation);
+
+   return JD_COMPACT_NONE;
+}
+
+/**
+ * @brief Get the text of a compact node and its length.
+ * @details
+ *    Text is read as jd_node_text reads it from the original, and
+ *    is NUL-terminated.
+ *
+ * @param doc     compact tree
+ * @param node    node whose text is wanted
+ * @param length  set to the number of characters in the text,
+ *                may be NULL
+ * @return Text of a string, number or keyword node, the label
+ *         of a property, NULL for other nodes
+ */
+EXPORT const char *jd_compact_text(const jd_Compact *doc, uint32_t node, size_t *length)
+{
+   size_t len = 0;
+   const char *text = NULL;
+   if (doc && node < doc->count)
+      text = compact_text(doc, node, &len);
+
+   if (length)
+      *length = len;
+   return text;
+}
+
+/**
+ * @brief Find a property of a compact object by its label.
+ * @details
+ *    The properties are searched in order.
+ *
+ * @param doc     compact tree
+ * @param object  index of the object to search
+ * @param label   label of the property sought
+ * @return Index of the first property with the label, or
+ *         #JD_COMPACT_NONE if there is none or @b object is not
+ *         an object
+ */
+EXPORT uint32_t jd_compact_find_property(const jd_Compact *doc, uint32_t object, const char *label)
+{
+   if (doc == NULL || label == NULL || object >= doc->count
+       || doc->nodes[object].type != JD_OBJECT)
+      return JD_COMPACT_NONE;
+
+   return compact_find_property(doc, object, label, strlen(label));
+}
+
+/**
+ * @brief Report the memory held by a compact tree.
+ * @return Bytes of its block, with estimated allocator overhead
+ */
+EXPORT size_t jd_compact_size(const jd_Compact *doc)
+{
+   return doc ? compact_size(doc) : 0;
 }
 
 /**
  * @brief Get pointer to a relation
+ * @details
+ *    The first child of a property is its label, a #JD_STRING
+ *    node whose next sibling is the value, the last child.
+ *
  * @param node     Starting point
  * @param relation relation direction to return
  * @return Requested relation of starting node, otherwise
@@ -68,10 +922,33 @@ EXPORT void jd_destroy(jd_Node **node)
  */
 EXPORT jd_Node* jd_get_relation(jd_Node *node, jd_Relation relation)
 {
-   if ( node && (unsigned int)relation <= JD_LAST )
-      return (jd_Node*)((jd_Node**)node)[relation];
-   else
+   if ( node == NULL || (unsigned int)relation > JD_LAST )
       return NULL;
+
+   if (is_label(node))
+   {
+      const jd_Node *property = label_property(node);
+      if (relation == JD_PARENT)
+         return (jd_Node*)property;
+      else if (relation == JD_NEXT)
+         return jd_Node_relation(property, JD_LAST);
+      else
+         return NULL;
+   }
+
+   if (relation == JD_FIRST && node->type == JD_PROPERTY)
+      return label_of(node);
+
+   jd_Node *relative = jd_Node_relation(node, relation);
+   if (relation == JD_PREVIOUS && relative == NULL)
+   {
+      // The value of a property follows its label:
+      jd_Node *parent = jd_Node_relation(node, JD_PARENT);
+      if (parent && parent->type == JD_PROPERTY)
+         return label_of(parent);
+   }
+
+   return relative;
 }
 
 /**
@@ -81,11 +958,7 @@ EXPORT jd_Node* jd_get_relation(jd_Node *node, jd_Relation relation)
  */
 EXPORT jd_Node* parent(jd_Node *node)
 {
-   jd_Node *jnode = (jd_Node*)node;
-   if (node && jnode->parent)
-      return jnode->parent;
-   else
-      return NULL;
+   return jd_get_relation(node, JD_PARENT);
 }
 
 /**
@@ -95,11 +968,7 @@ EXPORT jd_Node* parent(jd_Node *node)
  */
 EXPORT jd_Node* nextSibling(jd_Node *node)
 {
-   jd_Node *jnode = (jd_Node*)node;
-   if (node && jnode->nextSibling)
-      return jnode->nextSibling;
-   else
-      return NULL;
+   return jd_get_relation(node, JD_NEXT);
 }
 
 /**
@@ -109,11 +978,7 @@ EXPORT jd_Node* nextSibling(jd_Node *node)
  */
 EXPORT jd_Node* prevSibling(jd_Node *node)
 {
-   jd_Node *jnode = (jd_Node*)node;
-   if (node && jnode->prevSibling)
-      return jnode->prevSibling;
-   else
-      return NULL;
+   return jd_get_relation(node, JD_PREVIOUS);
 }
 
 /**
@@ -123,11 +988,7 @@ EXPORT jd_Node* prevSibling(jd_Node *node)
  */
 EXPORT jd_Node* firstChild(jd_Node *node)
 {
-   jd_Node *jnode = (jd_Node*)node;
-   if (node && jnode->firstChild)
-      return jnode->firstChild;
-   else
-      return NULL;
+   return jd_get_relation(node, JD_FIRST);
 }
 
 /**
@@ -137,11 +998,7 @@ EXPORT jd_Node* firstChild(jd_Node *node)
  */
 EXPORT jd_Node* lastChild(jd_Node *node)
 {
-   jd_Node *jnode = (jd_Node*)node;
-   if (node && jnode->lastChild)
-      return jnode->lastChild;
-   else
-      return NULL;
+   return jd_get_relation(node, JD_LAST);
 }
 
 /**
@@ -151,7 +1008,9 @@ EXPORT jd_Node* lastChild(jd_Node *node)
  */
 EXPORT jd_Type jd_id_type(const jd_Node *node)
 {
-   if (node)
+   if (is_label(node))
+      return JD_STRING;
+   else if (node)
       return ((jd_Node*)node)->type;
 
    return (jd_Type)-1;
@@ -165,112 +1024,580 @@ EXPORT jd_Type jd_id_type(const jd_Node *node)
 EXPORT const char *jd_id_name(const jd_Node *node)
 {
    if (node)
-      return TypeNames[((jd_Node*)node)->type];
+      return TypeNames[jd_id_type(node)];
    else
       return "nonode";
 }
 
 EXPORT const void *jd_generic_value(const jd_Node *node)
 {
+   jd_Node scratch;
    if (node)
-      return ((jd_Node*)node)->payload;
+      node = readable_node(node, &scratch);
+
+   // Collection payloads are private bookkeeping, a property's is its label:
+   if (node && jd_Node_has_text(node))
+      return jd_Node_payload(node);
    else
       return NULL;
 }
 
-EXPORT int jd_node_value_length(const jd_Node *node)
+/**
+ * @brief Find the text shown for a node, the label of a property.
+ * @param node    node whose text is wanted
+ * @param length  set to the number of characters in the text
+ * @return Text of the node, not necessarily NUL-terminated
+ */
+const char *node_text(const jd_Node *node, size_t *length)
 {
-   jd_Node *jnode = (jd_Node*)node;
-
-   int len_required = 0;
-   switch(jnode->type)
+   switch(node->type)
    {
-      case JD_NULL:
-      case JD_TRUE:
-         len_required = 5;
-         break;
-      case JD_FALSE:
-         len_required = 6;
-         break;
+      case JD_NULL:   *length = 4; return "null";
+      case JD_TRUE:   *length = 4; return "true";
+      case JD_FALSE:  *length = 5; return "false";
+      case JD_ARRAY:  *length = 7; return "*array*";
+      case JD_OBJECT: *length = 8; return "*object*";
+
       case JD_STRING:
       case JD_INTEGER:
       case JD_FLOAT:
-         len_required = 1 + strlen((char*)jnode->payload);
-         break;
-      case JD_ARRAY:
-         len_required = 8;  // *array*\0
-         break;
-      case JD_OBJECT:
-         len_required = 9;  // *object*\0
-         break;
       case JD_PROPERTY:
-         len_required = jd_node_value_length(jnode->firstChild)
-            + jd_node_value_length(jnode->lastChild)
-            + 2;    // colon between, \0 after
-         break;
+         *length = jd_Node_payload_length(node);
+         return node->payload ? (const char*)jd_Node_payload(node) : "";
+
       default:
          // We shouldn't fall through to here:
          assert(0);
-         break;
+         *length = 0;
+         return "";
    }
+}
 
-   return len_required;
+/**
+ * @brief Get the text of a scalar node and its length.
+ * @details
+ *    The length is kept with the payload, so strings with
+ *    embedded NUL characters are returned whole.  The text of
+ *    a string left in the source is not NUL-terminated.
+ * @param node    node whose text is wanted
+ * @param length  set to the number of characters in the text,
+ *                may be NULL
+ * @return Text of a string, number or keyword node, the label
+ *         of a property, NULL for other nodes
+ */
+EXPORT const char *jd_node_text(const jd_Node *node, size_t *length)
+{
+   size_t len = 0;
+   const char *text = NULL;
+   jd_Node scratch;
+   if (node)
+      node = readable_node(node, &scratch);
+   if (node && jd_Node_has_text(node))
+      text = node_text(node, &len);
+
+   if (length)
+      *length = len;
+   return text;
+}
+
+EXPORT int jd_node_value_length(const jd_Node *node)
+{
+   size_t len;
+   jd_Node scratch;
+   node = readable_node(node, &scratch);
+   if (node->type == JD_PROPERTY)
+   {
+      size_t value_len;
+      node_text(node, &len);
+      node_text(jd_Node_relation(node, JD_LAST), &value_len);
+      len += 1 + value_len;   // colon between
+   }
+   else
+      node_text(node, &len);
+
+   return (int)len + 1;   // \0 after
 }
 
 EXPORT int jd_node_value(const jd_Node *node, char *buffer, int bufflen)
 {
-   jd_Node *jnode = (jd_Node*)node;
-   int len_required = jd_node_value_length(node);
-   char *bptr;
-   int tlen;
+   size_t len, value_len = 0;
+   const char *text, *value = NULL;
+   jd_Node scratch;
+   node = readable_node(node, &scratch);
+   if (node->type == JD_PROPERTY)
+   {
+      text = node_text(node, &len);
+      value = node_text(jd_Node_relation(node, JD_LAST), &value_len);
+   }
+   else
+      text = node_text(node, &len);
+
+   int len_required = (int)(len + (value ? 1 + value_len : 0)) + 1;
    if (bufflen >= len_required)
    {
-      switch(jnode->type)
+      char *bptr = buffer;
+      memcpy(bptr, text, len);
+      bptr += len;
+      if (value)
       {
-         case JD_NULL:
-            memcpy(buffer, "null", len_required);
-            break;
-         case JD_TRUE:
-            memcpy(buffer, "true", len_required);
-            break;
-         case JD_FALSE:
-            memcpy(buffer, "false", len_required);
-            break;
-         case JD_STRING:
-         case JD_INTEGER:
-         case JD_FLOAT:
-            memcpy(buffer, jnode->payload, len_required);
-            break;
-         case JD_ARRAY:
-            memcpy(buffer, "*array*", len_required);
-            break;
-         case JD_OBJECT:
-            memcpy(buffer, "*object*", len_required);
-            break;
-         case JD_PROPERTY:
-            bptr = buffer;
-            tlen = jd_node_value_length(jnode->firstChild);
-            --tlen;  // don't count or print the '\0'
-            memcpy(bptr, jnode->firstChild->payload, tlen);
-            bptr += tlen;
-            *bptr++ = ':';
-            jd_node_value(jnode->lastChild, bptr, len_required - tlen - 1);
-            break;
-         default:
-            // We shouldn't fall through to here:
-            assert(0);
-            break;
+         *bptr++ = ':';
+         memcpy(bptr, value, value_len);
+         bptr += value_len;
       }
+      *bptr = '\0';
    }
 
    return len_required;
 }
 
+/**
+ * @brief Write a tree as JSON text to a file handle.
+ * @details
+ *    Output is collected in a large buffer and passed to
+ *    @b jd_out in as few writes as possible.
+ *
+ * @param jd_out   handle to which the JSON text will be written
+ * @param node     node at the top of the tree to be written
+ * @param options  output settings, or NULL for pretty output
+ *                 indented by #JD_SERIALIZE_INDENT spaces
+ * @return True for success, false if the output could not be written
+ */
+EXPORT bool jd_serialize_with(int jd_out, const jd_Node *node, const jd_SerializeOptions *options)
+{
+   if (options == NULL)
+      options = &default_serialize_options;
+
+   JWriter jw;
+   if (!JWriterInitFile(&jw, jd_out))
+      return false;
+
+   jd_Node scratch;
+   serialize_tree(&jw, readable_node(node, &scratch), options);
+   return JWriterDestroy(&jw);
+}
+
+/**
+ * @brief Write a tree to a file handle as indented JSON text.
+ */
 EXPORT void jd_serialize(int jd_out, const jd_Node *node)
 {
-   jd_Node_serialize((jd_Node*)node, 0);
+   jd_serialize_with(jd_out, node, NULL);
+}
+
+/**
+ * @brief Number of characters jd_serialize_to_buffer will write.
+ * @details
+ *    Measures the output in one pass without producing it,
+ *    so the destination can be allocated at its exact size.
+ *
+ * @param node     node at the top of the tree to be measured
+ * @param options  output settings, or NULL as for jd_serialize_with
+ * @return Length of the JSON text, excluding any terminating NUL
+ */
+EXPORT size_t jd_serialized_length(const jd_Node *node, const jd_SerializeOptions *options)
+{
+   if (options == NULL)
+      options = &default_serialize_options;
+
+   JWriter jw;
+   JWriterInitCount(&jw);
+   jd_Node scratch;
+   serialize_tree(&jw, readable_node(node, &scratch), options);
+
+   return JWriterTotal(&jw);
+}
+
+/**
+ * @brief Write a tree as JSON text into a block of memory.
+ * @details
+ *    No NUL is added after the text.  Like @c snprintf, the
+ *    return value is the length of the complete output even
+ *    if it did not fit, in which case @b buffer holds only the
+ *    first @b len characters.
+ *
+ * @param node     node at the top of the tree to be written
+ * @param buffer   memory to which the JSON text will be written
+ * @param len      number of characters available at @b buffer
+ * @param options  output settings, or NULL as for jd_serialize_with
+ * @return Length of the JSON text, which is greater than @b len
+ *         if the buffer was too small
+ */
+EXPORT size_t jd_serialize_to_buffer(const jd_Node *node,
+                                     char *buffer,
+                                     size_t len,
+                                     const jd_SerializeOptions *options)
+{
+   if (options == NULL)
+      options = &default_serialize_options;
+
+   JWriter jw;
+   JWriterInitMemory(&jw, buffer, len);
+   jd_Node scratch;
+   serialize_tree(&jw, readable_node(node, &scratch), options);
+
+   return JWriterTotal(&jw);
 }
 
 
 
 
+
+/**
+ * @brief Write a tree to a file handle in the binary format.
+ * @details
+ *    The binary format is reloaded by jd_load_binary much faster
+ *    than JSON text is parsed.  It is versioned and checksummed,
+ *    and keeps numbers as the text from which they were parsed.
+ *
+ * @param fd    handle to which the file will be written
+ * @param node  node at the top of the tree to be written
+ * @return True for success, false if the file could not be written
+ */
+EXPORT bool jd_save_binary(int fd, const jd_Node *node)
+{
+   JWriter jw;
+   if (!JWriterInitFile(&jw, fd))
+      return false;
+
+   jd_Node scratch;
+   binary_write(&jw, readable_node(node, &scratch));
+   return JWriterDestroy(&jw);
+}
+
+/**
+ * @brief Read everything remaining from a file handle.
+ * @param fh   handle to read
+ * @param len  set to the number of bytes read
+ * @return Block allocated with @c malloc holding the bytes read,
+ *         or NULL if the handle could not be read or memory ran out
+ */
+char *read_whole_file(int fh, size_t *len)
+{
+   size_t size = 65536;
+   size_t used = 0;
+   char *buffer = (char*)malloc(size);
+
+   while (buffer)
+   {
+      if (used == size)
+      {
+         char *larger = (char*)realloc(buffer, size * 2);
+         if (larger == NULL)
+            break;
+
+         buffer = larger;
+         size *= 2;
+      }
+
+      ssize_t bytes_read = read(fh, buffer + used, size - used);
+      if (bytes_read == 0)
+      {
+         *len = used;
+         return buffer;
+      }
+      else if (bytes_read > 0)
+         used += bytes_read;
+      else if (errno != EINTR)
+         break;
+   }
+
+   free(buffer);
+   return NULL;
+}
+
+/**
+ * @brief Build a tree from binary data, keeping the data in a document.
+ * @details
+ *    Payloads of the tree point into @b source, which the
+ *    document releases when it is destroyed.  If the data is
+ *    rejected, @b source is released at once.
+ *
+ * @param source    contents of a binary file
+ * @param len       number of bytes in @b source
+ * @param release   function to free @b source
+ * @param new_tree  address of pointer to which the result will be written
+ * @param pe        pointer to parsing error structure
+ * @return True for success, false for failure
+ */
+bool load_binary_source(const char        *source,
+                        size_t            len,
+                        jd_Source_release release,
+                        jd_Node           **new_tree,
+                        jd_ParseError     *pe)
+{
+   *new_tree = binary_read(source, len, pe);
+   if (*new_tree && !jd_Document_wrap(new_tree, source, len, release, NULL))
+   {
+      jd_Node_destroy(new_tree, NULL);
+      pe->char_loc = 0;
+      pe->message = "out of memory";
+   }
+
+   if (*new_tree == NULL)
+   {
+      (*release)(source, len);
+      return false;
+   }
+
+   return true;
+}
+
+/**
+ * @brief Read a tree written by jd_save_binary.
+ * @details
+ *    A regular file is mapped and its payloads used in place;
+ *    anything else is read into memory first.  Either way the
+ *    tree keeps the data until it is destroyed, and the file
+ *    handle may be closed as soon as this function returns.
+ *
+ *    The file is checked completely before the tree is used.
+ *    A file that is truncated, damaged, or from another version
+ *    of the format is rejected with its problem described in
+ *    @b pe, whose jd_ParseError::char_loc is the file offset at
+ *    which the problem was found.
+ *
+ * @param fd        handle to a file written by jd_save_binary
+ * @param new_tree  address of pointer to which the result will be written
+ * @param pe        pointer to parsing error structure
+ * @return True for success, false for failure
+ */
+EXPORT bool jd_load_binary(int fd, jd_Node **new_tree, jd_ParseError *pe)
+{
+   clear_parse_error(pe);
+   *new_tree = NULL;
+
+   struct stat fstats;
+   if (fstat(fd, &fstats) != 0)
+   {
+      pe->char_loc = 0;
+      pe->message = "unable to stat file";
+      return false;
+   }
+
+   if (S_ISREG(fstats.st_mode) && fstats.st_size > 0)
+   {
+      size_t len = (size_t)fstats.st_size;
+      void *source = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (source != MAP_FAILED)
+         return load_binary_source((const char*)source, len,
+                                   release_mapped_source, new_tree, pe);
+   }
+
+   size_t len;
+   char *source = read_whole_file(fd, &len);
+   if (source == NULL)
+   {
+      pe->char_loc = 0;
+      pe->message = "unable to read file";
+      return false;
+   }
+
+   return load_binary_source(source, len, release_malloced_source, new_tree, pe);
+}
+
+/**
+ * @brief Write a tree as a snapshot that can be used without loading.
+ * @details
+ *    A snapshot is a frozen tree in which every link is an
+ *    offset, so it works wherever jd_snapshot_open maps it.
+ *    Snapshots use the memory layout of the machine that wrote
+ *    them.
+ *
+ * @param fd    handle to which the snapshot will be written
+ * @param node  node at the top of the tree to be written
+ * @return True for success, false if out of memory or the
+ *         snapshot could not be written
+ */
+EXPORT bool jd_snapshot_save(int fd, const jd_Node *node)
+{
+   JWriter jw;
+   if (!JWriterInitFile(&jw, fd))
+      return false;
+
+   jd_Node scratch;
+   bool retval = snapshot_write(&jw, readable_node(node, &scratch));
+   return JWriterDestroy(&jw) && retval;
+}
+
+/**
+ * @brief Map a snapshot written by jd_snapshot_save for use in place.
+ * @details
+ *    Only the header is read, so a snapshot of any size opens at
+ *    once, and processes that open the same snapshot share its
+ *    pages.  The tree is frozen, and the navigation, value and
+ *    serializing functions work on it directly.  Destroying the
+ *    root unmaps the file.
+ *
+ *    Its nodes hold byte offsets in place of the addresses of
+ *    their relatives and payloads, so they must be read through
+ *    jd_get_relation, jd_node_text, jd_node_value and the other
+ *    accessors, never through the members of jd_Node.
+ *
+ *    A snapshot that may have been damaged should be checked
+ *    with jd_snapshot_verify before it is used.
+ *
+ * @param path      name of the snapshot file
+ * @param root      address of pointer to which the root will be written
+ * @param pe        pointer to parsing error structure
+ * @return True for success, false for failure
+ */
+EXPORT bool jd_snapshot_open(const char *path, jd_Node **root, jd_ParseError *pe)
+{
+   clear_parse_error(pe);
+   *root = NULL;
+
+   int fd = open(path, O_RDONLY);
+   if (fd < 0)
+   {
+      pe->char_loc = 0;
+      pe->message = "unable to open file";
+      return false;
+   }
+
+   struct stat fstats;
+   void *base = MAP_FAILED;
+   size_t len = 0;
+   if (fstat(fd, &fstats) == 0 && fstats.st_size > 0)
+   {
+      // Private and writable so that only the page holding the
+      // document's reference count is ever copied:
+      len = (size_t)fstats.st_size;
+      base = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+   }
+   close(fd);
+
+   if (base == MAP_FAILED)
+   {
+      pe->char_loc = 0;
+      pe->message = "unable to map file";
+      return false;
+   }
+
+   *root = snapshot_attach((char*)base, len, release_mapped_source, pe);
+   if (*root == NULL)
+   {
+      munmap(base, len);
+      return false;
+   }
+
+   return true;
+}
+
+/**
+ * @brief Check every node of an opened snapshot.
+ * @details
+ *    Reads the whole snapshot to confirm that every link and
+ *    payload stays within the file and that the nodes form a
+ *    tree, so a damaged file cannot lead navigation astray.
+ *
+ * @param root  root returned by jd_snapshot_open
+ * @return True if the snapshot is sound, false if it is
+ *         damaged or @b root is not the root of a snapshot
+ */
+EXPORT bool jd_snapshot_verify(const jd_Node *root)
+{
+   if (root == NULL || is_label(root)
+       || (root->flags & (JDN_DOCUMENT | JDN_RELATIVE)) != (JDN_DOCUMENT | JDN_RELATIVE))
+      return false;
+
+   return snapshot_verify(root);
+}
+
+/**
+ * @brief Get the document parsed from a file, reusing an earlier
+ *        parse while the file is unchanged.
+ * @details
+ *    Documents are cached by path, and a cached document is used
+ *    only while its file has the device, inode, size and
+ *    modification time it had when parsed.  Otherwise the file
+ *    is parsed, frozen and cached in place of any older version.
+ *
+ *    The cached documents are frozen, so one document may be held
+ *    by any number of callers and threads at once.  The least
+ *    recently used are dropped when the cache exceeds its memory
+ *    budget, see jd_cache_set_budget, but live on until their
+ *    last holder releases them.
+ *
+ *    A file rewritten within the resolution of its modification
+ *    time, without changing size, is not noticed.
+ *
+ * @param path      name of the JSON file
+ * @param root      address of pointer to which the frozen document
+ *                  will be written, to be released with jd_destroy
+ * @param pe        pointer to parsing error structure
+ * @return True for success, false for failure
+ */
+EXPORT bool jd_cache_open(const char *path, jd_Node **root, jd_ParseError *pe)
+{
+   clear_parse_error(pe);
+   *root = NULL;
+
+   int fd = open(path, O_RDONLY);
+   if (fd < 0)
+   {
+      pe->char_loc = 0;
+      pe->message = "unable to open file";
+      return false;
+   }
+
+   struct stat fstats;
+   if (fstat(fd, &fstats) != 0)
+   {
+      close(fd);
+      pe->char_loc = 0;
+      pe->message = "unable to stat file";
+      return false;
+   }
+
+   jd_Node *tree = cache_find(path, &fstats);
+   if (tree == NULL && parse_file(fd, JD_PARSE_DEFAULT, NULL, &tree, pe, NULL))
+   {
+      if (jd_freeze(&tree))
+         tree = cache_insert(path, &fstats, tree);
+      else
+      {
+         jd_Node_destroy(&tree, NULL);
+         pe->char_loc = 0;
+         pe->message = "out of memory";
+      }
+   }
+   close(fd);
+
+   *root = tree;
+   return tree != NULL;
+}
+
+/**
+ * @brief Set the most memory the documents kept by jd_cache_open
+ *        may use.
+ * @details
+ *    Least recently used documents are dropped at once to fit.
+ *    A document larger than the whole budget is never kept.
+ *    The budget starts at 64 MiB.
+ *
+ * @param bytes  memory budget of the cache
+ */
+EXPORT void jd_cache_set_budget(size_t bytes)
+{
+   cache_set_budget(bytes);
+}
+
+/**
+ * @brief Report the activity and size of the cache used by
+ *        jd_cache_open.
+ * @param stats   structure to which the counts will be copied
+ */
+EXPORT void jd_cache_stats(jd_CacheStats *stats)
+{
+   cache_get_stats(stats);
+}
+
+/**
+ * @brief Drop every document kept by jd_cache_open.
+ * @details
+ *    Documents still held by callers live on until released.
+ */
+EXPORT void jd_cache_clear(void)
+{
+   cache_clear();
+}
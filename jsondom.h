@@ -2,6 +2,8 @@
 #define JSONDOM_H
 
 #include <stdbool.h>
+#include <stddef.h>   // for size_t
+#include <stdint.h>   // for uint32_t
 
 typedef enum jd_Type_e {
    JD_NULL,         ///< constant NULL/empty value
@@ -19,6 +21,19 @@ typedef enum jd_Type_e {
 
 typedef struct jd_Node_s jd_Node;
 
+/**
+ * @brief Read-only copy of a tree made by jd_compact.
+ * @details
+ *    Its nodes are 20 bytes each, held in one array in document
+ *    order and linked by 32-bit index, with their text in a heap
+ *    that follows them in the same block.  A node is named by
+ *    its index, and the root is index 0.
+ */
+typedef struct jd_Compact_s jd_Compact;
+
+/** Index of a compact node that does not exist, see jd_compact_relation */
+#define JD_COMPACT_NONE UINT32_MAX
+
 /**
  * @brief Memory representation of a JSON data element, including family links.
  *
@@ -27,6 +42,12 @@ typedef struct jd_Node_s jd_Node;
  *
  * The #payload member is allocated separately according to the #JDataType
  * and the value of the instance.
+ *
+ * The members are the library's bookkeeping, not part of the API:
+ * read a node only through jd_get_relation, jd_id_type, jd_node_text,
+ * jd_node_value and the like.  In a tree opened by jd_snapshot_open
+ * the links and payload hold byte offsets rather than addresses, so
+ * a member read directly is not a usable pointer.
  */
 struct jd_Node_s {
    jd_Node *parent;          ///<  node that counts @e this as a child
@@ -38,10 +59,17 @@ struct jd_Node_s {
                              */
 
    jd_Type type;             ///< #JDataType identity member
+   unsigned int flags;       ///< library bookkeeping bits, see jd_Node.h
    void    *payload;         ///< generic pointer to be cast according to the #type value.
+   size_t  length;           /**< @brief byte length of a payload that is not
+                              *   NUL-terminated, like a string left in its source
+                              */
 };
 
 
+/** Size of jd_ParseError::excerpt, its terminating NUL included */
+#define JD_EXCERPT_SIZE 40
+
 typedef struct jd_ParseError_s {
    int        char_loc;      /**< offset in file of the character that
                               *   confirmed the detected error.  The actual
@@ -49,9 +77,184 @@ typedef struct jd_ParseError_s {
                               *   earlier.
                               */
    const char *message;      ///< description of error
+   int        line;          /**< line of the character at #char_loc, counting
+                              *   from 1, or 0 if the error was not found in
+                              *   JSON text
+                              */
+   int        column;        ///< byte offset of #char_loc in its line, counting from 1
+   char       excerpt[JD_EXCERPT_SIZE]; /**< text of the line around #char_loc,
+                                         *   with control characters shown as
+                                         *   spaces, empty if #line is 0
+                                         */
 } jd_ParseError;
 
 
+/**
+ * @brief Counters and timers that describe a single parse.
+ * @details
+ *    Set jd_Context::stats to collect them.  The node and string
+ *    counts describe the finished tree, so they are zero when a
+ *    parse fails; the other members describe the work done
+ *    either way.
+ */
+typedef struct jd_ParseStats_s {
+   size_t bytes;                   ///< bytes of source consumed
+   size_t reads;                   ///< @c read calls made on a file handle
+   size_t nodes[JD_OBJECT + 1];    ///< nodes in the tree, counted by #jd_Type
+   size_t strings;                 ///< string nodes and property labels
+   size_t string_bytes;            ///< bytes of text in the strings and labels
+   size_t allocations;             ///< node and payload allocations made
+   size_t allocated_bytes;         ///< bytes of node and payload memory allocated
+   size_t max_depth;               ///< deepest nesting of arrays and objects
+   unsigned long long read_ns;     ///< time waiting for @c read calls
+   unsigned long long build_ns;    ///< time reading text and building the tree
+   unsigned long long finish_ns;   ///< time completing the document after the tree
+   unsigned long long total_ns;    ///< time in the whole parse
+} jd_ParseStats;
+
+/**
+ * @brief Function that receives parse errors as they are detected
+ * @param data  the jd_Context::reporter_data of the parsing context
+ * @param pe    description and location of the error
+ */
+typedef void (*jd_Reporter)(void *data, const jd_ParseError *pe);
+
+/**
+ * @brief Source of the memory of documents, used in place of @c malloc.
+ * @details
+ *    Set jd_Context::allocator to build the documents parsed
+ *    through the context from this memory.  Each document keeps
+ *    the allocator it was built with, to be freed with it and to
+ *    have its copies made by jd_freeze and jd_clone from it, so
+ *    the allocator must outlive its documents.
+ *
+ *    All three functions are required, and are called from
+ *    whichever thread parses, copies or releases a document.
+ */
+typedef struct jd_Allocator_s {
+   void *(*alloc)(void *user, size_t size);              ///< get a block, NULL if out of memory
+   void *(*realloc)(void *user, void *ptr, size_t size); ///< resize a block, NULL if out of memory
+   void (*free)(void *user, void *ptr);                  ///< release a block
+   void *user;                                           ///< passed to each function
+} jd_Allocator;
+
+/**
+ * @brief Settings and results of work done on behalf of one caller.
+ * @details
+ *    Functions that take a context keep all of their state in it,
+ *    so threads that use separate contexts can parse at the same
+ *    time.  Passing NULL selects a shared default context, which
+ *    is only safe in single-threaded programs.
+ *
+ *    Prepare a context with jd_context_init before changing any
+ *    of its settings.
+ */
+typedef struct jd_Context_s {
+   unsigned int       options;        ///< #jd_ParseOption flags added to every parse
+   jd_Reporter        reporter;       ///< called with each parse error, or NULL
+   void               *reporter_data; ///< passed to #reporter
+   jd_ParseError      error;          ///< most recent parse error
+   jd_ParseStats      *stats;         ///< filled in by every parse if not NULL
+   const jd_Allocator *allocator;     ///< memory of parsed documents, NULL for @c malloc
+   int                node_error;     ///< result code of the most recent stringify call
+} jd_Context;
+
+/**
+ * @brief Flags to modify the behavior of jd_parse_buffer and jd_parse_mapped
+ */
+typedef enum jd_ParseOption_e {
+   JD_PARSE_DEFAULT     = 0,       ///< copy all strings out of the source
+   JD_PARSE_ZERO_COPY   = 1 << 0,  /**< @brief leave string payloads in the source
+                                    *
+                                    * String values and labels will point into
+                                    * the source text rather than being copied.
+                                    * The source must outlive the document.
+                                    */
+   JD_PARSE_TAKE_BUFFER = 1 << 1,  /**< @brief document takes ownership of the buffer
+                                    *
+                                    * The buffer passed to jd_parse_buffer was
+                                    * allocated with @c malloc and will be freed
+                                    * when it is no longer needed.
+                                    */
+   JD_PARSE_RAW_ESCAPES = 1 << 2,  /**< @brief keep escape sequences undecoded
+                                    *
+                                    * String payloads will hold the text as it
+                                    * appears between the quotes.  With
+                                    * #JD_PARSE_ZERO_COPY, this allows every
+                                    * string to be left in the source.
+                                    */
+   JD_PARSE_VALIDATE_UTF8 = 1 << 3,/**< @brief reject strings that are not valid UTF-8
+                                    *
+                                    * The offset of the first byte of the invalid
+                                    * sequence is reported in jd_ParseError::char_loc.
+                                    */
+   JD_PARSE_KEEP_SPANS  = 1 << 4   /**< @brief remember where collections appear in the source
+                                    *
+                                    * The source is kept with the tree, and
+                                    * unchanged arrays and objects can be copied
+                                    * from it by a serializer with
+                                    * jd_SerializeOptions::copy_spans set.
+                                    */
+} jd_ParseOption;
+
+/**
+ * @brief Settings for jd_serialize_with
+ */
+typedef struct jd_SerializeOptions_s {
+   int indent;               /**< spaces added per level of nesting, or 0
+                              *   for compact output without whitespace
+                              */
+   bool copy_spans;          /**< copy unchanged collections from the source
+                              *   of a tree parsed with #JD_PARSE_KEEP_SPANS,
+                              *   keeping their original formatting
+                              */
+} jd_SerializeOptions;
+
+/**
+ * @brief Activity of the calling thread's cache of node and payload memory
+ */
+typedef struct jd_PoolStats_s {
+   size_t node_hits;         ///< nodes taken from the cache
+   size_t node_misses;       ///< nodes allocated because the cache was empty
+   size_t nodes_cached;      ///< nodes now held in the cache
+   size_t payload_hits;      ///< payload blocks taken from the cache
+   size_t payload_misses;    ///< small payload blocks allocated because the cache was empty
+   size_t payloads_cached;   ///< payload blocks now held in the cache
+   size_t bytes_cached;      ///< memory held by the cached nodes and payload blocks
+   size_t allocations;       ///< nodes and payload blocks handed out, cached or not
+   size_t bytes_allocated;   ///< memory of the nodes and payload blocks handed out
+} jd_PoolStats;
+
+/**
+ * @brief Activity and size of the cache used by jd_cache_open
+ */
+typedef struct jd_CacheStats_s {
+   size_t hits;        ///< opens answered by a cached document
+   size_t misses;      ///< opens that parsed the file
+   size_t evictions;   ///< documents dropped to stay within the budget
+   size_t entries;     ///< documents now cached
+   size_t bytes;       ///< memory used by the cached documents
+   size_t budget;      ///< most memory the cached documents may use
+} jd_CacheStats;
+
+/**
+ * @brief Memory held by a tree, as reported by jd_memory_usage
+ * @details
+ *    Overhead is estimated from the block sizes of the system
+ *    allocator, so it is approximate, and more so for documents
+ *    whose memory comes from a #jd_Allocator.
+ */
+typedef struct jd_MemoryUsage_s {
+   size_t nodes[JD_OBJECT + 1];          ///< nodes, counted by #jd_Type
+   size_t node_bytes[JD_OBJECT + 1];     ///< memory of the nodes, by #jd_Type
+   size_t payload_bytes[JD_OBJECT + 1];  ///< payload text owned by the tree, by #jd_Type, labels under #JD_PROPERTY
+   size_t index_bytes;                   ///< property indexes of frozen objects
+   size_t source_bytes;                  ///< source text kept by a document
+   size_t document_bytes;                ///< document bookkeeping beyond its root node
+   size_t overhead_bytes;                ///< estimated allocator headers and rounding
+   size_t total_bytes;                   ///< everything above
+} jd_MemoryUsage;
+
 /**
  * @brief Indexes of relations to a given jd_Node for use with
  *       jd_get_relation
@@ -76,8 +279,37 @@ typedef enum jd_Relation_e {
 
 
 bool jd_parse_file(int fh, jd_Node **new_tree, jd_ParseError *pe);
+bool jd_parse_buffer(const char *buffer, size_t len, unsigned int options,
+                     jd_Node **new_tree, jd_ParseError *pe);
+bool jd_parse_mapped(int fh, unsigned int options, jd_Node **new_tree, jd_ParseError *pe);
 void jd_destroy(jd_Node **node);
 
+bool jd_freeze(jd_Node **root);
+jd_Node *jd_clone(const jd_Node *node);
+bool jd_is_frozen(const jd_Node *node);
+jd_Node *jd_retain(jd_Node *node);
+void jd_release(jd_Node *node);
+jd_Node *jd_find_property(const jd_Node *object, const char *label);
+
+jd_Compact *jd_compact(const jd_Node *node);
+void jd_compact_destroy(jd_Compact *doc);
+uint32_t jd_compact_count(const jd_Compact *doc);
+jd_Type jd_compact_type(const jd_Compact *doc, uint32_t node);
+uint32_t jd_compact_relation(const jd_Compact *doc, uint32_t node, jd_Relation relation);
+const char *jd_compact_text(const jd_Compact *doc, uint32_t node, size_t *length);
+uint32_t jd_compact_find_property(const jd_Compact *doc, uint32_t object, const char *label);
+size_t jd_compact_size(const jd_Compact *doc);
+
+void jd_pool_stats(jd_PoolStats *stats);
+void jd_pool_trim(void);
+void jd_memory_usage(const jd_Node *node, jd_MemoryUsage *usage);
+
+void jd_context_init(jd_Context *ctx);
+bool jd_ctx_parse_file(jd_Context *ctx, int fh, jd_Node **new_tree);
+bool jd_ctx_parse_buffer(jd_Context *ctx, const char *buffer, size_t len,
+                         unsigned int options, jd_Node **new_tree);
+bool jd_ctx_parse_mapped(jd_Context *ctx, int fh, unsigned int options, jd_Node **new_tree);
+
 jd_Node* jd_get_relation(jd_Node *node, jd_Relation relation);
 
 jd_Node* parent(jd_Node *node);
@@ -92,8 +324,25 @@ const void* jd_generic_value(const jd_Node *node);
 
 int jd_node_value_length(const jd_Node *node);
 int jd_node_value(const jd_Node *node, char *buffer, int bufflen);
+const char *jd_node_text(const jd_Node *node, size_t *length);
 
 void jd_serialize(int jd_out, const jd_Node *node);
+bool jd_serialize_with(int jd_out, const jd_Node *node, const jd_SerializeOptions *options);
+size_t jd_serialized_length(const jd_Node *node, const jd_SerializeOptions *options);
+size_t jd_serialize_to_buffer(const jd_Node *node, char *buffer, size_t len,
+                              const jd_SerializeOptions *options);
+
+bool jd_save_binary(int fd, const jd_Node *node);
+bool jd_load_binary(int fd, jd_Node **new_tree, jd_ParseError *pe);
+
+bool jd_snapshot_save(int fd, const jd_Node *node);
+bool jd_snapshot_open(const char *path, jd_Node **root, jd_ParseError *pe);
+bool jd_snapshot_verify(const jd_Node *root);
+
+bool jd_cache_open(const char *path, jd_Node **root, jd_ParseError *pe);
+void jd_cache_set_budget(size_t bytes);
+void jd_cache_stats(jd_CacheStats *stats);
+void jd_cache_clear(void);
 
 
 #endif // JSONDOM_H
@@ -0,0 +1,801 @@
+/**
+ * @file test_api.c
+ * @brief Checks of library behavior that need no input files.
+ *
+ * Unlike *basic* and *getrel*, this program asks nothing of the
+ * user.  Each check prints its name, and each failed expectation
+ * prints its line and condition.  The program exits with 1 if
+ * any expectation failed, so it can be run from a script:
+ *    make test && ./api
+ */
+
+/** Enable usage of fileno, mkstemp and utimensat: */
+#define _POSIX_C_SOURCE 200809L
+
+#include "jsondom.h"
+#include "jd_Node.h"  // for editing functions
+#include <stdio.h>
+#include <stdlib.h>   // for malloc/free, mkstemp
+#include <string.h>   // for strlen, memcmp
+#include <stdbool.h>
+#include <unistd.h>   // for read, lseek, close, unlink
+#include <fcntl.h>    // for AT_FDCWD
+#include <sys/stat.h> // for utimensat
+
+/** Number of failed expectations */
+int failures = 0;
+
+/**
+ * @brief Record the result of an expectation, printing it if it failed.
+ */
+void expect(bool passed, const char *condition, int line)
+{
+   if (!passed)
+   {
+      printf("   \033[31;1mFAILED\033[39;22m at line %d: %s\n", line, condition);
+      ++failures;
+   }
+}
+
+#define EXPECT(cond) expect((cond), #cond, __LINE__)
+
+/**
+ * @brief Parse a string, reporting a failure to do so.
+ * @return The tree, or NULL if the parse failed
+ */
+jd_Node *parse_text(const char *text, unsigned int options)
+{
+   jd_Node *tree = NULL;
+   jd_ParseError pe;
+   if (!jd_parse_buffer(text, strlen(text), options, &tree, &pe))
+   {
+      printf("   Failed to parse '%s': %s.\n", text, pe.message);
+      ++failures;
+   }
+   return tree;
+}
+
+/**
+ * @brief Tells if the text of a node, as jd_node_value gives it,
+ *        has the given value.
+ */
+bool text_is(const jd_Node *node, const char *value)
+{
+   char buffer[80];
+   size_t len = strlen(value);
+   return node && len < sizeof(buffer)
+      && jd_node_value(node, buffer, sizeof(buffer)) == (int)len + 1
+      && memcmp(buffer, value, len + 1) == 0;
+}
+
+/**
+ * @brief Tells if the text of a node lies in a block of memory.
+ */
+bool text_in(const jd_Node *node, const char *block, size_t block_len)
+{
+   size_t len;
+   const char *text = jd_node_text(node, &len);
+   return text >= block && text + len <= block + block_len;
+}
+
+/**
+ * @brief Strings and labels are left in the buffer with
+ *        JD_PARSE_ZERO_COPY, and copied out of it without.
+ */
+void test_zero_copy(void)
+{
+   const char *json = "{\"label\":\"value\",\"list\":[\"item\",12]}";
+   size_t len = strlen(json);
+   char *buffer = (char*)malloc(len);
+   memcpy(buffer, json, len);
+
+   // The tree takes the buffer, to free it when destroyed:
+   jd_Node *tree = NULL;
+   jd_ParseError pe;
+   EXPECT(jd_parse_buffer(buffer, len, JD_PARSE_ZERO_COPY | JD_PARSE_TAKE_BUFFER, &tree, &pe));
+   if (tree == NULL)
+      return;
+
+   jd_Node *property = jd_get_relation(tree, JD_FIRST);
+   jd_Node *label = jd_get_relation(property, JD_FIRST);
+   jd_Node *value = jd_get_relation(property, JD_LAST);
+   jd_Node *list = jd_get_relation(jd_get_relation(property, JD_NEXT), JD_LAST);
+   jd_Node *item = jd_get_relation(list, JD_FIRST);
+   EXPECT(text_is(label, "label") && text_in(label, buffer, len));
+   EXPECT(text_is(value, "value") && text_in(value, buffer, len));
+   EXPECT(text_is(item, "item") && text_in(item, buffer, len));
+   EXPECT(text_is(jd_get_relation(list, JD_LAST), "12"));
+   jd_destroy(&tree);
+
+   tree = parse_text(json, JD_PARSE_DEFAULT);
+   if (tree)
+   {
+      value = jd_get_relation(jd_get_relation(tree, JD_FIRST), JD_LAST);
+      EXPECT(text_is(value, "value") && !text_in(value, json, len));
+      jd_destroy(&tree);
+   }
+}
+
+/**
+ * @brief Serialize a tree to a temporary file.
+ * @return The text, to be freed, with its length in @b len
+ */
+char *serialize_to_file(const jd_Node *tree, const jd_SerializeOptions *options, size_t *len)
+{
+   char *text = NULL;
+   *len = 0;
+
+   FILE *file = tmpfile();
+   if (file == NULL)
+      return NULL;
+
+   int fd = fileno(file);
+   if (jd_serialize_with(fd, tree, options))
+   {
+      off_t size = lseek(fd, 0, SEEK_END);
+      text = (char*)malloc(size + 1);
+      if (text && lseek(fd, 0, SEEK_SET) == 0 && read(fd, text, size) == size)
+         *len = (size_t)size;
+   }
+
+   fclose(file);
+   return text;
+}
+
+/**
+ * @brief The measured length is what jd_serialize_to_buffer
+ *        writes, or would write to a short buffer, and the text
+ *        is what jd_serialize_with writes to a file.
+ */
+void test_serialize_to_buffer(void)
+{
+   const char *json = "{\"a\":[1,2.5,\"x\\ny\",true,null],\"b\":{},\"c\":[],\"d\":{\"e\":false}}";
+   jd_Node *tree = parse_text(json, JD_PARSE_DEFAULT);
+   if (tree == NULL)
+      return;
+
+   jd_SerializeOptions compact = { 0 };
+   jd_SerializeOptions indented = { 2 };
+   const jd_SerializeOptions *settings[] = { NULL, &compact, &indented };
+
+   for (int i = 0; i < 3; ++i)
+   {
+      size_t len = jd_serialized_length(tree, settings[i]);
+      char *buffer = (char*)malloc(len + 1);
+      buffer[len] = '#';
+      EXPECT(jd_serialize_to_buffer(tree, buffer, len, settings[i]) == len);
+      EXPECT(buffer[len] == '#');
+
+      size_t file_len;
+      char *file_text = serialize_to_file(tree, settings[i], &file_len);
+      EXPECT(file_text && file_len == len && memcmp(file_text, buffer, len) == 0);
+
+      // A short buffer gets what fits, and the full length is returned:
+      memset(buffer, '#', len + 1);
+      EXPECT(jd_serialize_to_buffer(tree, buffer, len - 5, settings[i]) == len);
+      EXPECT(file_text && memcmp(buffer, file_text, len - 5) == 0);
+      EXPECT(buffer[len - 5] == '#');
+      EXPECT(jd_serialize_to_buffer(tree, NULL, 0, settings[i]) == len);
+      free(file_text);
+      free(buffer);
+   }
+
+   // Compact output of compact input is the same text:
+   char buffer[100];
+   EXPECT(jd_serialize_to_buffer(tree, buffer, sizeof(buffer), &compact) == strlen(json));
+   EXPECT(memcmp(buffer, json, strlen(json)) == 0);
+   jd_destroy(&tree);
+}
+
+/**
+ * @brief Tells if a tree serializes to the given text.
+ */
+bool serializes_as(const jd_Node *tree, const jd_SerializeOptions *options, const char *expected)
+{
+   char buffer[200];
+   size_t len = jd_serialize_to_buffer(tree, buffer, sizeof(buffer), options);
+   bool matched = len == strlen(expected) && memcmp(buffer, expected, len) == 0;
+   if (!matched && len <= sizeof(buffer))
+      printf("   Serialized as '%.*s'.\n", (int)len, buffer);
+   return matched;
+}
+
+/**
+ * @brief Find the value of a property of an object by its label.
+ */
+jd_Node *member(jd_Node *object, const char *label)
+{
+   for (jd_Node *property = jd_get_relation(object, JD_FIRST);
+        property;
+        property = jd_get_relation(property, JD_NEXT))
+   {
+      if (text_is(jd_get_relation(property, JD_FIRST), label))
+         return jd_get_relation(property, JD_LAST);
+   }
+   return NULL;
+}
+
+/**
+ * @brief Unchanged collections are copied from the source, and
+ *        edited ones and their ancestors are written from their nodes.
+ */
+void test_span_reemission(void)
+{
+   const char *json = "{ \"kept\" : [ 1,  2 ],\n  \"changed\" : { \"x\" :  true },\n  \"cut\" : [ 3 , 4 ] }";
+   jd_SerializeOptions spans = { 0, true };
+   jd_Node *tree = parse_text(json, JD_PARSE_KEEP_SPANS);
+   if (tree == NULL)
+      return;
+
+   EXPECT(serializes_as(tree, &spans, json));
+
+   jd_Node *kept = member(tree, "kept");
+   jd_Node *cut = member(tree, "cut");
+   EXPECT(jd_Node_set_false(member(member(tree, "changed"), "x")));
+   EXPECT(serializes_as(tree, &spans, "{\"kept\":[ 1,  2 ],\"changed\":{\"x\":false},\"cut\":[ 3 , 4 ]}"));
+
+   // Adding and removing members are changes, too:
+   jd_Node *added, *removed = jd_get_relation(cut, JD_FIRST);
+   EXPECT(jd_Node_create(&added, kept, NULL, NULL) && jd_Node_set_true(added));
+   jd_Node_emancipate(removed);
+   jd_destroy(&removed);
+   EXPECT(serializes_as(tree, &spans, "{\"kept\":[1,2,true],\"changed\":{\"x\":false},\"cut\":[4]}"));
+   jd_destroy(&tree);
+
+   // Without kept spans, there is nothing to copy:
+   tree = parse_text(json, JD_PARSE_DEFAULT);
+   if (tree)
+   {
+      EXPECT(serializes_as(tree, &spans, "{\"kept\":[1,2],\"changed\":{\"x\":true},\"cut\":[3,4]}"));
+      jd_destroy(&tree);
+   }
+}
+
+/**
+ * @brief Make an object of @b count properties, "k0" to "k<count-1>",
+ *        whose values are their numbers, followed by two properties
+ *        labeled "dup" with values 1 and 2.
+ * @return JSON text, to be freed
+ */
+char *numbered_object(int count)
+{
+   char *json = (char*)malloc(count * 24 + 32);
+   char *ptr = json;
+   *ptr++ = '{';
+   for (int i = 0; i < count; ++i)
+      ptr += sprintf(ptr, "\"k%d\":%d,", i, i);
+   strcpy(ptr, "\"dup\":1,\"dup\":2}");
+   return json;
+}
+
+/**
+ * @brief Tells if jd_find_property finds the property @b label
+ *        of @b object with the value @b value.
+ */
+bool property_is(const jd_Node *object, const char *label, const char *value)
+{
+   jd_Node *property = jd_find_property(object, label);
+   return property
+      && text_is(jd_get_relation(property, JD_FIRST), label)
+      && text_is(jd_get_relation(property, JD_LAST), value);
+}
+
+/**
+ * @brief A frozen tree finds the same properties as the original,
+ *        refuses changes, and lives until its last holder lets go.
+ */
+void test_freeze(void)
+{
+   char *json = numbered_object(100);
+   jd_Node *tree = parse_text(json, JD_PARSE_DEFAULT);
+   free(json);
+   if (tree == NULL)
+      return;
+
+   EXPECT(property_is(tree, "k42", "42"));
+
+   // A subtree is refused, and its siblings are left alone:
+   jd_Node *middle = jd_get_relation(jd_find_property(tree, "k50"), JD_LAST);
+   EXPECT(!jd_freeze(&middle) && !jd_is_frozen(middle));
+   EXPECT(property_is(tree, "k51", "51") && property_is(tree, "dup", "1"));
+   EXPECT(!jd_is_frozen(tree) && jd_freeze(&tree) && jd_is_frozen(tree));
+
+   int found = 0;
+   char label[16], value[16];
+   for (int i = 0; i < 100; ++i)
+   {
+      sprintf(label, "k%d", i);
+      sprintf(value, "%d", i);
+      found += property_is(tree, label, value);
+   }
+   EXPECT(found == 100);
+   EXPECT(property_is(tree, "dup", "1"));
+   EXPECT(jd_find_property(tree, "k100") == NULL);
+   EXPECT(jd_find_property(tree, "") == NULL);
+
+   // Freezing again changes nothing, and changes are refused:
+   jd_Node *frozen = tree, *added;
+   jd_Node *value_k0 = jd_get_relation(jd_find_property(tree, "k0"), JD_LAST);
+   EXPECT(jd_freeze(&tree) && tree == frozen);
+   EXPECT(!jd_Node_set_true(value_k0));
+   EXPECT(!jd_Node_emancipate(value_k0));
+   EXPECT(!jd_Node_create(&added, tree, NULL, NULL));
+   EXPECT(property_is(tree, "k0", "0"));
+
+   // The tree lives until each holder releases it:
+   EXPECT(jd_retain(tree) == tree);
+   jd_release(tree);
+   EXPECT(property_is(tree, "k7", "7"));
+   jd_release(tree);
+}
+
+/**
+ * @brief A copy outlives the buffer of its original, a branch copy
+ *        stands alone, and a change to one copy leaves the other be.
+ */
+void test_clone(void)
+{
+   const char *json = "{\"name\":\"first\",\"list\":[1,\"two\",null]}";
+   size_t len = strlen(json);
+   char *buffer = (char*)malloc(len + 1);
+   memcpy(buffer, json, len + 1);
+
+   jd_SerializeOptions compact = { 0 };
+   jd_Node *tree = parse_text(buffer, JD_PARSE_ZERO_COPY | JD_PARSE_TAKE_BUFFER);
+   if (tree == NULL)
+      return;
+
+   jd_Node *copy = jd_clone(tree);
+   jd_Node *branch = jd_clone(member(tree, "list"));
+   jd_destroy(&tree);
+
+   EXPECT(copy != NULL && branch != NULL);
+   if (copy == NULL || branch == NULL)
+      return;
+
+   EXPECT(serializes_as(copy, &compact, json));
+   EXPECT(serializes_as(branch, &compact, "[1,\"two\",null]"));
+   EXPECT(jd_get_relation(branch, JD_PARENT) == NULL);
+
+   // Changing the copy of the list leaves the whole copy alone:
+   EXPECT(jd_Node_set_true(jd_get_relation(branch, JD_FIRST)));
+   EXPECT(serializes_as(branch, &compact, "[true,\"two\",null]"));
+   EXPECT(text_is(member(copy, "name"), "first"));
+   EXPECT(serializes_as(copy, &compact, json));
+
+   // A copy of a frozen tree is frozen, and finds its properties:
+   EXPECT(jd_freeze(&copy));
+   jd_Node *frozen = jd_clone(copy);
+   jd_destroy(&copy);
+   EXPECT(jd_is_frozen(frozen));
+   EXPECT(property_is(frozen, "name", "first"));
+   EXPECT(serializes_as(frozen, &compact, json));
+
+   jd_destroy(&frozen);
+   jd_destroy(&branch);
+}
+
+/**
+ * @brief Replace the contents of a file, and set its modification
+ *        time to @b seconds after the epoch.
+ */
+bool rewrite_file(const char *path, const char *text, time_t seconds)
+{
+   FILE *file = fopen(path, "w");
+   if (file == NULL)
+      return false;
+   bool written = fputs(text, file) >= 0;
+   written = fclose(file) == 0 && written;
+
+   struct timespec times[2] = { { seconds, 0 }, { seconds, 0 } };
+   return written && utimensat(AT_FDCWD, path, times, 0) == 0;
+}
+
+/**
+ * @brief The cache answers repeated opens with the same frozen
+ *        tree, and parses the file again once its modification
+ *        time changes, even if its size does not.
+ */
+void test_cache_invalidation(void)
+{
+   char path[] = "/tmp/jd_cacheXXXXXX";
+   int fd = mkstemp(path);
+   EXPECT(fd >= 0);
+   if (fd < 0)
+      return;
+   close(fd);
+
+   jd_cache_clear();
+   jd_CacheStats before, after;
+   jd_cache_stats(&before);
+
+   jd_Node *first = NULL, *second = NULL, *third = NULL;
+   jd_ParseError pe;
+   EXPECT(rewrite_file(path, "{\"v\":1}", 1000000000));
+   EXPECT(jd_cache_open(path, &first, &pe));
+   EXPECT(jd_cache_open(path, &second, &pe));
+   EXPECT(first && first == second && jd_is_frozen(first));
+
+   jd_cache_stats(&after);
+   EXPECT(after.misses == before.misses + 1);
+   EXPECT(after.hits == before.hits + 1);
+   EXPECT(after.entries == 1 && after.bytes > 0);
+
+   // Same size, later modification time:
+   EXPECT(rewrite_file(path, "{\"v\":2}", 1000000060));
+   EXPECT(jd_cache_open(path, &third, &pe));
+   EXPECT(third && third != first);
+   EXPECT(property_is(third, "v", "2"));
+
+   // The old tree lives on for its holders:
+   EXPECT(property_is(first, "v", "1"));
+   jd_cache_stats(&after);
+   EXPECT(after.misses == before.misses + 2 && after.entries == 1);
+
+   // A file that no longer parses is refused, and not cached:
+   EXPECT(rewrite_file(path, "{\"v\":}", 1000000120));
+   jd_Node *broken = NULL;
+   EXPECT(!jd_cache_open(path, &broken, &pe) && broken == NULL && pe.message);
+
+   unlink(path);
+   EXPECT(!jd_cache_open(path, &broken, &pe) && broken == NULL);
+
+   jd_release(first);
+   jd_release(second);
+   jd_release(third);
+   jd_cache_clear();
+   jd_cache_stats(&after);
+   EXPECT(after.entries == 0 && after.bytes == 0);
+}
+
+/**
+ * @brief Sum of the node and payload bytes of every type.
+ */
+size_t usage_sum(const jd_MemoryUsage *usage)
+{
+   size_t sum = 0;
+   for (int type = 0; type <= JD_OBJECT; ++type)
+      sum += usage->node_bytes[type] + usage->payload_bytes[type];
+   return sum;
+}
+
+/**
+ * @brief Nodes are counted by type at the size of a jd_Node,
+ *        payloads only where the tree owns them, and the parts
+ *        add up to the total.
+ */
+void test_memory_usage(void)
+{
+   const char *json = "{\"s\":\"abc\",\"n\":12,\"a\":[true,false,null],\"o\":{}}";
+   jd_Node *tree = parse_text(json, JD_PARSE_DEFAULT);
+   if (tree == NULL)
+      return;
+
+   jd_MemoryUsage usage;
+   jd_memory_usage(tree, &usage);
+   EXPECT(usage.nodes[JD_OBJECT] == 2 && usage.nodes[JD_PROPERTY] == 4);
+   EXPECT(usage.nodes[JD_ARRAY] == 1 && usage.nodes[JD_STRING] == 1);
+   EXPECT(usage.nodes[JD_INTEGER] == 1 && usage.nodes[JD_FLOAT] == 0);
+   EXPECT(usage.nodes[JD_TRUE] == 1 && usage.nodes[JD_FALSE] == 1 && usage.nodes[JD_NULL] == 1);
+
+   bool sized = true;
+   for (int type = 0; type <= JD_OBJECT; ++type)
+      sized = sized && usage.node_bytes[type] == usage.nodes[type] * sizeof(jd_Node);
+   EXPECT(sized);
+
+   // Four labels, "abc" and "12", each with its NUL:
+   EXPECT(usage.payload_bytes[JD_PROPERTY] == 8);
+   EXPECT(usage.payload_bytes[JD_STRING] == 4 && usage.payload_bytes[JD_INTEGER] == 3);
+   EXPECT(usage.payload_bytes[JD_OBJECT] == 0 && usage.index_bytes == 0);
+
+   // Parsed without keeping its source, the tree is no document:
+   EXPECT(usage.document_bytes == 0 && usage.overhead_bytes > 0);
+   EXPECT(usage.total_bytes == usage_sum(&usage) + usage.document_bytes
+          + usage.source_bytes + usage.overhead_bytes);
+
+   // A subtree has no document:
+   jd_MemoryUsage branch;
+   jd_memory_usage(jd_get_relation(jd_find_property(tree, "a"), JD_LAST), &branch);
+   EXPECT(branch.nodes[JD_ARRAY] == 1 && branch.nodes[JD_PROPERTY] == 0);
+   EXPECT(branch.node_bytes[JD_TRUE] == sizeof(jd_Node));
+   EXPECT(branch.document_bytes == 0 && branch.source_bytes == 0);
+   EXPECT(branch.total_bytes == usage_sum(&branch) + branch.overhead_bytes);
+
+   // Frozen, the same nodes and text, and an index for each object:
+   EXPECT(jd_freeze(&tree));
+   jd_MemoryUsage frozen;
+   jd_memory_usage(tree, &frozen);
+   EXPECT(memcmp(frozen.nodes, usage.nodes, sizeof(usage.nodes)) == 0);
+   EXPECT(frozen.payload_bytes[JD_PROPERTY] == 8);
+   EXPECT(frozen.index_bytes > 0);
+   EXPECT(frozen.total_bytes == usage_sum(&frozen) + frozen.index_bytes
+          + frozen.document_bytes + frozen.source_bytes + frozen.overhead_bytes);
+   jd_release(tree);
+
+   // A document keeps the buffer it took, and text left in it
+   // is counted with the source:
+   size_t len = strlen(json);
+   char *buffer = (char*)malloc(len);
+   memcpy(buffer, json, len);
+   jd_ParseError pe;
+   tree = NULL;
+   EXPECT(jd_parse_buffer(buffer, len, JD_PARSE_ZERO_COPY | JD_PARSE_TAKE_BUFFER, &tree, &pe));
+   if (tree)
+   {
+      jd_memory_usage(tree, &usage);
+      EXPECT(usage.source_bytes == len && usage.document_bytes > 0);
+      EXPECT(usage.payload_bytes[JD_STRING] == 0 && usage.payload_bytes[JD_PROPERTY] == 0);
+      jd_destroy(&tree);
+   }
+
+   jd_MemoryUsage empty;
+   memset(&empty, 0xff, sizeof(empty));
+   jd_memory_usage(NULL, &empty);
+   EXPECT(empty.total_bytes == 0 && empty.nodes[JD_OBJECT] == 0 && usage_sum(&empty) == 0);
+}
+
+/**
+ * @brief The first child of a property is its label, a string
+ *        followed by the value, though the property keeps the
+ *        label text itself.
+ */
+void test_property_relations(void)
+{
+   jd_Node *tree = parse_text("{\"name\":\"value\",\"list\":[1,2]}", JD_PARSE_DEFAULT);
+   if (tree == NULL)
+      return;
+
+   jd_Node *name = jd_get_relation(tree, JD_FIRST);
+   jd_Node *label = jd_get_relation(name, JD_FIRST);
+   jd_Node *value = jd_get_relation(name, JD_LAST);
+   EXPECT(jd_id_type(name) == JD_PROPERTY && text_is(name, "name:value"));
+   EXPECT(jd_id_type(label) == JD_STRING && strcmp(jd_id_name(label), "string") == 0);
+   EXPECT(text_is(label, "name") && jd_node_value_length(label) == 5);
+   EXPECT(jd_id_type(value) == JD_STRING && text_is(value, "value"));
+
+   // The label and the value are siblings:
+   EXPECT(jd_get_relation(label, JD_NEXT) == value && nextSibling(label) == value);
+   EXPECT(jd_get_relation(value, JD_PREVIOUS) == label && prevSibling(value) == label);
+   EXPECT(jd_get_relation(label, JD_PARENT) == name && jd_get_relation(value, JD_PARENT) == name);
+   EXPECT(jd_get_relation(label, JD_PREVIOUS) == NULL && jd_get_relation(value, JD_NEXT) == NULL);
+   EXPECT(jd_get_relation(label, JD_FIRST) == NULL && jd_get_relation(label, JD_LAST) == NULL);
+   EXPECT(firstChild(name) == label && lastChild(name) == value);
+
+   // The elements of an array have no label before them:
+   jd_Node *list = jd_get_relation(jd_get_relation(tree, JD_LAST), JD_LAST);
+   EXPECT(jd_id_type(list) == JD_ARRAY && text_is(jd_get_relation(list, JD_FIRST), "1"));
+   EXPECT(jd_get_relation(jd_get_relation(list, JD_FIRST), JD_PREVIOUS) == NULL);
+
+   // A label reads as a string, but is no tree of its own:
+   jd_SerializeOptions compact = { 0 };
+   EXPECT(serializes_as(label, &compact, "\"name\""));
+   jd_Node *copy = jd_clone(label);
+   EXPECT(copy && text_is(copy, "name") && jd_get_relation(copy, JD_PARENT) == NULL);
+   jd_destroy(&copy);
+   EXPECT(jd_find_property(label, "name") == NULL && jd_retain(label) == NULL);
+   jd_Node *held = label;
+   EXPECT(!jd_freeze(&held) && held == label);
+   jd_destroy(&held);
+   jd_MemoryUsage usage;
+   jd_memory_usage(label, &usage);
+   EXPECT(usage.total_bytes == 0);
+   EXPECT(jd_get_relation(name, JD_FIRST) == label && text_is(label, "name"));
+
+   // Frozen, the layout is the same:
+   EXPECT(jd_freeze(&tree));
+   name = jd_find_property(tree, "name");
+   label = jd_get_relation(name, JD_FIRST);
+   EXPECT(text_is(label, "name") && jd_is_frozen(label));
+   EXPECT(jd_get_relation(label, JD_NEXT) == jd_get_relation(name, JD_LAST));
+   EXPECT(text_is(jd_get_relation(label, JD_NEXT), "value"));
+   jd_release(tree);
+}
+
+/** Blocks held from counting_alloc and counting_realloc */
+int live_blocks = 0;
+
+void *counting_alloc(void *user, size_t size)
+{
+   ++live_blocks;
+   return malloc(size);
+}
+
+void *counting_realloc(void *user, void *ptr, size_t size)
+{
+   void *block = realloc(ptr, size);
+   if (ptr == NULL && block)
+      ++live_blocks;
+   return block;
+}
+
+void counting_free(void *user, void *ptr)
+{
+   if (ptr)
+      --live_blocks;
+   free(ptr);
+}
+
+/**
+ * @brief Releasing a member frees only it and its descendants,
+ *        back to the allocator of its document.
+ */
+void test_release_subtree(void)
+{
+   const jd_Allocator counting = { counting_alloc, counting_realloc, counting_free, NULL };
+   jd_Context ctx;
+   jd_context_init(&ctx);
+   ctx.allocator = &counting;
+
+   const char *json = "{\"list\":[1,[2,22],3],\"after\":true}";
+   jd_Node *tree = NULL;
+   EXPECT(jd_ctx_parse_buffer(&ctx, json, strlen(json), JD_PARSE_DEFAULT, &tree));
+   if (tree == NULL)
+      return;
+
+   jd_SerializeOptions compact = { 0 };
+   int before = live_blocks;
+   jd_Node *list = member(tree, "list");
+   jd_release(jd_get_relation(jd_get_relation(list, JD_FIRST), JD_NEXT));
+   EXPECT(serializes_as(tree, &compact, "{\"list\":[1,3],\"after\":true}"));
+   EXPECT(live_blocks < before);
+
+   // The last member, too, leaves its parent whole:
+   jd_release(jd_get_relation(list, JD_LAST));
+   EXPECT(serializes_as(tree, &compact, "{\"list\":[1],\"after\":true}"));
+
+   jd_destroy(&tree);
+   EXPECT(live_blocks == 0);
+}
+
+/**
+ * @brief Position of @b node among @b count nodes, or
+ *        #JD_COMPACT_NONE if it is not one of them.
+ */
+uint32_t node_index(jd_Node **nodes, uint32_t count, const jd_Node *node)
+{
+   for (uint32_t i = 0; i < count; ++i)
+      if (nodes[i] == node)
+         return i;
+   return JD_COMPACT_NONE;
+}
+
+/**
+ * @brief A compact copy has the nodes of its original in document
+ *        order, with the same types, text and relations, and finds
+ *        the same properties.
+ */
+void test_compact(void)
+{
+   const char *json = "{\"a\":1,\"\":\"empty\",\"b\":{\"c\":[\"a\",true,null],\"d\":{}},"
+      "\"a\":2,\"e\":\"x\\ty\"}";
+   jd_Node *tree = parse_text(json, JD_PARSE_DEFAULT);
+   if (tree == NULL)
+      return;
+
+   jd_Compact *doc = jd_compact(tree);
+   EXPECT(doc != NULL);
+   if (doc == NULL)
+   {
+      jd_destroy(&tree);
+      return;
+   }
+
+   // Gather the original in document order, passing over the
+   // labels, which compact properties keep as their own text:
+   jd_Node *nodes[32];
+   uint32_t count = 0;
+   for (jd_Node *node = tree; node && count < 32; )
+   {
+      nodes[count++] = node;
+      bool property = jd_id_type(node) == JD_PROPERTY;
+      jd_Node *next = jd_get_relation(node, property ? JD_LAST : JD_FIRST);
+      while (next == NULL && node)
+      {
+         next = jd_get_relation(node, JD_NEXT);
+         node = jd_get_relation(node, JD_PARENT);
+      }
+      node = next;
+   }
+   EXPECT(count == 18 && jd_compact_count(doc) == count);
+
+   const jd_Relation relations[] = { JD_PARENT, JD_NEXT, JD_FIRST, JD_PREVIOUS, JD_LAST };
+   int mismatches = 0;
+   for (uint32_t i = 0; i < count && i < jd_compact_count(doc); ++i)
+   {
+      size_t len, compact_len;
+      const char *text = jd_node_text(nodes[i], &len);
+      const char *compact_text = jd_compact_text(doc, i, &compact_len);
+
+      bool same = jd_compact_type(doc, i) == jd_id_type(nodes[i]);
+      if (text && jd_id_type(nodes[i]) != JD_ARRAY && jd_id_type(nodes[i]) != JD_OBJECT)
+         same = same && compact_text && compact_len == len && memcmp(text, compact_text, len) == 0;
+      for (int r = 0; r < 5; ++r)
+      {
+         jd_Relation relation = relations[r];
+         if (relation == JD_FIRST && jd_id_type(nodes[i]) == JD_PROPERTY)
+            relation = JD_LAST;
+         same = same && jd_compact_relation(doc, i, relations[r])
+            == node_index(nodes, count, jd_get_relation(nodes[i], relation));
+      }
+      mismatches += !same;
+   }
+   EXPECT(mismatches == 0);
+
+   // Properties are found by label, the first of duplicates, and
+   // reach their values through JD_FIRST:
+   uint32_t a = jd_compact_find_property(doc, 0, "a");
+   EXPECT(a == node_index(nodes, count, jd_find_property(tree, "a")));
+   EXPECT(strcmp(jd_compact_text(doc, jd_compact_relation(doc, a, JD_FIRST), NULL), "1") == 0);
+   EXPECT(jd_compact_relation(doc, a, JD_FIRST) == jd_compact_relation(doc, a, JD_LAST));
+
+   uint32_t empty = jd_compact_find_property(doc, 0, "");
+   EXPECT(empty != JD_COMPACT_NONE && jd_compact_type(doc, empty) == JD_PROPERTY);
+   EXPECT(empty != JD_COMPACT_NONE
+          && strcmp(jd_compact_text(doc, jd_compact_relation(doc, empty, JD_FIRST), NULL), "empty") == 0);
+
+   uint32_t b = jd_compact_relation(doc, jd_compact_find_property(doc, 0, "b"), JD_FIRST);
+   EXPECT(jd_compact_type(doc, b) == JD_OBJECT);
+   uint32_t c = jd_compact_relation(doc, jd_compact_find_property(doc, b, "c"), JD_FIRST);
+   EXPECT(jd_compact_type(doc, c) == JD_ARRAY);
+   EXPECT(jd_compact_find_property(doc, b, "a") == JD_COMPACT_NONE);
+
+   uint32_t e = jd_compact_find_property(doc, 0, "e");
+   EXPECT(strcmp(jd_compact_text(doc, jd_compact_relation(doc, e, JD_FIRST), NULL), "x\ty") == 0);
+
+   // Nothing is found for a missing label, nor in an array holding
+   // a matching string, a property, an empty object, or past the
+   // last node:
+   EXPECT(jd_compact_find_property(doc, 0, "z") == JD_COMPACT_NONE);
+   EXPECT(jd_compact_find_property(doc, c, "a") == JD_COMPACT_NONE);
+   EXPECT(jd_compact_find_property(doc, a, "a") == JD_COMPACT_NONE);
+   uint32_t d = jd_compact_relation(doc, jd_compact_find_property(doc, b, "d"), JD_FIRST);
+   EXPECT(jd_compact_type(doc, d) == JD_OBJECT && jd_compact_find_property(doc, d, "") == JD_COMPACT_NONE);
+   EXPECT(jd_compact_find_property(doc, count, "a") == JD_COMPACT_NONE);
+   EXPECT(jd_compact_find_property(doc, 0, NULL) == JD_COMPACT_NONE);
+   EXPECT(jd_compact_relation(doc, count, JD_PARENT) == JD_COMPACT_NONE);
+
+   EXPECT(jd_compact_size(doc) > 0 && jd_compact_size(NULL) == 0);
+   jd_compact_destroy(doc);
+   jd_destroy(&tree);
+}
+
+/**
+ * @brief A check, with its name for the report.
+ */
+typedef struct api_test_s {
+   const char *name;
+   void (*run)(void);
+} api_test;
+
+api_test tests[] = {
+   { "zero-copy parse with JD_PARSE_TAKE_BUFFER", test_zero_copy },
+   { "jd_serialize_to_buffer and jd_serialized_length", test_serialize_to_buffer },
+   { "serializing from kept spans after edits", test_span_reemission },
+   { "jd_freeze and jd_find_property", test_freeze },
+   { "jd_clone", test_clone },
+   { "jd_cache_open after a file changes", test_cache_invalidation },
+   { "jd_memory_usage", test_memory_usage },
+   { "labels and values of properties", test_property_relations },
+   { "jd_release of a member", test_release_subtree },
+   { "jd_compact and jd_compact_find_property", test_compact },
+   { NULL, NULL }
+};
+
+int main(void)
+{
+   for (const api_test *test = tests; test->name; ++test)
+   {
+      int before = failures;
+      printf("\033[32;1m%s\033[39;22m\n", test->name);
+      (*test->run)();
+      if (failures == before)
+         printf("   passed\n");
+   }
+
+   if (failures)
+      printf("\033[31;1m%d expectations failed.\033[39;22m\n", failures);
+   else
+      printf("All checks passed.\n");
+
+   return failures ? 1 : 0;
+}
@@ -0,0 +1,646 @@
+/**
+ * @file test_binary.c
+ * @brief Checks of saving and reloading trees, and of the
+ *        rejection of damaged files.
+ *
+ * Each check saves a tree to a temporary file, reloads it, and
+ * then damages copies of the file one way at a time, expecting
+ * each to be refused with the right description and offset.
+ * Failed expectations print their line and condition, and the
+ * program exits with 1 if there were any:
+ *    make test && ./binary
+ */
+
+/** Enable usage of mkstemp and pipe: */
+#define _POSIX_C_SOURCE 200809L
+
+#include "jsondom.h"
+#include "JBinary.h"  // for the layout of binary files
+#include "JSnapshot.h"  // for the layout of snapshots
+#include <stdio.h>
+#include <stdlib.h>   // for malloc/free, mkstemp
+#include <string.h>   // for strlen, memcmp, memcpy
+#include <unistd.h>   // for read, write, close, unlink, lseek
+#include <fcntl.h>    // for open()
+#include <stdbool.h>
+#include <stdint.h>   // for uint64_t
+#include <stddef.h>   // for offsetof
+
+/** Number of failed expectations */
+int failures = 0;
+
+/**
+ * @brief Record the result of an expectation, printing it if it failed.
+ */
+void expect(bool passed, const char *condition, int line)
+{
+   if (!passed)
+   {
+      printf("   \033[31;1mFAILED\033[39;22m at line %d: %s\n", line, condition);
+      ++failures;
+   }
+}
+
+#define EXPECT(cond) expect((cond), #cond, __LINE__)
+
+/** Temporary file used by every check, removed at exit */
+char temp_path[] = "/tmp/jd_test_XXXXXX";
+
+/**
+ * @brief Replace the temporary file with @b len bytes of @b data.
+ * @return Handle to the file, open for reading at its start
+ */
+int write_temp(const char *data, size_t len)
+{
+   int fd = open(temp_path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+   if (fd >= 0)
+   {
+      if (write(fd, data, len) != (ssize_t)len)
+         printf("   Failed to write '%s'.\n", temp_path);
+      lseek(fd, 0, SEEK_SET);
+   }
+   return fd;
+}
+
+/**
+ * @brief Read the whole temporary file.
+ * @return The contents, to be freed, with their length in @b len
+ */
+char *read_temp(size_t *len)
+{
+   int fd = open(temp_path, O_RDONLY);
+   if (fd < 0)
+      return NULL;
+
+   off_t size = lseek(fd, 0, SEEK_END);
+   char *data = (char*)malloc(size);
+   lseek(fd, 0, SEEK_SET);
+   if (data && read(fd, data, size) != size)
+   {
+      free(data);
+      data = NULL;
+   }
+
+   close(fd);
+   *len = (size_t)size;
+   return data;
+}
+
+/**
+ * @brief Tells if a tree serializes to the given text.
+ */
+bool serializes_as(const jd_Node *tree, const char *expected)
+{
+   jd_SerializeOptions compact = { 0, false };
+   char buffer[400];
+   size_t len = jd_serialize_to_buffer(tree, buffer, sizeof(buffer), &compact);
+   return len == strlen(expected) && memcmp(buffer, expected, len) == 0;
+}
+
+/**
+ * @brief Parse a string, reporting a failure to do so.
+ */
+jd_Node *parse_text(const char *text, unsigned int options)
+{
+   jd_Node *tree = NULL;
+   jd_ParseError pe;
+   if (!jd_parse_buffer(text, strlen(text), options, &tree, &pe))
+   {
+      printf("   Failed to parse '%s': %s.\n", text, pe.message);
+      ++failures;
+   }
+   return tree;
+}
+
+/**
+ * @brief Save a tree in the binary format and read the file back.
+ * @return The contents of the file, to be freed, with their length in @b len
+ */
+char *save_binary(const char *json, unsigned int options, size_t *len)
+{
+   jd_Node *tree = parse_text(json, options);
+   if (tree == NULL)
+      return NULL;
+
+   int fd = write_temp("", 0);
+   bool saved = fd >= 0 && jd_save_binary(fd, tree);
+   EXPECT(saved);
+   if (fd >= 0)
+      close(fd);
+   jd_destroy(&tree);
+
+   return saved ? read_temp(len) : NULL;
+}
+
+/**
+ * @brief Store a little-endian number of @b size bytes.
+ */
+void put_fixed(char *data, uint64_t value, size_t size)
+{
+   for (size_t i = 0; i < size; ++i)
+      data[i] = (char)(value >> (8 * i));
+}
+
+/**
+ * @brief Recompute the checksum of a binary file after its node
+ *        records were changed, so the loader looks further.
+ */
+void fix_checksum(char *data, size_t len)
+{
+   uint32_t a = 0, b = 0;
+   for (size_t i = JB_HEADER_SIZE; i < len - JB_TRAILER_SIZE; ++i)
+   {
+      a += (unsigned char)data[i];
+      b += a;
+   }
+   put_fixed(data + len - 8, ((uint64_t)b << 32) | a, 8);
+}
+
+/**
+ * @brief Load a binary file and expect it to be refused.
+ * @param offset  expected jd_ParseError::char_loc, or -1 for any
+ */
+void expect_refused(const char *data, size_t len, const char *message, int offset, int line)
+{
+   jd_Node *tree = (jd_Node*)1;
+   jd_ParseError pe = { 0 };
+   int fd = write_temp(data, len);
+   bool loaded = jd_load_binary(fd, &tree, &pe);
+   close(fd);
+
+   bool passed = !loaded && tree == NULL
+      && (message == NULL || (pe.message && strcmp(pe.message, message) == 0))
+      && (offset < 0 || pe.char_loc == offset);
+   if (!passed)
+      printf("   Got '%s' at %d.\n", loaded ? "success" : pe.message, pe.char_loc);
+   expect(passed, message ? message : "refused", line);
+
+   if (loaded)
+      jd_destroy(&tree);
+}
+
+#define EXPECT_REFUSED(data, len, message, offset) \
+   expect_refused(data, len, message, offset, __LINE__)
+
+/**
+ * @brief A binary file reloads as the tree that was saved, from a
+ *        regular file or a pipe.
+ */
+void test_binary_round_trip(void)
+{
+   const char *json =
+      "{\"s\":\"a\\tb\\u00e9\",\"n\":[1,-2.5e3,0,true,false,null],"
+      "\"o\":{\"\":{},\"e\":[]},\"r\":\"x\\\\y\"}";
+   const char *raw =
+      "{\"s\":\"a\\tb\\u00e9\",\"r\":\"x\\\\y\"}";
+
+   size_t len;
+   char *data = save_binary(json, JD_PARSE_DEFAULT, &len);
+   if (data == NULL)
+      return;
+
+   jd_Node *tree = NULL;
+   jd_ParseError pe;
+   int fd = write_temp(data, len);
+   EXPECT(jd_load_binary(fd, &tree, &pe));
+   close(fd);
+   EXPECT(tree && serializes_as(tree, "{\"s\":\"a\\tb\xc3\xa9\",\"n\":[1,-2.5e3,0,true,false,null],"
+                                "\"o\":{\"\":{},\"e\":[]},\"r\":\"x\\\\y\"}"));
+   EXPECT(tree && jd_find_property(tree, "o") != NULL);
+   jd_destroy(&tree);
+
+   // Anything other than a regular file is read into memory:
+   int pipe_fds[2];
+   if (pipe(pipe_fds) == 0)
+   {
+      EXPECT(write(pipe_fds[1], data, len) == (ssize_t)len);
+      close(pipe_fds[1]);
+      EXPECT(jd_load_binary(pipe_fds[0], &tree, &pe));
+      close(pipe_fds[0]);
+      EXPECT(tree && jd_find_property(tree, "r") != NULL);
+      jd_destroy(&tree);
+   }
+   free(data);
+
+   // Strings keep their escapes if they were parsed with them:
+   data = save_binary(raw, JD_PARSE_RAW_ESCAPES, &len);
+   if (data)
+   {
+      fd = write_temp(data, len);
+      EXPECT(jd_load_binary(fd, &tree, &pe));
+      close(fd);
+      EXPECT(tree && serializes_as(tree, raw));
+      jd_destroy(&tree);
+      free(data);
+   }
+}
+
+/**
+ * @brief Every damaged header, trailer or record is refused,
+ *        with the offset at which it was found.
+ */
+void test_binary_damage(void)
+{
+   // Records: array 6 with 1 child, string 3 with payload length 3, "abc" and a NUL
+   size_t len;
+   char *data = save_binary("[\"abc\"]", JD_PARSE_DEFAULT, &len);
+   if (data == NULL)
+      return;
+
+   const size_t records = JB_HEADER_SIZE;
+   const size_t end = len - JB_TRAILER_SIZE;
+   EXPECT(len == records + 8 + JB_TRAILER_SIZE);
+   EXPECT(data[records] == JD_ARRAY && data[records + 1] == 1);
+   EXPECT((data[records + 2] & 0x0F) == JD_STRING && data[records + 3] == 3);
+
+   char *copy = (char*)malloc(len);
+
+   // Every truncation is refused:
+   int accepted = 0;
+   for (size_t short_len = 0; short_len < len; ++short_len)
+   {
+      jd_Node *tree = NULL;
+      jd_ParseError pe;
+      int fd = write_temp(data, short_len);
+      if (jd_load_binary(fd, &tree, &pe))
+      {
+         ++accepted;
+         jd_destroy(&tree);
+      }
+      close(fd);
+   }
+   EXPECT(accepted == 0);
+   EXPECT_REFUSED(data, JB_HEADER_SIZE, "file too short for a binary document", JB_HEADER_SIZE);
+
+   memcpy(copy, data, len);
+   copy[0] = 'J';
+   EXPECT_REFUSED(copy, len, "not a binary document", 0);
+
+   memcpy(copy, data, len);
+   put_fixed(copy + 8, JB_VERSION + 1, 4);
+   EXPECT_REFUSED(copy, len, "unsupported binary document version", 8);
+
+   memcpy(copy, data, len);
+   put_fixed(copy + end, 7, 8);
+   EXPECT_REFUSED(copy, len, "binary document length does not match its size", (int)end);
+
+   memcpy(copy, data, len);
+   copy[records + 4] = 'A';
+   EXPECT_REFUSED(copy, len, "binary document checksum mismatch", (int)(len - 8));
+
+   // With the checksum made good, the records themselves are checked:
+   memcpy(copy, data, len);
+   copy[records] = 0x0F;
+   fix_checksum(copy, len);
+   EXPECT_REFUSED(copy, len, "invalid node record", (int)records);
+
+   memcpy(copy, data, len);
+   copy[records + 2] = JD_PROPERTY;
+   fix_checksum(copy, len);
+   EXPECT_REFUSED(copy, len, "array element is a property", (int)(records + 2));
+
+   memcpy(copy, data, len);
+   copy[records + 3] = 9;
+   fix_checksum(copy, len);
+   EXPECT_REFUSED(copy, len, "invalid payload length", (int)(records + 4));
+
+   memcpy(copy, data, len);
+   copy[records + 3] = 2;
+   fix_checksum(copy, len);
+   EXPECT_REFUSED(copy, len, "invalid payload length", (int)(records + 4));
+
+   memcpy(copy, data, len);
+   copy[records + 1] = (char)0x81;
+   fix_checksum(copy, len);
+   EXPECT_REFUSED(copy, len, "invalid number of children", -1);
+
+   memcpy(copy, data, len);
+   copy[records + 1] = 2;
+   fix_checksum(copy, len);
+   EXPECT_REFUSED(copy, len, "binary document ends inside a collection", (int)end);
+
+   memcpy(copy, data, len);
+   copy[records + 1] = 0;
+   fix_checksum(copy, len);
+   EXPECT_REFUSED(copy, len, "unexpected data after the last node", (int)(records + 2));
+
+   memcpy(copy, data, len);
+   put_fixed(copy + 16, 3, 8);
+   EXPECT_REFUSED(copy, len, "node count does not match the header", (int)end);
+
+   free(copy);
+   free(data);
+
+   // Records: object 8 with 1 child, property 7 with 2, label "k", value "v"
+   data = save_binary("{\"k\":\"v\"}", JD_PARSE_DEFAULT, &len);
+   if (data == NULL)
+      return;
+
+   copy = (char*)malloc(len);
+   EXPECT(data[records] == JD_OBJECT && data[records + 2] == JD_PROPERTY);
+
+   memcpy(copy, data, len);
+   copy[records + 2] = JD_NULL;
+   fix_checksum(copy, len);
+   EXPECT_REFUSED(copy, len, "object member is not a property", (int)(records + 2));
+
+   memcpy(copy, data, len);
+   copy[records + 4] = JD_NULL;
+   fix_checksum(copy, len);
+   EXPECT_REFUSED(copy, len, "property label is not a string", (int)(records + 4));
+
+   memcpy(copy, data, len);
+   copy[records + 3] = 3;
+   fix_checksum(copy, len);
+   EXPECT_REFUSED(copy, len, "invalid number of children", -1);
+
+   free(copy);
+   free(data);
+}
+
+/**
+ * @brief Save a tree as a snapshot and read the file back.
+ * @return The contents of the file, to be freed, with their length in @b len
+ */
+char *save_snapshot(const char *json, size_t *len)
+{
+   jd_Node *tree = parse_text(json, JD_PARSE_DEFAULT);
+   if (tree == NULL)
+      return NULL;
+
+   int fd = write_temp("", 0);
+   bool saved = fd >= 0 && jd_snapshot_save(fd, tree);
+   EXPECT(saved);
+   if (fd >= 0)
+      close(fd);
+   jd_destroy(&tree);
+
+   return saved ? read_temp(len) : NULL;
+}
+
+/**
+ * @brief Open a snapshot written to the temporary file.
+ * @return The root, or NULL with @b pe describing the problem
+ */
+jd_Node *open_snapshot(const char *data, size_t len, jd_ParseError *pe)
+{
+   jd_Node *root = NULL;
+   int fd = write_temp(data, len);
+   close(fd);
+   jd_snapshot_open(temp_path, &root, pe);
+   return root;
+}
+
+/**
+ * @brief Open a snapshot and expect it to be refused.
+ */
+void expect_snapshot_refused(const char *data, size_t len, const char *message, int offset, int line)
+{
+   jd_ParseError pe = { 0 };
+   jd_Node *root = open_snapshot(data, len, &pe);
+
+   bool passed = root == NULL
+      && pe.message && strcmp(pe.message, message) == 0
+      && pe.char_loc == offset;
+   if (!passed)
+      printf("   Got '%s' at %d.\n", root ? "success" : pe.message, pe.char_loc);
+   expect(passed, message, line);
+
+   if (root)
+      jd_release(root);
+}
+
+#define EXPECT_SNAPSHOT_REFUSED(data, len, message, offset) \
+   expect_snapshot_refused(data, len, message, offset, __LINE__)
+
+/**
+ * @brief Open a snapshot whose nodes were damaged, and expect it
+ *        to open but fail jd_snapshot_verify.
+ */
+void expect_unsound(const char *data, size_t len, const char *damage, int line)
+{
+   jd_ParseError pe;
+   jd_Node *root = open_snapshot(data, len, &pe);
+   expect(root != NULL, "snapshot with damaged nodes opens", line);
+   if (root)
+   {
+      expect(!jd_snapshot_verify(root), damage, line);
+      jd_release(root);
+   }
+}
+
+#define EXPECT_UNSOUND(data, len, damage) expect_unsound(data, len, damage, __LINE__)
+
+/** Offset in a snapshot file of node @b number, 0 being the root */
+size_t node_place(size_t number)
+{
+   return JS_HEADER_SIZE + (number ? sizeof(jd_Document) + (number - 1) * sizeof(jd_Node) : 0);
+}
+
+/** Read a value of the type of @b value from @b data, which may not be aligned */
+#define GET_AT(data, place, value) memcpy(&(value), (data) + (place), sizeof(value))
+
+/** Store @b value at @b place in @b data, which may not be aligned */
+#define PUT_AT(data, place, value) memcpy((data) + (place), &(value), sizeof(value))
+
+/**
+ * @brief A snapshot opens as the tree that was saved, checks as
+ *        sound, and finds properties by its index.
+ */
+void test_snapshot_round_trip(void)
+{
+   const char *json = "{\"k\":\"v\",\"n\":[1,2.5,true],\"o\":{\"e\":\"a\\\\b\"}}";
+   size_t len;
+   char *data = save_snapshot(json, &len);
+   if (data == NULL)
+      return;
+
+   jd_ParseError pe;
+   jd_Node *root = open_snapshot(data, len, &pe);
+   EXPECT(root != NULL);
+   if (root)
+   {
+      EXPECT(jd_is_frozen(root));
+      EXPECT(jd_snapshot_verify(root));
+      EXPECT(serializes_as(root, json));
+      jd_Node *o = jd_get_relation(jd_find_property(root, "o"), JD_LAST);
+      EXPECT(jd_find_property(o, "e") != NULL);
+      EXPECT(jd_find_property(root, "x") == NULL);
+
+      // Labels are read from the offsets of their properties:
+      size_t len;
+      jd_Node *label = jd_get_relation(jd_find_property(root, "k"), JD_FIRST);
+      const char *text = jd_node_text(label, &len);
+      EXPECT(text && len == 1 && *text == 'k');
+      EXPECT(jd_get_relation(label, JD_NEXT) == jd_get_relation(jd_find_property(root, "k"), JD_LAST));
+      jd_release(root);
+   }
+
+   // Only snapshots can be verified:
+   jd_Node *tree = parse_text(json, JD_PARSE_DEFAULT);
+   EXPECT(tree && !jd_snapshot_verify(tree));
+   jd_destroy(&tree);
+
+   free(data);
+}
+
+/**
+ * @brief A snapshot with a damaged header is refused when it is
+ *        opened, and one with damaged nodes by jd_snapshot_verify.
+ */
+void test_snapshot_damage(void)
+{
+   // Nodes: object 0, property "k" 1, "v" 2, property "n" 3, array 4, 1 5
+   size_t len;
+   char *data = save_snapshot("{\"k\":\"v\",\"n\":[1]}", &len);
+   if (data == NULL)
+      return;
+
+   char *copy = (char*)malloc(len);
+   JSHeader header;
+   GET_AT(data, 0, header);
+   EXPECT(header.node_count == 6 && header.file_size == len);
+
+   jd_ParseError pe;
+   jd_Node *sound = open_snapshot(data, len, &pe);
+   EXPECT(sound && jd_snapshot_verify(sound));
+   jd_release(sound);
+
+   // Every truncation is refused:
+   int opened = 0;
+   for (size_t short_len = 0; short_len < len; ++short_len)
+   {
+      jd_Node *root = open_snapshot(data, short_len, &pe);
+      if (root)
+      {
+         ++opened;
+         jd_release(root);
+      }
+   }
+   EXPECT(opened == 0);
+   EXPECT_SNAPSHOT_REFUSED(data, JS_HEADER_SIZE, "file too short for a snapshot", JS_HEADER_SIZE);
+
+   memcpy(copy, data, len);
+   copy[0] = 'J';
+   EXPECT_SNAPSHOT_REFUSED(copy, len, "not a snapshot", 0);
+
+   JSHeader damaged = header;
+   damaged.version = JS_VERSION + 1;
+   memcpy(copy, data, len);
+   PUT_AT(copy, 0, damaged);
+   EXPECT_SNAPSHOT_REFUSED(copy, len, "unsupported snapshot version", 0);
+
+   damaged = header;
+   damaged.byte_order = 0x04030201;
+   PUT_AT(copy, 0, damaged);
+   EXPECT_SNAPSHOT_REFUSED(copy, len, "snapshot was written by a different kind of machine", 0);
+
+   damaged = header;
+   damaged.node_size = sizeof(jd_Node) + 8;
+   PUT_AT(copy, 0, damaged);
+   EXPECT_SNAPSHOT_REFUSED(copy, len, "snapshot was written by a different kind of machine", 0);
+
+   damaged = header;
+   damaged.node_count = len;
+   PUT_AT(copy, 0, damaged);
+   EXPECT_SNAPSHOT_REFUSED(copy, len, "snapshot size does not match its header", 0);
+
+   damaged = header;
+   damaged.index_bytes = len;
+   PUT_AT(copy, 0, damaged);
+   EXPECT_SNAPSHOT_REFUSED(copy, len, "snapshot size does not match its header", 0);
+
+   unsigned int flags;
+   memcpy(copy, data, len);
+   GET_AT(copy, node_place(0) + offsetof(jd_Node, flags), flags);
+   flags &= ~JDN_DOCUMENT;
+   PUT_AT(copy, node_place(0) + offsetof(jd_Node, flags), flags);
+   EXPECT_SNAPSHOT_REFUSED(copy, len, "snapshot root is not a document", JS_HEADER_SIZE);
+
+   // Damaged nodes open, but do not verify:
+   uintptr_t link;
+   memcpy(copy, data, len);
+   GET_AT(copy, node_place(1) + offsetof(jd_Node, parent), link);
+   link += 8;
+   PUT_AT(copy, node_place(1) + offsetof(jd_Node, parent), link);
+   EXPECT_UNSOUND(copy, len, "link between nodes");
+
+   memcpy(copy, data, len);
+   GET_AT(copy, node_place(4) + offsetof(jd_Node, firstChild), link);
+   link = -link;
+   PUT_AT(copy, node_place(4) + offsetof(jd_Node, firstChild), link);
+   EXPECT_UNSOUND(copy, len, "link back to an earlier node");
+
+   memcpy(copy, data, len);
+   link = 0;
+   PUT_AT(copy, node_place(4) + offsetof(jd_Node, lastChild), link);
+   EXPECT_UNSOUND(copy, len, "first child without a last child");
+
+   size_t length = len;
+   memcpy(copy, data, len);
+   PUT_AT(copy, node_place(2) + offsetof(jd_Node, length), length);
+   EXPECT_UNSOUND(copy, len, "payload length past the end of the file");
+
+   memcpy(copy, data, len);
+   GET_AT(copy, node_place(2) + offsetof(jd_Node, payload), link);
+   copy[node_place(2) + link + 1] = 'x';
+   EXPECT_UNSOUND(copy, len, "payload without its NUL");
+
+   jd_Type type = (jd_Type)12;
+   memcpy(copy, data, len);
+   PUT_AT(copy, node_place(5) + offsetof(jd_Node, type), type);
+   EXPECT_UNSOUND(copy, len, "node type");
+
+   size_t mask = 2;
+   memcpy(copy, data, len);
+   PUT_AT(copy, node_place(header.node_count), mask);
+   EXPECT_UNSOUND(copy, len, "index size");
+
+   free(copy);
+   free(data);
+}
+
+/**
+ * @brief A check, with its name for the report.
+ */
+typedef struct file_test_s {
+   const char *name;
+   void (*run)(void);
+} file_test;
+
+file_test tests[] = {
+   { "binary files reload as saved", test_binary_round_trip },
+   { "damaged binary files are refused", test_binary_damage },
+   { "snapshots open as saved", test_snapshot_round_trip },
+   { "damaged snapshots are refused", test_snapshot_damage },
+   { NULL, NULL }
+};
+
+int main(void)
+{
+   int fd = mkstemp(temp_path);
+   if (fd < 0)
+   {
+      printf("Failed to make a temporary file.\n");
+      return 1;
+   }
+   close(fd);
+
+   for (const file_test *test = tests; test->name; ++test)
+   {
+      int before = failures;
+      printf("\033[32;1m%s\033[39;22m\n", test->name);
+      (*test->run)();
+      if (failures == before)
+         printf("   passed\n");
+   }
+
+   unlink(temp_path);
+
+   if (failures)
+      printf("\033[31;1m%d expectations failed.\033[39;22m\n", failures);
+   else
+      printf("All checks passed.\n");
+
+   return failures ? 1 : 0;
+}
@@ -0,0 +1,288 @@
+/**
+ * @file test_strings.c
+ * @brief Table-driven checks of how string contents are read.
+ *
+ * Each case is parsed as the only member of an array with
+ * jd_parse_buffer, and the text of the string, or the rejection
+ * of the document, is compared with what the case expects.
+ * Failed cases are printed, and the program exits with 1 if
+ * there were any:
+ *    make test && ./strings
+ */
+#include "jsondom.h"
+#include <stdio.h>
+#include <stdlib.h>   // for malloc/free
+#include <string.h>   // for strlen, memcmp, memset
+#include <stdbool.h>
+
+/** Number of failed cases */
+int failures = 0;
+
+/**
+ * @brief Contents of a string and what parsing them should give.
+ */
+typedef struct string_case_s {
+   const char   *contents;  ///< text between the quotes
+   unsigned int options;    ///< #jd_ParseOption flags for the parse
+   const char   *text;      ///< expected text of the string, NULL if the parse must fail
+   size_t       length;     ///< expected length of the text, which may hold NULs
+} string_case;
+
+/**
+ * @brief Print a string, showing its bytes outside printable ASCII.
+ */
+void print_escaped(const char *str, size_t len)
+{
+   for (size_t i = 0; i < len; ++i)
+   {
+      unsigned char chr = (unsigned char)str[i];
+      if (chr < 0x20 || chr >= 0x7F)
+         printf("\\x%02x", chr);
+      else
+         putchar(chr);
+   }
+}
+
+/**
+ * @brief Parse the contents of a string, with @b len bytes, and
+ *        compare the outcome with @b text.
+ * @param offset  if not NULL, the expected jd_ParseError::char_loc
+ *                of a failed parse
+ * @return True if the outcome was as expected
+ */
+bool check_string(const char   *contents,
+                  size_t       len,
+                  unsigned int options,
+                  const char   *text,
+                  size_t       length,
+                  const int    *offset)
+{
+   char *json = (char*)malloc(len + 4);
+   memcpy(json, "[\"", 2);
+   memcpy(json + 2, contents, len);
+   memcpy(json + 2 + len, "\"]", 2);
+
+   jd_Node *tree = NULL;
+   jd_ParseError pe;
+   memset(&pe, 0, sizeof(pe));
+   bool parsed = jd_parse_buffer(json, len + 4, options, &tree, &pe);
+
+   bool passed;
+   size_t got_len = 0;
+   const char *got = NULL;
+   if (parsed)
+   {
+      got = jd_node_text(firstChild(tree), &got_len);
+      passed = text && got_len == length && memcmp(got, text, length) == 0;
+   }
+   else
+      passed = text == NULL && (offset == NULL || pe.char_loc == *offset);
+
+   if (!passed)
+   {
+      ++failures;
+      printf("   \033[31;1mFAILED\033[39;22m \"");
+      print_escaped(contents, len);
+      printf("\" with options %u: ", options);
+      if (!parsed)
+         printf("rejected at %d, %s\n", pe.char_loc, pe.message);
+      else
+      {
+         printf("read as \"");
+         print_escaped(got, got_len);
+         printf("\"\n");
+      }
+   }
+
+   if (tree)
+      jd_destroy(&tree);
+   free(json);
+   return passed;
+}
+
+/**
+ * @brief Run a table of cases, ending with a NULL @b contents.
+ */
+void run_cases(const char *title, const string_case *cases)
+{
+   int before = failures;
+   int count = 0;
+   printf("\033[32;1m%s\033[39;22m\n", title);
+
+   for (const string_case *sc = cases; sc->contents; ++sc, ++count)
+      check_string(sc->contents, strlen(sc->contents), sc->options,
+                   sc->text, sc->length, NULL);
+
+   if (failures == before)
+      printf("   %d cases passed\n", count);
+}
+
+/** Decoding of escapes, and rejection of invalid ones */
+const string_case escape_cases[] = {
+   { "plain",                    0, "plain",                5 },
+   { "",                         0, "",                     0 },
+   { "\\\"\\\\\\/",              0, "\"\\/",                3 },
+   { "\\b\\f\\n\\r\\t",          0, "\b\f\n\r\t",           5 },
+   { "a\\nb",                    0, "a\nb",                 3 },
+   { "\\u0041",                  0, "A",                    1 },
+   { "\\u00e9",                  0, "\xc3\xa9",             2 },
+   { "\\u00E9",                  0, "\xc3\xa9",             2 },
+   { "\\u20ac",                  0, "\xe2\x82\xac",         3 },
+   { "\\uffff",                  0, "\xef\xbf\xbf",         3 },
+   { "\\ud83d\\ude00",           0, "\xf0\x9f\x98\x80",     4 },
+   { "\\udbff\\udfff",           0, "\xf4\x8f\xbf\xbf",     4 },
+   { "\\u0000",                  0, "\0",                   1 },
+   { "a\\u0000b",                0, "a\0b",                 3 },
+   { "\\ud83d",                  0, NULL,                   0 },
+   { "\\ude00",                  0, NULL,                   0 },
+   { "\\ud83dx",                 0, NULL,                   0 },
+   { "\\ud83d\\n",               0, NULL,                   0 },
+   { "\\ud83d\\u0041",           0, NULL,                   0 },
+   { "\\ud83d\\ud83d",           0, NULL,                   0 },
+   { "\\u12",                    0, NULL,                   0 },
+   { "\\u12g4",                  0, NULL,                   0 },
+   { "\\x",                      0, NULL,                   0 },
+   { "\\U0041",                  0, NULL,                   0 },
+   { "\\",                       0, NULL,                   0 },
+
+   // Raw escapes are kept as they appear:
+   { "a\\nb",                    JD_PARSE_RAW_ESCAPES, "a\\nb",             4 },
+   { "\\u0000",                  JD_PARSE_RAW_ESCAPES, "\\u0000",           6 },
+   { "\\ud83d\\ude00",           JD_PARSE_RAW_ESCAPES, "\\ud83d\\ude00",    12 },
+   { "\\\"\\\\",                 JD_PARSE_RAW_ESCAPES, "\\\"\\\\",          4 },
+   { "a\\nb",                    JD_PARSE_RAW_ESCAPES | JD_PARSE_ZERO_COPY, "a\\nb", 4 },
+   { "a\\nb",                    JD_PARSE_ZERO_COPY, "a\nb",                3 },
+   { NULL,                       0, NULL,                   0 }
+};
+
+/**
+ * @brief Decode an escape after runs of plain text of every
+ *        length up to a few blocks of the fast scan.
+ */
+void check_escape_positions(void)
+{
+   int before = failures;
+   char contents[80], text[80];
+   printf("\033[32;1mescapes after plain runs of 0 to 47 bytes\033[39;22m\n");
+
+   for (int pad = 0; pad < 48; ++pad)
+   {
+      memset(contents, 'a', pad);
+      memcpy(contents + pad, "\\u00e9\\tz", 9);
+      memset(text, 'a', pad);
+      memcpy(text + pad, "\xc3\xa9\tz", 4);
+
+      check_string(contents, pad + 9, 0, text, pad + 4, NULL);
+      check_string(contents, pad + 9, JD_PARSE_RAW_ESCAPES, contents, pad + 9, NULL);
+   }
+
+   if (failures == before)
+      printf("   96 cases passed\n");
+}
+
+/** Validation of UTF-8, which is otherwise passed through */
+const string_case utf8_cases[] = {
+   { "caf\xc3\xa9",               JD_PARSE_VALIDATE_UTF8, "caf\xc3\xa9",       5 },
+   { "\xe2\x82\xac",              JD_PARSE_VALIDATE_UTF8, "\xe2\x82\xac",      3 },
+   { "\xf0\x9f\x98\x80",          JD_PARSE_VALIDATE_UTF8, "\xf0\x9f\x98\x80",  4 },
+   { "\xed\x9f\xbf",              JD_PARSE_VALIDATE_UTF8, "\xed\x9f\xbf",      3 },
+   { "\xee\x80\x80",              JD_PARSE_VALIDATE_UTF8, "\xee\x80\x80",      3 },
+   { "\xf4\x8f\xbf\xbf",          JD_PARSE_VALIDATE_UTF8, "\xf4\x8f\xbf\xbf",  4 },
+   { "\xc0\xaf",                  JD_PARSE_VALIDATE_UTF8, NULL, 0 },
+   { "\xc1\xbf",                  JD_PARSE_VALIDATE_UTF8, NULL, 0 },
+   { "\xe0\x80\xaf",              JD_PARSE_VALIDATE_UTF8, NULL, 0 },
+   { "\xed\xa0\x80",              JD_PARSE_VALIDATE_UTF8, NULL, 0 },
+   { "\xf0\x80\x80\xaf",          JD_PARSE_VALIDATE_UTF8, NULL, 0 },
+   { "\xf4\x90\x80\x80",          JD_PARSE_VALIDATE_UTF8, NULL, 0 },
+   { "\xf5\x80\x80\x80",          JD_PARSE_VALIDATE_UTF8, NULL, 0 },
+   { "\xff",                      JD_PARSE_VALIDATE_UTF8, NULL, 0 },
+   { "\x80",                      JD_PARSE_VALIDATE_UTF8, NULL, 0 },
+   { "\xc3\x28",                  JD_PARSE_VALIDATE_UTF8, NULL, 0 },
+   { "\xe2\x82",                  JD_PARSE_VALIDATE_UTF8, NULL, 0 },
+   { "\xf0\x9f\x98",              JD_PARSE_VALIDATE_UTF8, NULL, 0 },
+
+   // Escapes are decoded to valid UTF-8, whatever the option:
+   { "\\u00e9\xc3\xa9",           JD_PARSE_VALIDATE_UTF8, "\xc3\xa9\xc3\xa9",  4 },
+   { "\xff\\n",                   JD_PARSE_VALIDATE_UTF8, NULL, 0 },
+   { "\xff\\n",                   JD_PARSE_VALIDATE_UTF8 | JD_PARSE_RAW_ESCAPES, NULL, 0 },
+
+   // Without validation, bytes are kept as they are:
+   { "\xff",                      0, "\xff",                                   1 },
+   { "\xed\xa0\x80",              0, "\xed\xa0\x80",                           3 },
+   { NULL,                        0, NULL, 0 }
+};
+
+/**
+ * @brief A sequence placed at each offset of the blocks of the
+ *        vector validator and its scalar tail.
+ */
+typedef struct utf8_sequence_s {
+   const char *bytes;
+   bool       valid;
+} utf8_sequence;
+
+const utf8_sequence sweep_sequences[] = {
+   { "\xc3\xa9",         true  },
+   { "\xe2\x82\xac",     true  },
+   { "\xf0\x9f\x98\x80", true  },
+   { "\xc0\xaf",         false },
+   { "\xed\xa0\x80",     false },
+   { "\xf4\x90\x80\x80", false },
+   { "\xe2\x82",         false },
+   { "\x80",             false },
+   { "\xff",             false },
+   { NULL,               false }
+};
+
+/**
+ * @brief Validate each sequence after ASCII runs of every length
+ *        across three blocks of sixteen bytes, followed by runs
+ *        short and long enough to end in the scalar tail or in
+ *        a further block, and check the offset of every rejection.
+ */
+void check_utf8_positions(void)
+{
+   int before = failures;
+   int count = 0;
+   const size_t tails[] = { 0, 1, 7, 16, 23 };
+   char contents[128];
+   printf("\033[32;1mUTF-8 sequences at offsets 0 to 47, before runs of 0 to 23 bytes\033[39;22m\n");
+
+   for (const utf8_sequence *seq = sweep_sequences; seq->bytes; ++seq)
+   {
+      size_t seq_len = strlen(seq->bytes);
+      for (size_t pad = 0; pad < 48; ++pad)
+         for (int t = 0; t < (int)(sizeof(tails) / sizeof(tails[0])); ++t)
+         {
+            size_t len = pad + seq_len + tails[t];
+            memset(contents, 'a', pad);
+            memcpy(contents + pad, seq->bytes, seq_len);
+            memset(contents + pad + seq_len, 'z', tails[t]);
+
+            // Offsets count the opening bracket and quote:
+            int offset = (int)pad + 2;
+            check_string(contents, len, JD_PARSE_VALIDATE_UTF8,
+                         seq->valid ? contents : NULL, len, &offset);
+            check_string(contents, len, 0, contents, len, NULL);
+            count += 2;
+         }
+   }
+
+   if (failures == before)
+      printf("   %d cases passed\n", count);
+}
+
+int main(void)
+{
+   run_cases("string escapes", escape_cases);
+   check_escape_positions();
+   run_cases("UTF-8 validation", utf8_cases);
+   check_utf8_positions();
+
+   if (failures)
+      printf("\033[31;1m%d cases failed.\033[39;22m\n", failures);
+   else
+      printf("All cases passed.\n");
+
+   return failures ? 1 : 0;
+}